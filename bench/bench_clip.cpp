@@ -0,0 +1,188 @@
+// Microbenchmark for the clipping stage
+//
+// Compares the clip space clipper (camera::ClipAndScaleTriangle(), all six frustum planes in one pass, optional guard
+// band) with the previous implementation, that clipped against near and far plane in view space (using a temporary
+// vector) and against the four viewport edges in screen space (using a std::list as queue). Both variants start from
+// the same view space triangles and include the projection. For each variant it reports the throughput in triangles
+// per second, and the number of heap allocations per input triangle (counted by replacing the global operator new).
+//
+// Build: see CMakeLists.txt (target bench_clip)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <new>
+
+#include "graphics_3D.h"
+
+// ==============================/   Allocation counting    /==============================
+
+static size_t nAllocations = 0;
+
+void *operator new( size_t nSize ) {
+    nAllocations++;
+    if (void *p = std::malloc( nSize ))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete( void *p ) noexcept { std::free( p ); }
+void operator delete( void *p, size_t ) noexcept { std::free( p ); }
+
+// ==============================/   Previous implementation    /==============================
+
+// The clipping as it was before the clip space clipper was introduced: near and far plane in view space...
+void LegacyClipProjectAndScale( camera &cam, triangle &triViewed, std::vector<triangle> &vecOfTris ) {
+    std::vector<triangle> tmpVecOfTris;
+    triangle clipped[2];
+    int nClippedTriangles = camera::Triangle_ClipAgainstPlane( { 0.0f, 0.0f, cam.fNearPlane }, { 0.0f, 0.0f, 1.0f },
+                                                               triViewed, clipped[0], clipped[1] );
+    for (int n = 0; n < nClippedTriangles; n++)
+        tmpVecOfTris.push_back( clipped[n] );
+
+    for (auto tri : tmpVecOfTris) {
+        nClippedTriangles = camera::Triangle_ClipAgainstPlane( { 0.0f, 0.0f, cam.fFarPlane }, { 0.0f, 0.0f, -1.0f },
+                                                           tri, clipped[0], clipped[1] );
+        for (int n = 0; n < nClippedTriangles; n++) {
+            triangle triProjected = clipped[n], triFinal;
+            for (int i = 0; i < 3; i++)
+                triProjected.p[i] = Matrix_MultiplyVector( cam.matProj, clipped[n].p[i] );
+            cam.Tri_ScaleIntoCameraView( triProjected, triFinal );
+            vecOfTris.push_back( triFinal );
+        }
+    }
+}
+
+// ... followed by the std::list based clipping loop against the viewport edges in screen space
+void LegacyClip( camera &cam, std::vector<triangle> &trisToRaster, std::vector<triangle> &trisToRender ) {
+    std::list<triangle> listTriangles;
+    for (auto &rasterTri : trisToRaster) {
+        triangle clipped[2];
+        listTriangles.clear();
+        listTriangles.push_back( rasterTri );
+        int nNewTriangles = 1;
+        for (int p = 0; p < 4; p++) {
+            int nTrisToAdd = 0;
+            while (nNewTriangles > 0) {
+                triangle test = listTriangles.front();
+                listTriangles.pop_front();
+                nNewTriangles--;
+                vec3d clipPIP, clipNormal;
+                switch (p) {
+                    case 0: clipPIP    = { 0.0f, (float)cam.nViewPortY1 + 0.1f, 0.0f };
+                            clipNormal = {  0.0f,  1.0f, 0.0f }; break;
+                    case 1: clipPIP    = { 0.0f, (float)cam.nViewPortY2 - 1.0f, 0.0f };
+                            clipNormal = {  0.0f, -1.0f, 0.0f }; break;
+                    case 2: clipPIP    = { (float)cam.nViewPortX1 + 0.1f, 0.0f, 0.0f };
+                            clipNormal = {  1.0f,  0.0f, 0.0f }; break;
+                    case 3: clipPIP    = { (float)cam.nViewPortX2 - 1.0f, 0.0f, 0.0f };
+                            clipNormal = { -1.0f,  0.0f, 0.0f }; break;
+                }
+                nTrisToAdd = camera::Triangle_ClipAgainstPlane( clipPIP, clipNormal, test, clipped[0], clipped[1] );
+                for (int w = 0; w < nTrisToAdd; w++)
+                    listTriangles.push_back( clipped[w] );
+            }
+            nNewTriangles = (int)listTriangles.size();
+        }
+        for (auto &t : listTriangles)
+            trisToRender.push_back( t );
+    }
+}
+
+void LegacyPipeline( camera &cam, std::vector<triangle> &vecViewed, std::vector<triangle> &vecOut ) {
+    static std::vector<triangle> vecProjected;
+    vecProjected.clear();
+    for (auto &tri : vecViewed)
+        LegacyClipProjectAndScale( cam, tri, vecProjected );
+    LegacyClip( cam, vecProjected, vecOut );
+}
+
+// ==============================/   Current implementation    /==============================
+
+void ClipSpacePipeline( camera &cam, std::vector<triangle> &vecViewed, rasterList &out ) {
+    for (auto &tri : vecViewed) {
+        triangle triProjected = tri;
+        for (int i = 0; i < 3; i++)
+            triProjected.p[i] = Matrix_MultiplyVector( cam.matProj, tri.p[i] );
+        cam.ClipAndScaleTriangle( triProjected, MATERIAL_DEFAULT, 255, out );
+    }
+}
+
+// ==============================/   Benchmark    /==============================
+
+// Creates nCount random view space triangles of about 20 pixels in size (when projected). Roughly fEdgeFraction of
+// them are placed on the left or right viewport edge, or on the near plane; the rest are inside the frustum.
+std::vector<triangle> MakeTriangles( camera &cam, int nCount, float fEdgeFraction ) {
+    std::vector<triangle> vecTris;
+    auto frand = []() { return (float)std::rand() / (float)RAND_MAX; };
+    // the projection matrix has a 90 degrees field of view, so at depth z the viewport spans x and y in [-z, z]
+    // (scaled by the aspect ratio for x)
+    float fAspect = cam.matProj.m[0][0] / cam.matProj.m[1][1];
+    for (int i = 0; i < nCount; i++) {
+        float z  = 2.0f + frand() * 8.0f;
+        float cx = (frand() * 2.0f - 1.0f) * z / fAspect;
+        float cy = (frand() * 2.0f - 1.0f) * z;
+        if (frand() < fEdgeFraction) {
+            float r = frand();
+            if (r < 0.33f) cx = -z / fAspect; else if (r < 0.67f) cx = z / fAspect; else z = cam.fNearPlane;
+        }
+        float s = 10.0f * z * 2.0f / (float)cam.nViewPortHeight;   // half the triangle size: 10 pixels at depth z
+        triangle t;
+        t.p[0] = { cx - s, cy + s, z, 1.0f };
+        t.p[1] = { cx + s, cy + s, z, 1.0f };
+        t.p[2] = { cx,     cy - s, z, 1.0f };
+        vecTris.push_back( t );
+    }
+    return vecTris;
+}
+
+// the legacy clipper produces triangles, the current one a raster list
+void Clear( std::vector<triangle> &vecOut ) { vecOut.clear(); }
+void Clear( rasterList &out )              { RasterList_Clear( out ); }
+size_t TriCount( std::vector<triangle> &vecOut ) { return vecOut.size(); }
+size_t TriCount( rasterList &out )              { return out.vecTris.size(); }
+
+template <typename T, typename F>
+void Run( const char *sName, std::vector<triangle> &vecIn, int nRepeats, F fnClip ) {
+    T out;
+    fnClip( vecIn, out );    // warm up
+
+    size_t nAllocStart = nAllocations;
+    auto tStart = std::chrono::steady_clock::now();
+    for (int r = 0; r < nRepeats; r++) {
+        Clear( out );
+        fnClip( vecIn, out );
+    }
+    auto tEnd = std::chrono::steady_clock::now();
+    double fSeconds = std::chrono::duration<double>( tEnd - tStart ).count();
+    double fTris    = (double)vecIn.size() * nRepeats;
+
+    std::printf( "%-24s %12.0f tris/s   %8.3f allocations/tri   %zu tris out\n",
+                 sName, fTris / fSeconds, (double)(nAllocations - nAllocStart) / fTris, TriCount( out ));
+}
+
+int main() {
+    camera cam;
+    cam.InitCamera( nullptr, "bench", 12, 36, 691, 684 );
+    glbRenderMode = RM_GREYFILLED;
+
+    const int nTris = 100000, nRepeats = 20;
+    for (float fEdge : { 0.0f, 0.1f, 0.5f }) {
+        std::srand( 1 );
+        std::vector<triangle> vecTris = MakeTriangles( cam, nTris, fEdge );
+        std::printf( "%d triangles, %.0f%% on the viewport edges or near plane\n", nTris, fEdge * 100.0f );
+
+        auto fnLegacy = [&]( std::vector<triangle> &in, std::vector<triangle> &out ) {
+            LegacyPipeline( cam, in, out );
+        };
+        auto fnClipSpace = [&]( std::vector<triangle> &in, rasterList &out ) {
+            ClipSpacePipeline( cam, in, out );
+        };
+        Run<std::vector<triangle>>( "  view + screen space", vecTris, nRepeats, fnLegacy );
+        cam.nGuardBand = 0;
+        Run<rasterList>( "  clip space", vecTris, nRepeats, fnClipSpace );
+        cam.nGuardBand = 1024;
+        Run<rasterList>( "  clip space + guard band", vecTris, nRepeats, fnClipSpace );
+    }
+    return 0;
+}
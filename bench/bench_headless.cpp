@@ -0,0 +1,148 @@
+// Headless driver for the demo
+//
+// Renders the demo scene (see demo_scene.h) into an in-memory frame buffer, without a window and without the
+// olcPixelGameEngine. The cube is animated in a fixed way, so the output is the same on every run. This makes it usable
+// both as a benchmark (it reports the time per frame) and as a regression test (it reports a checksum of the final
+// frame, and can write it to a PNG or PPM file for inspection).
+//
+// Usage: bench_headless [number of frames] [output file (.png or .ppm)] [trace file (.json)] [render mode]
+//
+// The render mode is one of the RM_... values in graphics_3D.h (default RM_GREYFILLED_PLUS), e.g. 5 renders the cube
+// with its texture. Pass "" to skip the output or trace file.
+//
+// The trace file is only written if the profiler is compiled in (see profiler.h). Note that the profiler overlay is then
+// part of the frame, so the checksum differs from run to run.
+//
+// The heap allocations are counted (by replacing the global operator new). After the first ALLOC_WARMUP frames a frame
+// must not allocate at all, otherwise the program reports the number of allocations and fails. The animation doesn't
+// repeat (the rotation angles keep growing), so later frames still reach poses that weren't seen during the warm-up:
+// the buffers have to keep enough room for that, rather than growing to what the warm-up happened to need. This check
+// is skipped if the profiler is compiled in, since that records its results in growing buffers.
+//
+// After the animation the scene is rendered IDLE_FRAMES more times without any change. These frames must all be skipped
+// by demoScene::RenderFrame(), and the frame must stay the same, otherwise the program fails.
+//
+// Build: see CMakeLists.txt (target bench_headless)
+
+#include  <chrono>
+#include  <cstdio>
+#include <cstdlib>
+#include     <new>
+#include  <string>
+
+#include  "demo_scene.h"
+#include "framebuffer.h"
+#include    "profiler.h"
+
+#define SCREEN_X   1280
+#define SCREEN_Y    720
+
+#define ALLOC_WARMUP   120    // frames before the allocation check starts (one period of the z translation)
+#define IDLE_FRAMES   1000    // frames without any change after the animation
+
+// ==============================/   Allocation counting    /==============================
+
+static size_t nAllocations = 0;
+
+void *operator new( size_t nSize ) {
+    nAllocations++;
+    if (void *p = std::malloc( nSize ))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete( void *p ) noexcept { std::free( p ); }
+void operator delete( void *p, size_t ) noexcept { std::free( p ); }
+
+// ==============================/   Main    /==============================
+
+// FNV-1a hash over the pixels of the frame buffer
+uint64_t FrameChecksum( frameBuffer &fb ) {
+    uint64_t nHash = 14695981039346656037ull;
+    uint32_t *pPixels = fb.GetPixels();
+    for (int i = 0; i < fb.ScreenWidth() * fb.ScreenHeight(); i++) {
+        nHash ^= pPixels[i];
+        nHash *= 1099511628211ull;
+    }
+    return nHash;
+}
+
+int main( int argc, char *argv[] ) {
+    int nFrames = (argc > 1) ? std::atoi( argv[1] ) : 1000;
+    std::string sOutput = (argc > 2) ? argv[2] : "";
+    std::string sTrace  = (argc > 3) ? argv[3] : "";
+
+    frameBuffer fb( SCREEN_X, SCREEN_Y );
+    demoScene   scene;
+    scene.InitScene( &fb );
+    // InitScene() sets the default render mode
+    if (argc > 4)
+        glbRenderMode = (short)std::atoi( argv[4] );
+
+    // rotate the cube around all three axes, and move it back and forth through the near plane
+    const float fElapsedTime = 1.0f / 60.0f;
+    size_t nSteadyAllocations = 0;
+    auto tStart = std::chrono::steady_clock::now();
+    for (int f = 0; f < nFrames; f++) {
+        size_t nAllocationsBefore = nAllocations;
+        float fTime = f * fElapsedTime;
+        scene.mValues.m[1][0] = 0.7f * fTime;
+        scene.mValues.m[1][1] = 1.1f * fTime;
+        scene.mValues.m[1][2] = 0.3f * fTime;
+        scene.mValues.m[2][2] = 2.0f - 3.0f * (float)((f / 60) % 2 == 0 ? (f % 60) : 60 - (f % 60)) / 60.0f;
+        scene.RenderFrame();
+        if (f >= ALLOC_WARMUP)
+            nSteadyAllocations += nAllocations - nAllocationsBefore;
+    }
+    auto tEnd = std::chrono::steady_clock::now();
+    double fSeconds = std::chrono::duration<double>( tEnd - tStart ).count();
+
+    std::printf( "%d frames (%dx%d) in %.3f s: %.3f ms/frame, %.0f frames/s\n",
+                 nFrames, SCREEN_X, SCREEN_Y, fSeconds, 1000.0 * fSeconds / std::max( nFrames, 1 ), nFrames / fSeconds );
+    uint64_t nChecksum = FrameChecksum( fb );
+    std::printf( "checksum of final frame: %016llx\n", (unsigned long long)nChecksum );
+
+    // nothing changes anymore, so nothing should be drawn
+    int nIdleDrawn = 0;
+    tStart = std::chrono::steady_clock::now();
+    for (int f = 0; f < IDLE_FRAMES; f++)
+        if (scene.RenderFrame())
+            nIdleDrawn++;
+    double fIdleSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - tStart ).count();
+    bool bIdleOk = (nIdleDrawn == 0 && FrameChecksum( fb ) == nChecksum);
+    std::printf( "%d idle frames: %.3f us/frame, %d drawn\n", IDLE_FRAMES, 1e6 * fIdleSeconds / IDLE_FRAMES, nIdleDrawn );
+    if (!bIdleOk)
+        std::printf( "ERROR: the idle frames should not draw anything\n" );
+
+    bool bAllocationsOk = true;
+    if (nFrames > ALLOC_WARMUP) {
+        std::printf( "heap allocations after frame %d: %zu\n", ALLOC_WARMUP, nSteadyAllocations );
+#ifndef PROFILER_ENABLED
+        bAllocationsOk = (nSteadyAllocations == 0);
+        if (!bAllocationsOk)
+            std::printf( "ERROR: the steady state frames should not allocate heap memory\n" );
+#endif
+    }
+
+    if (!sOutput.empty()) {
+        bool bPPM = sOutput.size() >= 4 && sOutput.compare( sOutput.size() - 4, 4, ".ppm" ) == 0;
+        bool bOk  = bPPM ? fb.SavePPM( sOutput ) : fb.SavePNG( sOutput );
+        if (!bOk) {
+            std::printf( "ERROR: couldn't write %s\n", sOutput.c_str() );
+            return 1;
+        }
+        std::printf( "final frame written to %s\n", sOutput.c_str() );
+    }
+
+    if (!sTrace.empty()) {
+#ifdef PROFILER_ENABLED
+        if (!Profiler_SaveTrace( sTrace )) {
+            std::printf( "ERROR: couldn't write %s\n", sTrace.c_str() );
+            return 1;
+        }
+        std::printf( "trace written to %s\n", sTrace.c_str() );
+#else
+        std::printf( "no trace written - the profiler is not compiled in (define PROFILER_ENABLED)\n" );
+#endif
+    }
+    return (bAllocationsOk && bIdleOk) ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Benchmark for instanced rendering
+//
+// Renders a grid of cubes, each with its own world matrix and material, in two ways: with one call to
+// camera::CullViewAndProjectMesh() per cube, and with one call to camera::CullViewAndProjectInstances() for all cubes,
+// which does the work that is the same for all cubes (like the face normals) only once. The grid extends beyond the
+// top and bottom of the view, so part of the cubes is culled as a whole. Reports the time per frame of both variants
+// and the time to rasterize the result into a frame buffer, and checks that both variants render the same image.
+//
+// Usage: bench_instances [number of cubes (default 10000)]
+//
+// Build: see CMakeLists.txt (target bench_instances)
+
+#include <algorithm>
+#include    <chrono>
+#include     <cmath>
+#include    <cstdio>
+#include   <cstdlib>
+#include    <vector>
+
+#include "framebuffer.h"
+#include "graphics_3D.h"
+#include  "rasterizer.h"
+#include "thread_pool.h"
+
+#define SCREEN_X   1280
+#define SCREEN_Y    720
+
+// Builds the indexed unit cube (12 triangles, clockwise when seen from outside)
+void MakeCube( mesh &m ) {
+    const float c[8][3] = { { 0, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 0, 1 } };
+    const int   f[12][3] = { { 0, 1, 2 }, { 0, 2, 3 }, { 3, 2, 6 }, { 3, 6, 7 }, { 7, 6, 5 }, { 7, 5, 4 },
+                             { 4, 5, 1 }, { 4, 1, 0 }, { 1, 5, 6 }, { 1, 6, 2 }, { 7, 4, 0 }, { 7, 0, 3 } };
+    std::vector<triangle> vecTris;
+    for (auto &face : f) {
+        triangle t;
+        for (int j = 0; j < 3; j++)
+            t.p[j] = { c[face[j]][0], c[face[j]][1], c[face[j]][2] };
+        vecTris.push_back( t );
+    }
+    Mesh_FromTriangles( vecTris, m );
+}
+
+// Runs fnFrame nFrames times, and returns the time per frame in milliseconds
+template <typename F>
+double TimePerFrame( int nFrames, F fnFrame ) {
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nFrames; i++)
+        fnFrame();
+    return 1e3 * std::chrono::duration<double>( std::chrono::steady_clock::now() - tStart ).count() / nFrames;
+}
+
+int main( int argc, char *argv[] ) {
+    int nCubes = (argc > 1) ? std::atoi( argv[1] ) : 10000;
+
+    frameBuffer fb( SCREEN_X, SCREEN_Y );
+    std::vector<float> vecDepth( SCREEN_X * SCREEN_Y );
+    camera cam;
+    cam.InitCamera( &fb, "bench", 0, 0, SCREEN_X - 1, SCREEN_Y - 1, 90.0f, 0.1f, 1000.0f );
+    cam.vPosition = { 0.0f, 0.0f, 0.0f };
+    cam.RecalculateCamera();
+
+    mesh meshCube;
+    MakeCube( meshCube );
+
+    // a square grid of randomly rotated cubes in front of the camera, that extends beyond the top and bottom of the view
+    std::srand( 1 );
+    int nSide = (int)std::ceil( std::sqrt( (double)nCubes ));
+    std::vector<mat4x4>   vecWorld( nCubes );
+    std::vector<uint16_t> vecMaterials( nCubes );
+    for (int i = 0; i < nCubes; i++) {
+        transformSRT srt;
+        srt.xScale = srt.yScale = srt.zScale = 0.5f;
+        srt.xAngle = 0.001f * (std::rand() % 6283);
+        srt.yAngle = 0.001f * (std::rand() % 6283);
+        srt.zAngle = 0.001f * (std::rand() % 6283);
+        srt.xTrnsl = 1.2f * (float)(i % nSide - nSide / 2);
+        srt.yTrnsl = 1.2f * (float)(i / nSide - nSide / 2);
+        srt.zTrnsl = 0.5f * (float)nSide;
+        vecWorld[i]   = Matrix_MakeTransformComplete( srt );
+        material mat;
+        mat.nColour = Colour_Pack( 64 + std::rand() % 192, 64 + std::rand() % 192, 64 + std::rand() % 192 );
+        vecMaterials[i] = Material_Add( mat );
+    }
+
+    rasterList perMesh, instanced;
+    double fPerMesh = TimePerFrame( 20, [&]() {
+        RasterList_Clear( perMesh );
+        for (int i = 0; i < nCubes; i++)
+            cam.CullViewAndProjectMesh( meshCube, vecWorld[i], perMesh );
+    } );
+    double fInstanced = TimePerFrame( 20, [&]() {
+        RasterList_Clear( instanced );
+        cam.CullViewAndProjectInstances( meshCube, vecWorld.data(), nCubes, instanced );
+    } );
+
+    rasterTarget target;
+    target.pPixels = fb.GetPixels();
+    target.pDepth  = vecDepth.data();
+    target.nWidth  = target.nClipX2 = SCREEN_X;
+    target.nHeight = target.nClipY2 = SCREEN_Y;
+    tileRasterizer rasterizer;
+    rasterizer.SetTarget( target );
+    auto fnRender = [&]( rasterList &l ) {
+        fb.FillRect( 0, 0, SCREEN_X, SCREEN_Y, COL_BLACK );
+        std::fill( vecDepth.begin(), vecDepth.end(), 0.0f );
+        rasterizer.DrawTriangles( l, false, COL_BLACK, true, &ThreadPool_Global());
+    };
+
+    // Both variants must give the same image. The triangle lists themselves can differ slightly: the matrices are
+    // concatenated in a different order, so triangles that are seen exactly edge on may be culled by one variant and
+    // not by the other (they cover no pixels anyway), and the shades may differ by one because of rounding.
+    fnRender( perMesh );
+    std::vector<uint32_t> vecReference( fb.GetPixels(), fb.GetPixels() + SCREEN_X * SCREEN_Y );
+    fnRender( instanced );
+    int nDiffPixels = 0;
+    for (int i = 0; i < SCREEN_X * SCREEN_Y; i++) {
+        uint32_t a = vecReference[i], b = fb.GetPixels()[i];
+        if (std::abs( Colour_R( a ) - Colour_R( b )) > 1 || std::abs( Colour_G( a ) - Colour_G( b )) > 1 ||
+            std::abs( Colour_B( a ) - Colour_B( b )) > 1)
+            nDiffPixels++;
+    }
+    bool bSame = nDiffPixels <= SCREEN_X * SCREEN_Y / 10000;
+
+    // the instances with their own (coloured) materials, rasterized with the depth buffer
+    rasterList coloured;
+    double fColoured = TimePerFrame( 20, [&]() {
+        RasterList_Clear( coloured );
+        cam.CullViewAndProjectInstances( meshCube, vecWorld.data(), nCubes, coloured, vecMaterials.data());
+    } );
+    double fRaster = TimePerFrame( 20, [&]() { fnRender( coloured ); } );
+
+    std::printf( "%d cubes (%d triangles), %zu triangles visible (%zu with one call per cube)\n", nCubes, 12 * nCubes, instanced.vecTris.size(),
+                 perMesh.vecTris.size());
+    std::printf( "%-46s %9.3f ms/frame\n", "CullViewAndProjectMesh() per cube",           fPerMesh );
+    std::printf( "%-46s %9.3f ms/frame (%.1fx)\n", "CullViewAndProjectInstances()",        fInstanced, fPerMesh / fInstanced );
+    std::printf( "%-46s %9.3f ms/frame\n", "CullViewAndProjectInstances() with materials", fColoured );
+    std::printf( "%-46s %9.3f ms/frame\n", "rasterize (depth test)",                       fRaster );
+    std::printf( "images %s (%d pixels differ)\n", bSame ? "match" : "DIFFER", nDiffPixels );
+    return bSame ? 0 : 1;
+}
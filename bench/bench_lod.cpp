@@ -0,0 +1,233 @@
+// Benchmark for level of detail meshes
+//
+// Builds the levels of detail of a sphere with the quadric error metric simplifier (see mesh_lod.h), and renders a
+// field of these spheres that stretches far away from the camera in three ways: every sphere at full detail, with the
+// levels that lodSelector picks, and with these levels fitted into a triangle budget. Reports the time to build the
+// levels, and per variant the triangles and the time per frame, and how many pixels differ from full detail.
+//
+// Also checks that the selection doesn't pop: a sphere is moved back and forth by a few percent of its distance to the
+// camera, at distances all over the range of the levels. Without hysteresis that makes the level flip wherever the
+// distance crosses a switch point, with it the level must not change after the first frame. And the triangles of the
+// budget variant must fit in the budget.
+//
+// Usage: bench_lod [number of triangles per sphere (default 20000)]
+//
+// Build: see CMakeLists.txt (target bench_lod)
+
+#include <algorithm>
+#include    <chrono>
+#include     <cmath>
+#include    <cstdio>
+#include   <cstdlib>
+#include    <vector>
+
+#include "framebuffer.h"
+#include "graphics_3D.h"
+#include    "mesh_lod.h"
+#include  "rasterizer.h"
+#include "thread_pool.h"
+
+#define SCREEN_X       1280
+#define SCREEN_Y        720
+#define GRID_X           16        // the field of spheres, GRID_X wide and GRID_Z deep
+#define GRID_Z           16
+#define GRID_SPACING    4.0f
+#define BUDGET        20000        // the triangle budget of the third variant
+
+// Builds a unit sphere with about nTriangles triangles (clockwise when seen from outside). The seam and the poles share
+// their vertices, so the mesh is closed.
+void MakeSphere( int nTriangles, mesh &m ) {
+    int nStacks = std::max( 2, (int)std::sqrt( nTriangles / 4.0 ));
+    int nSlices = std::max( 3, nTriangles / (2 * nStacks));
+    // the north pole, nStacks - 1 rings of nSlices vertices, and the south pole
+    VertexStream_Resize( m.verts, 2 + (nStacks - 1) * nSlices );
+    vec3d vPole = { 0.0f, 1.0f, 0.0f };
+    VertexStream_Set( m.verts, 0, vPole );
+    vPole.y = -1.0f;
+    VertexStream_Set( m.verts, 1 + (nStacks - 1) * nSlices, vPole );
+    for (int s = 1; s < nStacks; s++)
+        for (int t = 0; t < nSlices; t++) {
+            float fPhi = PI * (float)s / (float)nStacks, fTheta = 2.0f * PI * (float)t / (float)nSlices;
+            vec3d v = { std::sin( fPhi ) * std::cos( fTheta ), std::cos( fPhi ), std::sin( fPhi ) * std::sin( fTheta ) };
+            VertexStream_Set( m.verts, 1 + (s - 1) * nSlices + t, v );
+        }
+    // vertex t of ring s (ring 0 is the north pole, ring nStacks the south pole)
+    auto fnVertex = [nStacks, nSlices]( int s, int t ) -> uint32_t {
+        if (s == 0)
+            return 0;
+        if (s == nStacks)
+            return 1 + (nStacks - 1) * nSlices;
+        return 1 + (s - 1) * nSlices + t % nSlices;
+    };
+    auto fnAdd = [&m]( uint32_t a, uint32_t b, uint32_t c ) {
+        for (uint32_t i : { a, b, c }) {
+            m.indices.push_back( i );
+            m.texs.push_back( vec2d() );
+        }
+    };
+    for (int s = 0; s < nStacks; s++)
+        for (int t = 0; t < nSlices; t++) {
+            uint32_t i0 = fnVertex( s, t ), i1 = fnVertex( s, t + 1 ), i2 = fnVertex( s + 1, t ), i3 = fnVertex( s + 1, t + 1 );
+            if (s > 0)
+                fnAdd( i0, i2, i1 );
+            if (s < nStacks - 1)
+                fnAdd( i1, i2, i3 );
+        }
+    material mat;
+    mat.nColour = Colour_Pack( 120, 200, 255 );
+    m.nMaterial = Material_Add( mat );
+    Mesh_ComputeBounds( m );
+}
+
+// Runs fnFrame nFrames times, and returns the time per frame in milliseconds
+template <typename F>
+double TimePerFrame( int nFrames, F fnFrame ) {
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nFrames; i++)
+        fnFrame();
+    return 1e3 * std::chrono::duration<double>( std::chrono::steady_clock::now() - tStart ).count() / nFrames;
+}
+
+// Counts how often the level of a sphere changes while it is moved back and forth by 2% of its distance in front of
+// the camera, at 200 distances from 1 to 500. The first frame at each distance doesn't count.
+int CountLevelChanges( camera &cam, lodMesh &lm, float fHysteresis ) {
+    lodSelector selector;
+    selector.fHysteresis = fHysteresis;
+    lodMesh *pMesh = &lm;
+    int nChanges = 0;
+    for (int d = 0; d < 200; d++) {
+        float fDistance = std::pow( 500.0f, d / 199.0f );
+        selector.Reset();
+        int nLevel = -1;
+        for (int nFrame = 0; nFrame < 20; nFrame++) {
+            vec3d  vOffset  = Vector_Mul( cam.vLookDir, fDistance * ((nFrame & 1) ? 1.02f : 0.98f));
+            mat4x4 matWorld = Matrix_MakeTranslation( cam.vPosition.x + vOffset.x, cam.vPosition.y + vOffset.y,
+                                                      cam.vPosition.z + vOffset.z );
+            selector.Select( cam, &pMesh, &matWorld, 1 );
+            if (nFrame > 0 && selector.Level( 0 ) != nLevel)
+                nChanges++;
+            nLevel = selector.Level( 0 );
+        }
+    }
+    return nChanges;
+}
+
+int main( int argc, char *argv[] ) {
+    int nTriangles = (argc > 1) ? std::atoi( argv[1] ) : 20000;
+
+    frameBuffer fb( SCREEN_X, SCREEN_Y );
+    InitDepthBuffer( SCREEN_X, SCREEN_Y );
+    camera cam;
+    cam.InitCamera( &fb, "lod", 0, 0, SCREEN_X - 1, SCREEN_Y - 1, 90.0f, 0.1f, 1000.0f );
+    cam.vPosition  = { 0.0f, 3.0f, -2.0f };
+    cam.nGuardBand = 1024;
+    cam.pPool      = &ThreadPool_Global();
+    cam.SetRGBrange( 32, 255 );
+    cam.RecalculateCamera();
+
+    // the levels of detail
+    mesh meshSphere;
+    MakeSphere( nTriangles, meshSphere );
+    lodMesh lm;
+    auto tStart = std::chrono::steady_clock::now();
+    LodMesh_Build( lm, meshSphere );
+    double fBuildTime = 1e3 * std::chrono::duration<double>( std::chrono::steady_clock::now() - tStart ).count();
+    std::printf( "levels of a %d triangle sphere, built in %.1f ms:\n", Mesh_TriangleCount( meshSphere ), fBuildTime );
+    for (int l = 0; l < LodMesh_LevelCount( lm ); l++) {
+        // the largest distance of a vertex of the level to the surface of the sphere, as a reference for the error
+        meshBuffers b = Mesh_GetBuffers( LodMesh_Level( lm, l ));
+        float fDeviation = 0.0f;
+        for (int i = 0; i < b.nVerts; i++)
+            fDeviation = std::max( fDeviation, std::fabs( std::sqrt( b.x[i] * b.x[i] + b.y[i] * b.y[i] + b.z[i] * b.z[i] ) - 1.0f ));
+        std::printf( "  level %d: %7d triangles, error %.5f (largest vertex deviation %.5f)\n", l, b.nTris, lm.vecError[l], fDeviation );
+    }
+
+    // the field of spheres
+    std::vector<mat4x4>    vecWorld;
+    std::vector<lodMesh *> vecMeshes;
+    for (int z = 0; z < GRID_Z; z++)
+        for (int x = 0; x < GRID_X; x++) {
+            vecWorld.push_back( Matrix_MakeTranslation( GRID_SPACING * (x - 0.5f * (GRID_X - 1)), 0.0f, GRID_SPACING * (z + 1) * (z + 1) * 0.5f ));
+            vecMeshes.push_back( &lm );
+        }
+    int nObjects = (int)vecWorld.size();
+
+    tileRasterizer rasterizer;
+    rasterTarget target;
+    target.pPixels = fb.GetPixels();
+    target.pDepth  = pDepthBuffer;
+    target.nWidth  = SCREEN_X;
+    target.nHeight = SCREEN_Y;
+    target.nClipX1 = 0;
+    target.nClipY1 = 0;
+    target.nClipX2 = SCREEN_X;
+    target.nClipY2 = SCREEN_Y;
+    rasterizer.SetTarget( target );
+    rasterList trisToRaster;
+    lodSelector selector;
+    int nSelected = 0;
+
+    // renders the field with the mesh that fnMesh returns per object
+    auto fnRender = [&]( auto fnMesh ) {
+        RasterList_Clear( trisToRaster );
+        for (int i = 0; i < nObjects; i++) {
+            mesh *pMesh = fnMesh( i );
+            if (pMesh != nullptr)
+                cam.CullViewAndProjectMesh( *pMesh, vecWorld[i], trisToRaster );
+        }
+        cam.RasterizeTriangles( trisToRaster );
+        cam.ClearCameraViewPort();
+        rasterizer.DrawTriangles( trisToRaster, false, COL_BLACK, true, &ThreadPool_Global());
+    };
+    auto fnCountDiff = [&]( const std::vector<uint32_t> &vecReference ) {
+        int nDiff = 0;
+        for (int i = 0; i < SCREEN_X * SCREEN_Y; i++) {
+            uint32_t a = vecReference[i], b = fb.GetPixels()[i];
+            if (std::abs( Colour_R( a ) - Colour_R( b )) > 16 || std::abs( Colour_G( a ) - Colour_G( b )) > 16 ||
+                std::abs( Colour_B( a ) - Colour_B( b )) > 16)
+                nDiff++;
+        }
+        return nDiff;
+    };
+
+    std::printf( "\n%d spheres, %d triangles at full detail\n", nObjects, nObjects * Mesh_TriangleCount( meshSphere ));
+    double fFull = TimePerFrame( 3, [&]() { fnRender( [&]( int ) { return &meshSphere; } ); } );
+    size_t nFullTris = trisToRaster.vecTris.size();
+    std::vector<uint32_t> vecReference( fb.GetPixels(), fb.GetPixels() + SCREEN_X * SCREEN_Y );
+    std::printf( "%-22s %9.3f ms/frame  %8zu triangles drawn\n", "full detail", fFull, nFullTris );
+
+    double fLOD = TimePerFrame( 10, [&]() {
+        nSelected = selector.Select( cam, vecMeshes.data(), vecWorld.data(), nObjects );
+        fnRender( [&]( int i ) { return selector.Mesh( i ); } );
+    } );
+    int nDiffLOD = fnCountDiff( vecReference );
+    std::printf( "%-22s %9.3f ms/frame  %8zu triangles drawn (%d selected), %.2f%% of the pixels differ\n", "levels of detail",
+                 fLOD, trisToRaster.vecTris.size(), nSelected, 100.0 * nDiffLOD / (SCREEN_X * SCREEN_Y));
+
+    selector.nTriangleBudget = BUDGET;
+    double fBudget = TimePerFrame( 10, [&]() {
+        nSelected = selector.Select( cam, vecMeshes.data(), vecWorld.data(), nObjects );
+        fnRender( [&]( int i ) { return selector.Mesh( i ); } );
+    } );
+    int nDiffBudget = fnCountDiff( vecReference );
+    std::printf( "budget of %-12d %9.3f ms/frame  %8zu triangles drawn (%d selected), %.2f%% of the pixels differ\n", BUDGET,
+                 fBudget, trisToRaster.vecTris.size(), nSelected, 100.0 * nDiffBudget / (SCREEN_X * SCREEN_Y));
+    // the budget can only be missed if every visible sphere is at its coarsest level already
+    bool bAllCoarsest = true;
+    for (int i = 0; i < nObjects; i++)
+        if (selector.Level( i ) >= 0 && selector.Level( i ) < LodMesh_LevelCount( lm ) - 1)
+            bAllCoarsest = false;
+    bool bBudgetOk = nSelected <= BUDGET || bAllCoarsest;
+
+    // popping
+    int nChangesWithout = CountLevelChanges( cam, lm, 0.0f );
+    int nChangesWith    = CountLevelChanges( cam, lm, LOD_HYSTERESIS );
+    std::printf( "\nlevel changes of a sphere moving back and forth: %d without hysteresis, %d with\n", nChangesWithout, nChangesWith );
+
+    bool bOk = bBudgetOk && nChangesWith == 0 && nChangesWithout > 0;
+    if (!bBudgetOk)
+        std::printf( "FAILED: %d triangles selected, over the budget of %d\n", nSelected, BUDGET );
+    if (nChangesWith != 0 || nChangesWithout == 0)
+        std::printf( "FAILED: the hysteresis doesn't prevent popping\n" );
+    return bOk ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+// Benchmark for the OBJ loader
+//
+// Writes a synthetic OBJ file (a sphere made of quads, with v, vt, vn and f v/vt/vn records, like most exporters
+// produce), and loads it with a naive std::ifstream / std::stringstream parser and with Mesh_LoadFromObj(), single
+// threaded and on the thread pool. Then loads it through the binary mesh cache (see mesh_cache.h). Reports the parse
+// throughput and the load times, and checks that all loaders produce the same mesh.
+//
+// Usage: bench_obj [number of quads (default 1000000)] [file name (default bench_obj.obj)]
+//
+// Build: see CMakeLists.txt (target bench_obj)
+
+#include    <chrono>
+#include     <cmath>
+#include    <cstdio>
+#include   <cstdlib>
+#include   <cstring>
+#include   <fstream>
+#include   <sstream>
+#include    <string>
+#include    <vector>
+
+#include  "mesh_cache.h"
+#include  "obj_loader.h"
+#include "thread_pool.h"
+
+// ==============================/   Naive loader    /==============================
+
+// The way OBJ files are typically read: line by line into a string, and parsed with a stringstream
+bool NaiveLoadFromObj( const std::string &sFileName, std::vector<vec3d> &vecVerts, std::vector<uint32_t> &vecIndices ) {
+    std::ifstream f( sFileName );
+    if (!f.is_open())
+        return false;
+
+    std::string sLine;
+    while (std::getline( f, sLine )) {
+        if (sLine.size() < 2)
+            continue;
+        if (sLine[0] == 'v' && sLine[1] == ' ') {
+            std::stringstream s( sLine.substr( 2 ));
+            vec3d v;
+            s >> v.x >> v.y >> v.z;
+            vecVerts.push_back( v );
+        } else if (sLine[0] == 'f' && sLine[1] == ' ') {
+            // only the vertex index of each corner is needed: "v/vt/vn"
+            std::stringstream s( sLine.substr( 2 ));
+            std::string sCorner;
+            std::vector<uint32_t> vecFace;
+            while (s >> sCorner)
+                vecFace.push_back( (uint32_t)(std::stoi( sCorner.substr( 0, sCorner.find( '/' ))) - 1) );
+            for (size_t i = 2; i < vecFace.size(); i++) {
+                vecIndices.push_back( vecFace[0] );
+                vecIndices.push_back( vecFace[i - 1] );
+                vecIndices.push_back( vecFace[i] );
+            }
+        }
+    }
+    return true;
+}
+
+// ==============================/   Test file    /==============================
+
+// Writes a sphere of about nQuads quads, and returns the file size in bytes (or 0 on failure)
+long long WriteSphereObj( const std::string &sFileName, int nQuads ) {
+    FILE *pFile = std::fopen( sFileName.c_str(), "w" );
+    if (pFile == nullptr)
+        return 0;
+
+    int nSlices = std::max( 3, (int)std::sqrt( 2.0 * nQuads ));
+    int nStacks = std::max( 2, nQuads / nSlices );
+    std::fprintf( pFile, "# synthetic sphere, %d x %d quads\no sphere\n", nSlices, nStacks );
+    for (int s = 0; s <= nStacks; s++) {
+        float fPhi = PI * (float)s / (float)nStacks;
+        for (int t = 0; t <= nSlices; t++) {
+            float fTheta = 2.0f * PI * (float)t / (float)nSlices;
+            float x = std::sin( fPhi ) * std::cos( fTheta ), y = std::cos( fPhi ), z = std::sin( fPhi ) * std::sin( fTheta );
+            std::fprintf( pFile, "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+                          x, y, z, (float)t / nSlices, (float)s / nStacks, x, y, z );
+        }
+    }
+    std::fprintf( pFile, "s 1\n" );
+    for (int s = 0; s < nStacks; s++) {
+        for (int t = 0; t < nSlices; t++) {
+            int i0 = s * (nSlices + 1) + t + 1, i1 = i0 + 1, i2 = i0 + nSlices + 1, i3 = i2 + 1;
+            std::fprintf( pFile, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", i0, i0, i0, i2, i2, i2, i3, i3, i3, i1, i1, i1 );
+        }
+    }
+    long long nSize = std::ftell( pFile );
+    std::fclose( pFile );
+    return nSize;
+}
+
+// ==============================/   Main    /==============================
+
+// runs fnLoad nRuns times, and returns the fastest time in seconds
+template <typename F>
+double BestTime( int nRuns, F fnLoad ) {
+    double fBest = 1e30;
+    for (int i = 0; i < nRuns; i++) {
+        auto tStart = std::chrono::steady_clock::now();
+        fnLoad();
+        fBest = std::min( fBest, std::chrono::duration<double>( std::chrono::steady_clock::now() - tStart ).count() );
+    }
+    return fBest;
+}
+
+int main( int argc, char *argv[] ) {
+    int nQuads = (argc > 1) ? std::atoi( argv[1] ) : 1000000;
+    std::string sFileName = (argc > 2) ? argv[2] : "bench_obj.obj";
+
+    long long nFileSize = WriteSphereObj( sFileName, nQuads );
+    if (nFileSize == 0) {
+        std::printf( "ERROR: couldn't write %s\n", sFileName.c_str() );
+        return 1;
+    }
+    double fMB = (double)nFileSize / (1024.0 * 1024.0);
+    std::printf( "%s: %.1f MB\n", sFileName.c_str(), fMB );
+
+    std::vector<vec3d>    vecNaiveVerts;
+    std::vector<uint32_t> vecNaiveIndices;
+    double fNaive = BestTime( 1, [&]() {
+        vecNaiveVerts.clear();
+        vecNaiveIndices.clear();
+        NaiveLoadFromObj( sFileName, vecNaiveVerts, vecNaiveIndices );
+    } );
+
+    mesh meshSingle, meshParallel;
+    std::string sError;
+    bool bOk = true;
+    double fSingle = BestTime( 3, [&]() {
+        bOk &= Mesh_LoadFromObj( sFileName, meshSingle, nullptr, &sError );
+    } );
+    double fParallel = BestTime( 3, [&]() {
+        bOk &= Mesh_LoadFromObj( sFileName, meshParallel, &ThreadPool_Global(), &sError );
+    } );
+    if (!bOk) {
+        std::printf( "ERROR: %s\n", sError.c_str() );
+        return 1;
+    }
+
+    std::printf( "%-36s %9.1f ms %9.1f MB/s\n", "naive (ifstream + stringstream)", 1000.0 * fNaive, fMB / fNaive );
+    std::printf( "%-36s %9.1f ms %9.1f MB/s\n", "Mesh_LoadFromObj (1 thread)", 1000.0 * fSingle, fMB / fSingle );
+    std::printf( "%-36s %9.1f ms %9.1f MB/s\n", ("Mesh_LoadFromObj (" + std::to_string( ThreadPool_Global().ThreadCount()) + " threads)").c_str(),
+                 1000.0 * fParallel, fMB / fParallel );
+
+    // check that the loaders agree - the vertices may differ in the last bit, because of the different float parsers
+    bool bSame = meshSingle.indices == vecNaiveIndices && meshParallel.indices == vecNaiveIndices &&
+                 meshSingle.verts.nCount == (int)vecNaiveVerts.size() && meshParallel.verts.nCount == (int)vecNaiveVerts.size();
+    float fMaxDiff = 0.0f;
+    for (int i = 0; bSame && i < meshSingle.verts.nCount; i++) {
+        vec3d v = VertexStream_Get( meshParallel.verts, i );
+        fMaxDiff = std::max( { fMaxDiff, std::fabs( v.x - vecNaiveVerts[i].x ), std::fabs( v.y - vecNaiveVerts[i].y ),
+                               std::fabs( v.z - vecNaiveVerts[i].z ) } );
+        bSame &= VertexStream_Get( meshSingle.verts, i ).x == v.x;
+    }
+    bSame &= (fMaxDiff <= 1e-6f);
+
+    // The cache: the first call parses the OBJ file and writes the cache file, the next ones only map the cache file
+    std::string sCacheFile = MeshCache_FileName( sFileName );
+    std::remove( sCacheFile.c_str() );
+    mesh meshCached;
+    double fWriteCache = BestTime( 1, [&]() {
+        bOk &= Mesh_LoadFromObjCached( sFileName, meshCached, &ThreadPool_Global(), &sError );
+    } );
+    double fFromCache = BestTime( 3, [&]() {
+        bOk &= Mesh_LoadFromObjCached( sFileName, meshCached, &ThreadPool_Global(), &sError );
+    } );
+    if (!bOk || meshCached.pViewOwner == nullptr) {
+        std::printf( "ERROR: the cache file %s wasn't used %s\n", sCacheFile.c_str(), sError.c_str() );
+        return 1;
+    }
+    std::printf( "%-36s %9.1f ms\n", "Mesh_LoadFromObjCached (write cache)", 1000.0 * fWriteCache );
+    std::printf( "%-36s %9.3f ms\n", "Mesh_LoadFromObjCached (from cache)",  1000.0 * fFromCache );
+
+    meshBuffers a = Mesh_GetBuffers( meshParallel ), b = Mesh_GetBuffers( meshCached );
+    bSame &= a.nVerts == b.nVerts && a.nTris == b.nTris &&
+             std::memcmp( a.x, b.x, a.nVerts * sizeof( float )) == 0 &&
+             std::memcmp( a.y, b.y, a.nVerts * sizeof( float )) == 0 &&
+             std::memcmp( a.z, b.z, a.nVerts * sizeof( float )) == 0 &&
+             std::memcmp( a.indices, b.indices, 3 * (size_t)a.nTris * sizeof( uint32_t )) == 0 &&
+             std::memcmp( a.texs,    b.texs,    3 * (size_t)a.nTris * sizeof( vec2d    )) == 0;
+
+    std::printf( "%d vertices, %d triangles - %s (max vertex difference %g)\n", meshParallel.verts.nCount,
+                 Mesh_TriangleCount( meshParallel ), bSame ? "results match" : "RESULTS DIFFER", fMaxDiff );
+    return bSame ? 0 : 1;
+}
@@ -0,0 +1,322 @@
+// Benchmark suite for the math layer and the camera pipeline
+//
+// Measures the matrix and vector primitives (in ns per call) and the stages of the camera pipeline on synthetic meshes
+// of increasing size (in ns per triangle and triangles per second). The results are printed as a table, and written
+// as JSON so that they can be compared between releases.
+//
+// Usage: bench_pipeline [--json <file>] [--min <triangles>] [--max <triangles>]
+//     --json   the file to write the results to (default: bench_pipeline.json)
+//     --min    the smallest mesh size (default: 1000)
+//     --max    the largest mesh size (default: 1000000). The mesh sizes go up by a factor 10, so --max 10000000 adds
+//              a 10M triangle mesh (this needs about 3 GB of memory).
+//
+// Build: see CMakeLists.txt (target bench_pipeline)
+
+#include <algorithm>
+#include    <chrono>
+#include    <cstdio>
+#include   <cstdlib>
+#include   <cstring>
+#include    <string>
+#include    <vector>
+
+#include "graphics_3D.h"
+#include "thread_pool.h"
+
+// ==============================/   Timing and reporting    /==============================
+
+struct benchResult {
+    std::string sName;
+    long long   nTriangles = 0;    // mesh size, 0 for the primitives
+    long long   nOps       = 0;    // number of calls resp. triangles processed in the timed part
+    double      fNsPerOp   = 0.0;
+    long long   nTrisOut   = 0;    // number of triangles produced by the stage (pipeline stages only)
+};
+
+std::vector<benchResult> vecResults;
+
+// the results of the primitives are accumulated here, so that the compiler can't optimize the calls away
+volatile float fSink = 0.0f;
+
+double Seconds( std::chrono::steady_clock::time_point tStart ) {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - tStart ).count();
+}
+
+void Report( benchResult r ) {
+    if (r.nTriangles == 0)
+        std::printf( "%-30s %12s %10.2f ns/op\n", r.sName.c_str(), "", r.fNsPerOp );
+    else
+        std::printf( "%-30s %12lld %10.2f ns/tri %14.0f tris/s %12lld tris out\n",
+                     r.sName.c_str(), r.nTriangles, r.fNsPerOp, 1e9 / r.fNsPerOp, r.nTrisOut );
+    vecResults.push_back( r );
+}
+
+bool WriteJson( const std::string &sFileName ) {
+    FILE *pFile = std::fopen( sFileName.c_str(), "w" );
+    if (pFile == nullptr)
+        return false;
+    std::fprintf( pFile, "{\n" );
+    std::fprintf( pFile, "  \"benchmark\": \"bench_pipeline\",\n" );
+    std::fprintf( pFile, "  \"simd\": \"%s\",\n", MAT4X4_SSE2 ? "sse2" : "scalar" );
+    std::fprintf( pFile, "  \"threads\": %d,\n", ThreadPool_Global().ThreadCount() );
+    std::fprintf( pFile, "  \"results\": [\n" );
+    for (size_t i = 0; i < vecResults.size(); i++) {
+        benchResult &r = vecResults[i];
+        std::fprintf( pFile, "    { \"name\": \"%s\", \"triangles\": %lld, \"ops\": %lld, \"ns_per_op\": %.4f",
+                      r.sName.c_str(), r.nTriangles, r.nOps, r.fNsPerOp );
+        if (r.nTriangles > 0)
+            std::fprintf( pFile, ", \"tris_per_s\": %.0f, \"tris_out\": %lld", 1e9 / r.fNsPerOp, r.nTrisOut );
+        std::fprintf( pFile, " }%s\n", (i + 1 < vecResults.size()) ? "," : "" );
+    }
+    std::fprintf( pFile, "  ]\n}\n" );
+    return std::fclose( pFile ) == 0;
+}
+
+// ==============================/   Primitives    /==============================
+
+float RandomFloat( float fMin, float fMax ) {
+    return fMin + (fMax - fMin) * (float)std::rand() / (float)RAND_MAX;
+}
+
+// Calls fnOp( i ) for i = 0, 1, 2, ... until at least 0.2 seconds have passed, and reports the time per call
+template <typename F>
+void BenchPrimitive( const char *sName, F fnOp ) {
+    const int nBatch = 1 << 16;
+    long long nOps = 0;
+    auto tStart = std::chrono::steady_clock::now();
+    do {
+        for (int i = 0; i < nBatch; i++)
+            fnOp( i );
+        nOps += nBatch;
+    } while (Seconds( tStart ) < 0.2);
+
+    benchResult r;
+    r.sName    = sName;
+    r.nOps     = nOps;
+    r.fNsPerOp = 1e9 * Seconds( tStart ) / (double)nOps;
+    Report( r );
+}
+
+void BenchPrimitives() {
+    // a set of random inputs, large enough to prevent the compiler from hoisting the calls, small enough to stay in cache
+    const int nInputs = 1024;
+    std::vector<mat4x4> vecMats( nInputs );
+    std::vector<vec3d>  vecVecs( nInputs );
+    std::vector<float>  vecParams( nInputs * 9 );
+    std::vector<triangle> vecTris( nInputs );
+    for (int i = 0; i < nInputs; i++) {
+        for (int r = 0; r < 4; r++)
+            for (int c = 0; c < 4; c++)
+                vecMats[i].m[r][c] = RandomFloat( -1.0f, 1.0f );
+        vecVecs[i] = { RandomFloat( -1.0f, 1.0f ), RandomFloat( -1.0f, 1.0f ), RandomFloat( -1.0f, 1.0f ), 1.0f };
+        for (int j = 0; j < 9; j++)
+            vecParams[9 * i + j] = RandomFloat( 0.5f, 2.0f );
+        // triangles around the plane z = 0, so that all clipping cases (0, 1 or 2 vertices inside) occur
+        for (int j = 0; j < 3; j++)
+            vecTris[i].p[j] = { RandomFloat( -1.0f, 1.0f ), RandomFloat( -1.0f, 1.0f ), RandomFloat( -1.0f, 1.0f ), 1.0f };
+    }
+    const int nMask = nInputs - 1;
+
+    BenchPrimitive( "Matrix_MultiplyMatrix", [&]( int i ) {
+        mat4x4 m = Matrix_MultiplyMatrix( vecMats[i & nMask], vecMats[(i + 1) & nMask] );
+        fSink = fSink + m.m[3][3];
+    } );
+    BenchPrimitive( "Matrix_MultiplyVector", [&]( int i ) {
+        vec3d v = Matrix_MultiplyVector( vecMats[i & nMask], vecVecs[(i + 7) & nMask] );
+        fSink = fSink + v.w;
+    } );
+    BenchPrimitive( "Matrix_MakeTransformComplete", [&]( int i ) {
+        float *p = &vecParams[9 * (i & nMask)];
+        mat4x4 m = Matrix_MakeTransformComplete( p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8] );
+        fSink = fSink + m.m[3][0];
+    } );
+    BenchPrimitive( "Triangle_ClipAgainstPlane", [&]( int i ) {
+        triangle out1, out2;
+        int n = camera::Triangle_ClipAgainstPlane( { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, vecTris[i & nMask], out1, out2 );
+        fSink = fSink + (float)n;
+    } );
+}
+
+// ==============================/   Pipeline    /==============================
+
+// Builds a (partial) sphere mesh with nTriangles triangles. The sphere is placed in front of the camera that is set up
+// in BenchPipeline(), such that its top crosses the upper edge of the viewport. So about half of the triangles are
+// back faces, and some of the front faces need clipping.
+void MakeSphereMesh( long long nTriangles, mesh &m ) {
+    int nSlices = 4, nStacks = 2;
+    while (2LL * nSlices * nStacks < nTriangles) {
+        nSlices *= 2;
+        if (2LL * nSlices * nStacks < nTriangles)
+            nStacks *= 2;
+    }
+    vec3d vCentre = { 0.0f, 5.0f, 8.0f };
+    float fRadius = 4.0f;
+
+    VertexStream_Resize( m.verts, (nStacks + 1) * (nSlices + 1) );
+    for (int s = 0; s <= nStacks; s++) {
+        float fSinPhi, fCosPhi;
+        Matrix_SinCos( PI * (float)s / (float)nStacks, fSinPhi, fCosPhi );
+        for (int t = 0; t <= nSlices; t++) {
+            float fSinTheta, fCosTheta;
+            Matrix_SinCos( 2.0f * PI * (float)t / (float)nSlices, fSinTheta, fCosTheta );
+            vec3d v = { vCentre.x + fRadius * fSinPhi * fCosTheta, vCentre.y + fRadius * fCosPhi, vCentre.z + fRadius * fSinPhi * fSinTheta };
+            VertexStream_Set( m.verts, s * (nSlices + 1) + t, v );
+        }
+    }
+    m.indices.clear();
+    m.texs.clear();
+    m.indices.reserve( 3 * nTriangles );
+    m.texs.reserve( 3 * nTriangles );
+    for (int s = 0; s < nStacks && (long long)m.indices.size() < 3 * nTriangles; s++) {
+        for (int t = 0; t < nSlices && (long long)m.indices.size() < 3 * nTriangles; t++) {
+            uint32_t i0 = s * (nSlices + 1) + t, i1 = i0 + 1, i2 = i0 + (nSlices + 1), i3 = i2 + 1;
+            uint32_t quad[2][3] = { { i0, i2, i1 }, { i1, i2, i3 } };
+            for (int q = 0; q < 2 && (long long)m.indices.size() < 3 * nTriangles; q++) {
+                for (int j = 0; j < 3; j++) {
+                    m.indices.push_back( quad[q][j] );
+                    m.texs.push_back( { 0.0f, 0.0f, 1.0f } );
+                }
+            }
+        }
+    }
+    material mat;
+    mat.renderMode = RM_GREYFILLED;
+    m.nMaterial = Material_Add( mat );
+    Mesh_ComputeBounds( m );
+}
+
+// Runs fnStage until at least 0.2 seconds have passed (but at least once), and returns the time per run in seconds
+template <typename F>
+double TimeStage( F fnStage ) {
+    int nRuns = 0;
+    auto tStart = std::chrono::steady_clock::now();
+    do {
+        fnStage();
+        nRuns++;
+    } while (Seconds( tStart ) < 0.2);
+    return Seconds( tStart ) / nRuns;
+}
+
+void BenchPipeline( long long nTriangles ) {
+    camera cam;
+    cam.InitCamera( nullptr, "bench", 0, 0, 1279, 719, 90.0f, 0.1f, 1000.0f );
+    cam.vPosition = { 0.0f, 0.0f, 0.0f };
+    cam.RecalculateCamera();
+    glbRenderMode = RM_GREYFILLED;
+
+    mesh m;
+    MakeSphereMesh( nTriangles, m );
+    mat4x4 matWorld = Matrix_MakeIdentity();
+
+    rasterList out;
+    out.vecTris.reserve( nTriangles );
+    out.vecVerts.reserve( nTriangles );
+
+    // the mesh path - world, view and projection transform per vertex
+    double fTime = TimeStage( [&]() {
+        RasterList_Clear( out );
+        cam.CullViewAndProjectMesh( m, matWorld, out );
+    } );
+    Report( { "CullViewAndProjectMesh", nTriangles, nTriangles, 1e9 * fTime / (double)nTriangles, (long long)out.vecTris.size() } );
+
+    // The same, with a thread pool - meshes of CAMERA_PARALLEL_MIN_TRIS triangles and more are then split over the
+    // threads. The pool has at least two threads, so that the parallel path is also taken (and checked) on a single
+    // core machine. The result must be the same triangles, in the same order and at the same screen positions.
+    if (nTriangles >= CAMERA_PARALLEL_MIN_TRIS) {
+        static threadPool pool( std::max( ThreadPool_Global().ThreadCount(), 2 ));
+        rasterList outParallel;
+        outParallel.vecTris.reserve( nTriangles );
+        outParallel.vecVerts.reserve( 2 * nTriangles );
+        cam.pPool = &pool;
+        fTime = TimeStage( [&]() {
+            RasterList_Clear( outParallel );
+            cam.CullViewAndProjectMesh( m, matWorld, outParallel );
+        } );
+        cam.pPool = nullptr;
+        Report( { "CullViewAndProjectMesh (pool)", nTriangles, nTriangles, 1e9 * fTime / (double)nTriangles, (long long)outParallel.vecTris.size() } );
+
+        bool bSame = (outParallel.vecTris.size() == out.vecTris.size());
+        for (size_t i = 0; bSame && i < out.vecTris.size(); i++) {
+            const rasterTriangle &t1 = out.vecTris[i], &t2 = outParallel.vecTris[i];
+            bSame = (t1.nMaterial == t2.nMaterial && t1.nShade == t2.nShade);
+            for (int j = 0; bSame && j < 3; j++) {
+                const rasterVertex &v1 = out.vecVerts[t1.v[j]], &v2 = outParallel.vecVerts[t2.v[j]];
+                bSame = (v1.x == v2.x && v1.y == v2.y && v1.z == v2.z && v1.iw == v2.iw);
+            }
+        }
+        if (!bSame)
+            std::printf( "ERROR: the parallel result differs from the serial one\n" );
+    }
+
+    // the per triangle path, on the same (world space) triangles
+    {
+        std::vector<triangle> vecTris( nTriangles );
+        for (long long i = 0; i < nTriangles; i++)
+            vecTris[i] = Mesh_GetTriangle( m, (int)i );
+        fTime = TimeStage( [&]() {
+            RasterList_Clear( out );
+            for (auto &tri : vecTris)
+                cam.CullViewAndProjectTriangle( tri, out, m.nMaterial );
+        } );
+        Report( { "CullViewAndProjectTriangle", nTriangles, nTriangles, 1e9 * fTime / (double)nTriangles, (long long)out.vecTris.size() } );
+    }
+
+    // RasterizeTriangles() on the output of the previous stage, with the painters algorithm (so including the sort),
+    // without and with a thread pool. The sort changes the order of its input, so the input is restored for every run
+    // (which is not timed). Both runs must give the same order.
+    std::vector<rasterTriangle> vecProjected = out.vecTris, vecSorted;
+    long long nProjected = (long long)vecProjected.size();
+    if (nProjected > 0) {
+        static threadPool pool( std::max( ThreadPool_Global().ThreadCount(), 2 ));
+        glbDepthTest = false;
+        for (threadPool *pPool : { (threadPool *)nullptr, &pool }) {
+            cam.pPool = pPool;
+            int nRuns = 0;
+            double fTotal = 0.0;
+            do {
+                out.vecTris = vecProjected;
+                auto tStart = std::chrono::steady_clock::now();
+                cam.RasterizeTriangles( out );
+                fTotal += Seconds( tStart );
+                nRuns++;
+            } while (fTotal < 0.2 && nRuns < 100);
+            Report( { pPool ? "RasterizeTriangles (pool)" : "RasterizeTriangles", nTriangles, nProjected,
+                      1e9 * fTotal / nRuns / (double)nProjected, (long long)out.vecTris.size() } );
+
+            if (pPool == nullptr)
+                vecSorted = out.vecTris;
+            else if (std::memcmp( vecSorted.data(), out.vecTris.data(), vecSorted.size() * sizeof( rasterTriangle )) != 0)
+                std::printf( "ERROR: the parallel sort differs from the serial one\n" );
+        }
+        cam.pPool = nullptr;
+        glbDepthTest = true;
+    }
+}
+
+// ==============================/   Main    /==============================
+
+int main( int argc, char *argv[] ) {
+    std::string sJsonFile = "bench_pipeline.json";
+    long long nMinTris = 1000, nMaxTris = 1000000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if      (std::strcmp( argv[i], "--json" ) == 0) sJsonFile = argv[i + 1];
+        else if (std::strcmp( argv[i], "--min"  ) == 0) nMinTris  = std::atoll( argv[i + 1] );
+        else if (std::strcmp( argv[i], "--max"  ) == 0) nMaxTris  = std::atoll( argv[i + 1] );
+        else {
+            std::printf( "usage: %s [--json <file>] [--min <triangles>] [--max <triangles>]\n", argv[0] );
+            return 1;
+        }
+    }
+
+    std::srand( 1 );
+    BenchPrimitives();
+    for (long long n = nMinTris; n <= nMaxTris; n *= 10)
+        BenchPipeline( n );
+
+    if (!WriteJson( sJsonFile )) {
+        std::printf( "ERROR: couldn't write %s\n", sJsonFile.c_str() );
+        return 1;
+    }
+    std::printf( "results written to %s\n", sJsonFile.c_str() );
+    return 0;
+}
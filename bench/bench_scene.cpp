@@ -0,0 +1,133 @@
+// Benchmark for the scene graph
+//
+// Builds a random hierarchy of nodes, and measures the cost of UpdateWorldMatrices() per frame for a static scene, for
+// a scene where a small part of the nodes moves, and for a scene where everything moves. As a reference, the cost of
+// recomputing all world matrices every frame (without caching) is measured as well. The world matrices of the graph
+// are checked against that reference, also after reparenting nodes.
+//
+// Usage: bench_scene [number of nodes (default 100000)]
+//
+// Build: see CMakeLists.txt (target bench_scene)
+
+#include  <chrono>
+#include  <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include  <vector>
+
+#include "scene_graph.h"
+
+float RandomFloat( float fMin, float fMax ) {
+    return fMin + (fMax - fMin) * (float)std::rand() / (float)RAND_MAX;
+}
+
+transformSRT RandomSRT() {
+    transformSRT srt;
+    srt.xScale = RandomFloat( 0.5f, 2.0f );  srt.yScale = RandomFloat( 0.5f, 2.0f );  srt.zScale = RandomFloat( 0.5f, 2.0f );
+    srt.xAngle = RandomFloat( -PI, PI );     srt.yAngle = RandomFloat( -PI, PI );     srt.zAngle = RandomFloat( -PI, PI );
+    srt.xTrnsl = RandomFloat( -5.0f, 5.0f ); srt.yTrnsl = RandomFloat( -5.0f, 5.0f ); srt.zTrnsl = RandomFloat( -5.0f, 5.0f );
+    return srt;
+}
+
+// Computes the world matrices of all nodes without any caching - the reference for the benchmark and the check
+void ComputeAllWorldMatrices( sceneGraph &graph, std::vector<mat4x4> &vecWorld, std::vector<int> &vecState ) {
+    int nNodes = graph.NodeCount();
+    vecWorld.resize( nNodes );
+    vecState.assign( nNodes, 0 );    // 0 = not done, 1 = done
+    std::vector<int> vecPath;
+    for (int i = 0; i < nNodes; i++) {
+        // collect the ancestors that are not done yet, and compute them top down
+        for (int n = i; n >= 0 && vecState[n] == 0; n = graph.GetParent( n ))
+            vecPath.push_back( n );
+        while (!vecPath.empty()) {
+            int n = vecPath.back();
+            vecPath.pop_back();
+            mat4x4 matLocal = Matrix_MakeTransformComplete( graph.GetLocal( n ));
+            int nParent = graph.GetParent( n );
+            vecWorld[n] = (nParent >= 0) ? Matrix_MultiplyMatrix( matLocal, vecWorld[nParent] ) : matLocal;
+            vecState[n] = 1;
+        }
+    }
+}
+
+bool CheckWorldMatrices( sceneGraph &graph ) {
+    std::vector<mat4x4> vecWorld;
+    std::vector<int>    vecState;
+    ComputeAllWorldMatrices( graph, vecWorld, vecState );
+    for (int i = 0; i < graph.NodeCount(); i++)
+        if (std::memcmp( &graph.GetWorldMatrix( i ), &vecWorld[i], sizeof( mat4x4 )) != 0)
+            return false;
+    return true;
+}
+
+// Runs fnFrame nFrames times, and returns the time per frame in microseconds
+template <typename F>
+double TimePerFrame( int nFrames, F fnFrame ) {
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nFrames; i++)
+        fnFrame( i );
+    return 1e6 * std::chrono::duration<double>( std::chrono::steady_clock::now() - tStart ).count() / nFrames;
+}
+
+int main( int argc, char *argv[] ) {
+    int nNodes = (argc > 1) ? std::atoi( argv[1] ) : 100000;
+    std::srand( 1 );
+
+    // A random forest: every node gets one of the recently added nodes as parent (or none), which gives a mix of
+    // deep and shallow subtrees
+    sceneGraph graph;
+    for (int i = 0; i < nNodes; i++) {
+        int nParent = (i == 0 || std::rand() % 50 == 0) ? -1 : i - 1 - std::rand() % std::min( i, 16 );
+        graph.AddNode( RandomSRT(), nParent );
+    }
+
+    std::vector<int> vecMoving;    // 1% of the nodes move
+    for (int i = 0; i < nNodes / 100; i++)
+        vecMoving.push_back( std::rand() % nNodes );
+    std::vector<transformSRT> vecAnimSRT( 64 );
+    for (auto &srt : vecAnimSRT)
+        srt = RandomSRT();
+
+    int nUpdated = 0;
+    double fInitial = TimePerFrame( 1, [&]( int ) { nUpdated = graph.UpdateWorldMatrices(); } );
+    std::printf( "%d nodes\n", nNodes );
+    std::printf( "%-40s %10.1f us (%d nodes updated)\n", "initial update (all nodes dirty)", fInitial, nUpdated );
+    bool bOk = CheckWorldMatrices( graph );
+
+    double fStatic = TimePerFrame( 1000, [&]( int ) { nUpdated = graph.UpdateWorldMatrices(); } );
+    std::printf( "%-40s %10.3f us (%d nodes updated)\n", "static scene, per frame", fStatic, nUpdated );
+
+    long long nTotal = 0;
+    double fPartial = TimePerFrame( 100, [&]( int f ) {
+        for (size_t i = 0; i < vecMoving.size(); i++)
+            graph.SetLocal( vecMoving[i], vecAnimSRT[(f + i) % vecAnimSRT.size()] );
+        nTotal += graph.UpdateWorldMatrices();
+    } );
+    std::printf( "%-40s %10.1f us (%lld nodes updated on average)\n", "1% of the nodes moving, per frame", fPartial, nTotal / 100 );
+    bOk &= CheckWorldMatrices( graph );
+
+    nTotal = 0;
+    double fAll = TimePerFrame( 20, [&]( int f ) {
+        for (int i = 0; i < nNodes; i++)
+            graph.SetLocal( i, vecAnimSRT[(f + i) % vecAnimSRT.size()] );
+        nTotal += graph.UpdateWorldMatrices();
+    } );
+    std::printf( "%-40s %10.1f us (%lld nodes updated on average)\n", "all nodes moving, per frame", fAll, nTotal / 20 );
+    bOk &= CheckWorldMatrices( graph );
+
+    std::vector<mat4x4> vecWorld;
+    std::vector<int>    vecState;
+    double fNaive = TimePerFrame( 20, [&]( int ) { ComputeAllWorldMatrices( graph, vecWorld, vecState ); } );
+    std::printf( "%-40s %10.1f us\n", "reference: recompute all, per frame", fNaive );
+
+    // move some subtrees under nodes that come later in the order, which forces a reorder of the arrays
+    for (int i = 0; i < 100; i++) {
+        int nNode = std::rand() % nNodes, nParent = std::rand() % nNodes;
+        graph.SetParent( nNode, nParent );    // fails (and changes nothing) if it would create a cycle
+    }
+    graph.UpdateWorldMatrices();
+    bOk &= CheckWorldMatrices( graph );
+
+    std::printf( "world matrices %s\n", bOk ? "match the reference" : "DIFFER FROM THE REFERENCE" );
+    return bOk ? 0 : 1;
+}
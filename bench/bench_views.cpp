@@ -0,0 +1,175 @@
+// Benchmark for rendering one scene into several views
+//
+// Renders a scene of lit spheres into 1 view, 2 views (split screen), 4 views (quadrants) and a full screen view with
+// a picture in picture view, in two ways: with each camera doing the complete pipeline on its own (world transform,
+// lighting, culling, projection and clipping per camera), and with multiViewRenderer, which does the world transform
+// and the lighting once and the cameras in parallel. Reports the time per frame of both, relative to one view, and
+// checks that both render the same image.
+//
+// Usage: bench_views [number of triangles per sphere (default 100000)]
+//
+// Build: see CMakeLists.txt (target bench_views)
+
+#include  <chrono>
+#include   <cmath>
+#include  <cstdio>
+#include <cstdlib>
+#include  <vector>
+
+#include "framebuffer.h"
+#include "graphics_3D.h"
+#include  "multi_view.h"
+#include  "rasterizer.h"
+#include "scene_graph.h"
+#include "thread_pool.h"
+
+#define SCREEN_X    1280
+#define SCREEN_Y     720
+#define N_SPHERES      8
+
+// Builds a unit sphere with about nTriangles triangles (clockwise when seen from outside)
+void MakeSphere( int nTriangles, mesh &m ) {
+    int nStacks = std::max( 2, (int)std::sqrt( nTriangles / 4.0 ));
+    int nSlices = std::max( 3, nTriangles / (2 * nStacks));
+    VertexStream_Resize( m.verts, (nStacks + 1) * (nSlices + 1) );
+    for (int s = 0; s <= nStacks; s++) {
+        for (int t = 0; t <= nSlices; t++) {
+            float fPhi = PI * (float)s / (float)nStacks, fTheta = 2.0f * PI * (float)t / (float)nSlices;
+            vec3d v = { std::sin( fPhi ) * std::cos( fTheta ), std::cos( fPhi ), std::sin( fPhi ) * std::sin( fTheta ) };
+            VertexStream_Set( m.verts, s * (nSlices + 1) + t, v );
+        }
+    }
+    for (int s = 0; s < nStacks; s++) {
+        for (int t = 0; t < nSlices; t++) {
+            uint32_t i0 = s * (nSlices + 1) + t, i1 = i0 + 1, i2 = i0 + (nSlices + 1), i3 = i2 + 1;
+            uint32_t quad[6] = { i0, i2, i1, i1, i2, i3 };
+            for (uint32_t i : quad) {
+                m.indices.push_back( i );
+                m.texs.push_back( vec2d() );
+            }
+        }
+    }
+    material mat;
+    mat.nColour = Colour_Pack( 255, 200, 120 );
+    m.nMaterial = Material_Add( mat );
+    Mesh_ComputeBounds( m );
+}
+
+// Sets up camera cam for viewport (x1, y1) - (x2, y2), at vPosition and looking along the z axis, turned by fYaw
+void SetupCamera( camera &cam, frameBuffer &fb, int x1, int y1, int x2, int y2, vec3d vPosition, float fYaw ) {
+    cam.InitCamera( &fb, "view", x1, y1, x2, y2, 90.0f, 0.1f, 1000.0f );
+    cam.vPosition  = vPosition;
+    cam.fCameraYaw = fYaw;
+    cam.nGuardBand = 1024;
+    cam.pPool      = &ThreadPool_Global();
+    cam.SetRGBrange( 32, 255 );
+    cam.RecalculateCamera();
+}
+
+// Runs fnFrame nFrames times, and returns the time per frame in milliseconds
+template <typename F>
+double TimePerFrame( int nFrames, F fnFrame ) {
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nFrames; i++)
+        fnFrame();
+    return 1e3 * std::chrono::duration<double>( std::chrono::steady_clock::now() - tStart ).count() / nFrames;
+}
+
+// the view setups: viewports in fractions of the screen (x1, y1, x2, y2)
+struct setup {
+    const char *sName;
+    int         nViews;
+    float       fViewPort[4][4];
+};
+const setup setups[] = {
+    { "1 view",             1, { { 0.0f, 0.0f, 1.0f, 1.0f } } },
+    { "split screen",       2, { { 0.0f, 0.0f, 0.5f, 1.0f }, { 0.5f, 0.0f, 1.0f, 1.0f } } },
+    { "4 quadrants",        4, { { 0.0f, 0.0f, 0.5f, 0.5f }, { 0.5f, 0.0f, 1.0f, 0.5f }, { 0.0f, 0.5f, 0.5f, 1.0f }, { 0.5f, 0.5f, 1.0f, 1.0f } } },
+    { "picture in picture", 2, { { 0.0f, 0.0f, 1.0f, 1.0f }, { 0.7f, 0.05f, 0.95f, 0.4f } } },
+};
+
+int main( int argc, char *argv[] ) {
+    int nTriangles = (argc > 1) ? std::atoi( argv[1] ) : 100000;
+
+    frameBuffer fb( SCREEN_X, SCREEN_Y );
+    InitDepthBuffer( SCREEN_X, SCREEN_Y );
+
+    // a ring of spheres around the origin
+    mesh meshSphere;
+    MakeSphere( nTriangles, meshSphere );
+    sceneGraph graph;
+    for (int i = 0; i < N_SPHERES; i++) {
+        transformSRT srt;
+        srt.xTrnsl = 6.0f * std::cos( 2.0f * PI * i / N_SPHERES );
+        srt.zTrnsl = 6.0f * std::sin( 2.0f * PI * i / N_SPHERES );
+        graph.AddNode( srt, -1, &meshSphere );
+    }
+    graph.UpdateWorldMatrices();
+
+    tileRasterizer rasterizer;
+    rasterList     trisToRaster;
+    std::vector<uint32_t> vecReference( SCREEN_X * SCREEN_Y );
+    double fSingle[2] = { 0.0, 0.0 };
+    bool   bAllSame   = true;
+
+    std::printf( "%d spheres of %d triangles\n", N_SPHERES, Mesh_TriangleCount( meshSphere ));
+    std::printf( "%-20s %24s %24s\n", "", "every camera on its own", "multiViewRenderer" );
+    for (const setup &s : setups) {
+        std::vector<camera> vecCameras( s.nViews );
+        multiViewRenderer renderer;
+        for (int i = 0; i < s.nViews; i++) {
+            const float *f = s.fViewPort[i];
+            SetupCamera( vecCameras[i], fb, (int)(f[0] * SCREEN_X), (int)(f[1] * SCREEN_Y), (int)(f[2] * SCREEN_X) - 1,
+                         (int)(f[3] * SCREEN_Y) - 1, { 0.0f, 1.0f + i, -14.0f + 3.0f * i }, 0.1f * i );
+        }
+        for (camera &cam : vecCameras)
+            renderer.AddView( &cam );
+
+        // every camera does the complete pipeline on its own
+        double fOwn = TimePerFrame( 10, [&]() {
+            for (camera &cam : vecCameras) {
+                RasterList_Clear( trisToRaster );
+                for (int i = 0; i < graph.NodeCount(); i++)
+                    cam.CullViewAndProjectMesh( *graph.GetMesh( i ), graph.GetWorldMatrix( i ), trisToRaster );
+                cam.RasterizeTriangles( trisToRaster );
+                cam.ClearCameraViewPort();
+                rasterTarget target;
+                target.pPixels = fb.GetPixels();
+                target.pDepth  = pDepthBuffer;
+                target.nWidth  = SCREEN_X;
+                target.nHeight = SCREEN_Y;
+                target.nClipX1 = cam.nViewPortX1;
+                target.nClipY1 = cam.nViewPortY1;
+                target.nClipX2 = cam.nViewPortX2 + 1;
+                target.nClipY2 = cam.nViewPortY2 + 1;
+                rasterizer.SetTarget( target );
+                rasterizer.DrawTriangles( trisToRaster, false, COL_BLACK, true, &ThreadPool_Global());
+            }
+        } );
+        vecReference.assign( fb.GetPixels(), fb.GetPixels() + SCREEN_X * SCREEN_Y );
+
+        double fShared = TimePerFrame( 10, [&]() {
+            renderer.Render( graph, false, COL_BLACK, true, TEXTURE_FILTER_NONE, &ThreadPool_Global());
+        } );
+
+        // The images must be the same, up to rounding: the world transform is a separate step here, and the lighting
+        // is done with world space normals instead of the normal matrix.
+        int nDiffPixels = 0;
+        for (int i = 0; i < SCREEN_X * SCREEN_Y; i++) {
+            uint32_t a = vecReference[i], b = fb.GetPixels()[i];
+            if (std::abs( Colour_R( a ) - Colour_R( b )) > 1 || std::abs( Colour_G( a ) - Colour_G( b )) > 1 ||
+                std::abs( Colour_B( a ) - Colour_B( b )) > 1)
+                nDiffPixels++;
+        }
+        bool bSame = nDiffPixels <= SCREEN_X * SCREEN_Y / 10000;
+        bAllSame &= bSame;
+
+        if (s.nViews == 1) {
+            fSingle[0] = fOwn;
+            fSingle[1] = fShared;
+        }
+        std::printf( "%-20s %9.3f ms/frame (%.2fx) %9.3f ms/frame (%.2fx)   images %s (%d pixels differ)\n", s.sName,
+                     fOwn, fOwn / fSingle[0], fShared, fShared / fSingle[1], bSame ? "match" : "DIFFER", nDiffPixels );
+    }
+    return bAllSame ? 0 : 1;
+}
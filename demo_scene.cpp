@@ -0,0 +1,323 @@
+#include "demo_scene.h"
+
+#include <algorithm>
+#include    <cstdio>
+#include   <cstring>
+
+#include    "profiler.h"
+#include "thread_pool.h"
+
+// ==============================/   Rendering code    /==============================
+
+// Renders the triangles into the viewport of camera cam. The filled modes are drawn by the tile rasterizer,
+// directly into the pixels of the render target.
+void demoScene::RenderTriangles( camera &cam, rasterList &trisToRender ) {
+    PROFILE_SCOPE( "render" );
+    PROFILE_COUNT( PROF_TRIS_RASTERIZED, (long long)trisToRender.vecTris.size());
+
+    rasterTarget target;
+    target.pPixels = pTarget->GetPixels();
+    target.pDepth  = pDepthBuffer;
+    target.nWidth  = pTarget->ScreenWidth();
+    target.nHeight = pTarget->ScreenHeight();
+    target.nClipX1 = cam.nViewPortX1;
+    target.nClipY1 = cam.nViewPortY1;
+    target.nClipX2 = cam.nViewPortX2 + 1;
+    target.nClipY2 = cam.nViewPortY2 + 1;
+
+    // the textures are only sampled in the textured modes
+    int nFilter = (glbRenderMode == RM_TEXTURED || glbRenderMode == RM_TEXTURED_PLUS) ? glbTextureFilter : TEXTURE_FILTER_NONE;
+
+    switch (glbRenderMode) {
+        case RM_TEXTURED:
+        case RM_GREYFILLED:
+            rasterizer.SetTarget( target );
+            rasterizer.DrawTriangles( trisToRender, false, RM_FRAMECOL, glbDepthTest, &ThreadPool_Global(), nFilter );
+            break;
+        case RM_TEXTURED_PLUS:
+        case RM_GREYFILLED_PLUS:
+            rasterizer.SetTarget( target );
+            rasterizer.DrawTriangles( trisToRender, true,  RM_FRAMECOL, glbDepthTest, &ThreadPool_Global(), nFilter );
+            break;
+        case RM_WIREFRAME:
+            for (auto &t : trisToRender.vecTris ) {
+                rasterVertex &v0 = trisToRender.vecVerts[t.v[0]], &v1 = trisToRender.vecVerts[t.v[1]], &v2 = trisToRender.vecVerts[t.v[2]];
+                pTarget->DrawTriangle( v0.x, v0.y, v1.x, v1.y, v2.x, v2.y, RM_FRAMECOL );
+            }
+            break;
+    }
+}
+
+// ==============================/   End of rendering code    /==============================
+
+void demoScene::DisplayMatrix( mat4x4 mTrf, mat4x4 mVal, int x, int y ) {
+
+    // lambda convenience function for rounding floats to fixed length substring - the text is formatted in the
+    // frame arena, so no strings are allocated on the heap
+    auto mkstr = [&]( float fValue ) -> const char * {
+        char *sValue = arena.Format( "%f", fValue );
+        if (std::strlen( sValue ) > 5)
+            sValue[5] = '\0';
+        return sValue;
+    };
+
+    // display scale factors / rotation angles / translation offsets
+    pTarget->DrawString( x + 5, y +  30, "           x     y     z   " );
+    pTarget->DrawString( x + 5, y +  50, arena.Format( "scale:   %s %s %s", mkstr( mVal.m[0][0] ), mkstr( mVal.m[0][1] ), mkstr( mVal.m[0][2] )), COL_GREY   );
+    pTarget->DrawString( x + 5, y +  70, arena.Format( "angle:   %s %s %s", mkstr( mVal.m[1][0] ), mkstr( mVal.m[1][1] ), mkstr( mVal.m[1][2] )), COL_YELLOW );
+    pTarget->DrawString( x + 5, y +  90, arena.Format( "trnsl:   %s %s %s", mkstr( mVal.m[2][0] ), mkstr( mVal.m[2][1] ), mkstr( mVal.m[2][2] )), COL_GREEN  );
+
+    // display resulting transformation matrix
+    pTarget->DrawString( x + 15, y + 150, "Transformation matrix" );
+    pTarget->DrawString( x + 15, y + 170, arena.Format( "%s %s %s %s", mkstr( mTrf.m[0][0] ), mkstr( mTrf.m[0][1] ), mkstr( mTrf.m[0][2] ), mkstr( mTrf.m[0][3] )));
+    pTarget->DrawString( x + 15, y + 190, arena.Format( "%s %s %s %s", mkstr( mTrf.m[1][0] ), mkstr( mTrf.m[1][1] ), mkstr( mTrf.m[1][2] ), mkstr( mTrf.m[1][3] )));
+    pTarget->DrawString( x + 15, y + 210, arena.Format( "%s %s %s %s", mkstr( mTrf.m[2][0] ), mkstr( mTrf.m[2][1] ), mkstr( mTrf.m[2][2] ), mkstr( mTrf.m[2][3] )));
+    pTarget->DrawString( x + 15, y + 230, arena.Format( "%s %s %s %s", mkstr( mTrf.m[3][0] ), mkstr( mTrf.m[3][1] ), mkstr( mTrf.m[3][2] ), mkstr( mTrf.m[3][3] )));
+}
+
+void demoScene::DisplayProjInfo( float fFieldOfView, float fNearPlane, float fFarPlane, int x, int y ) {
+
+    // lambda convenience function for rounding floats to fixed length substring (see DisplayMatrix())
+    auto mkstr = [&]( float fValue ) -> const char * {
+        char *sValue = arena.Format( "%f", fValue );
+        if (std::strlen( sValue ) > 5)
+            sValue[5] = '\0';
+        return sValue;
+    };
+
+    // display field of view and near / far plane values
+    pTarget->DrawString( x + 5, y +  50, arena.Format( "FoV:    %s", mkstr( fFieldOfView )));
+    pTarget->DrawString( x + 5, y +  70, arena.Format( "Fnear:  %s", mkstr( fNearPlane   )));
+    pTarget->DrawString( x + 5, y +  90, arena.Format( "Ffar:   %s", mkstr( fFarPlane    )));
+}
+
+// Displays the timings per pipeline stage and the triangle counters of the last profiled frame
+void demoScene::DisplayProfiler( int x, int y ) {
+#ifdef PROFILER_ENABLED
+    const profileFrame &frame = Profiler_LastFrame();
+
+    // the names are indented by nesting level and padded to a fixed width column, the numbers are right aligned
+    int nLine = 0;
+    pTarget->DrawString( x + 5, y + 15 * nLine++, arena.Format( "frame %d%11.3f ms", frame.nFrame, frame.fFrameMs ), COL_YELLOW );
+    for (auto &stage : frame.vecStages) {
+        int nIndent = std::min( 2 * stage.nDepth, 18 );
+        pTarget->DrawString( x + 5, y + 15 * nLine++, arena.Format( "%*s%-*.*s%7.3f ms", nIndent, "", 18 - nIndent, 18 - nIndent,
+                                                                    stage.sName, stage.fMs ));
+    }
+    const char *sCounterNames[PROF_NR_OF_COUNTERS] = { "tris in", "culled", "clipped", "clip into", "rasterized" };
+    for (int i = 0; i < PROF_NR_OF_COUNTERS; i++)
+        pTarget->DrawString( x + 5, y + 15 * nLine++, arena.Format( "%-18s%7lld", sCounterNames[i], frame.nCounters[i] ), COL_GREEN );
+#else
+    (void)x;
+    (void)y;
+#endif
+}
+
+// auxiliary function for initializing cube
+triangle demoScene::make_tri( float f01, float f02, float f03, float f04,
+                              float f05, float f06, float f07, float f08,
+                              float f09, float f10, float f11, float f12,
+                              float f13, float f14, float f15,
+                              float f16, float f17, float f18,
+                              float f19, float f20, float f21 ) {
+    triangle t;
+    t.p[0] = { f01, f02, f03, f04 };
+    t.p[1] = { f05, f06, f07, f08 };
+    t.p[2] = { f09, f10, f11, f12 };
+    t.t[0] = { f13, f14, f15 };
+    t.t[1] = { f16, f17, f18 };
+    t.t[2] = { f19, f20, f21 };
+    return t;
+}
+
+void demoScene::InitScene( renderTarget *target ) {
+
+    pTarget = target;
+    int nScreenW = pTarget->ScreenWidth();
+    int nScreenH = pTarget->ScreenHeight();
+
+    // create the depth buffer
+    InitDepthBuffer( nScreenW, nScreenH );
+
+    // Initialize the unit cube, including texturing coordinates (used in the textured render modes)
+    std::vector<triangle> vecCubeTris;
+    triangle t;
+    t = make_tri( 0.0f, 0.0f, 0.0f, 1.0f,   0.0f, 1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 0.0f, 1.0f,    0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 1.0f,   1.0f, 0.0f, 1.0f ); vecCubeTris.push_back(t);    // SOUTH
+    t = make_tri( 0.0f, 0.0f, 0.0f, 1.0f,   1.0f, 1.0f, 0.0f, 1.0f,   1.0f, 0.0f, 0.0f, 1.0f,    0.0f, 1.0f, 1.0f,   1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f ); vecCubeTris.push_back(t);
+    t = make_tri( 1.0f, 0.0f, 0.0f, 1.0f,   1.0f, 1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f, 1.0f,    0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 1.0f,   1.0f, 0.0f, 1.0f ); vecCubeTris.push_back(t);    // EAST
+    t = make_tri( 1.0f, 0.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f, 1.0f,   1.0f, 0.0f, 1.0f, 1.0f,    0.0f, 1.0f, 1.0f,   1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f ); vecCubeTris.push_back(t);
+    t = make_tri( 1.0f, 0.0f, 1.0f, 1.0f,   1.0f, 1.0f, 1.0f, 1.0f,   0.0f, 1.0f, 1.0f, 1.0f,    0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 1.0f,   1.0f, 0.0f, 1.0f ); vecCubeTris.push_back(t);    // NORTH
+    t = make_tri( 1.0f, 0.0f, 1.0f, 1.0f,   0.0f, 1.0f, 1.0f, 1.0f,   0.0f, 0.0f, 1.0f, 1.0f,    0.0f, 1.0f, 1.0f,   1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f ); vecCubeTris.push_back(t);
+    t = make_tri( 0.0f, 0.0f, 1.0f, 1.0f,   0.0f, 1.0f, 1.0f, 1.0f,   0.0f, 1.0f, 0.0f, 1.0f,    0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 1.0f,   1.0f, 0.0f, 1.0f ); vecCubeTris.push_back(t);    // WEST
+    t = make_tri( 0.0f, 0.0f, 1.0f, 1.0f,   0.0f, 1.0f, 0.0f, 1.0f,   0.0f, 0.0f, 0.0f, 1.0f,    0.0f, 1.0f, 1.0f,   1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f ); vecCubeTris.push_back(t);
+    t = make_tri( 0.0f, 1.0f, 0.0f, 1.0f,   0.0f, 1.0f, 1.0f, 1.0f,   1.0f, 1.0f, 1.0f, 1.0f,    0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 1.0f,   1.0f, 0.0f, 1.0f ); vecCubeTris.push_back(t);    // TOP
+    t = make_tri( 0.0f, 1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f, 1.0f,   1.0f, 1.0f, 0.0f, 1.0f,    0.0f, 1.0f, 1.0f,   1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f ); vecCubeTris.push_back(t);
+    t = make_tri( 1.0f, 0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 0.0f, 1.0f,    0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 1.0f,   1.0f, 0.0f, 1.0f ); vecCubeTris.push_back(t);    // BOTTOM
+    t = make_tri( 1.0f, 0.0f, 1.0f, 1.0f,   0.0f, 0.0f, 0.0f, 1.0f,   1.0f, 0.0f, 0.0f, 1.0f,    0.0f, 1.0f, 1.0f,   1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 1.0f ); vecCubeTris.push_back(t);
+
+    // convert into an indexed mesh, so that the 8 corners of the cube are only transformed once
+    Mesh_FromTriangles( vecCubeTris, meshCube );
+    // the cube gets a checker board texture - it is only sampled in the textured render modes
+    Texture_MakeChecker( texChecker, 256, 32, COL_WHITE, COL_DARK_RED );
+    material matCube;
+    matCube.pTexture = &texChecker;
+    meshCube.nMaterial = Material_Add( matCube );
+    // room for the cube even if it's clipped by all frustum planes, so the raster list doesn't grow while rendering
+    trianglesToRaster.vecTris.reserve( 7 * vecCubeTris.size());
+    trianglesToRaster.vecVerts.reserve( CLIP_MAX_VERTICES * vecCubeTris.size());
+    // the cube is the only object in the scene (its transform is set every frame from mValues)
+    nCubeNode = graph.AddNode( transformSRT(), -1, &meshCube );
+
+    fFoV =  90.0f;
+    fNear =  0.1f;
+    fFar  = 20.0f;
+
+    // create two camera's, the first for cube rendering, the second only as a text viewport for matrix info
+    cam1.InitCamera( pTarget, "camera 1", 0.01f * nScreenW, 0.05f * nScreenH, 0.54f * nScreenW, 0.95f * nScreenH, fFoV, fNear, fFar );
+    cam2.InitCamera( pTarget, "camera 2", 0.55f * nScreenW, 0.35f * nScreenH, 0.99f * nScreenW, 0.95f * nScreenH );
+
+    // a little offset to put the camera close, but not on the cube
+    cam1.vPosition = { 0.5f, 0.5f, -2.0f };
+    cam1.RecalculateCamera();
+
+    cam1.SetRGBrange( 32, 255 );
+    cam1.pPool = &ThreadPool_Global();    // large (loaded) meshes are projected in parallel
+    glbRenderMode = RM_GREYFILLED_PLUS;
+
+    // the mValues matrix is used for the 9 variables to be changed as input to the transform matrix:
+    //     scale factor       - x, y, z
+    //     rotation angle     - x, y, z
+    //     translation offset - x, y, z
+
+    // setup test matrix for displaying
+    mTransform = Matrix_MakeIdentity();
+    mValues = Matrix_Buildup(  1.0f, 1.0f, 1.0f, 0.0f,
+                               0.0f, 0.0f, 0.0f, 0.0f,
+                               0.0f, 0.0f, 0.0f, 0.0f,
+                               0.0f, 0.0f, 0.0f, 0.0f );
+
+    // clear the complete screen
+    pTarget->FillRect( 0, 0, nScreenW, nScreenH, COL_DARK_RED );
+    // draw user instructions on screen
+    pTarget->DrawString( cam2.nViewPortX1 +  10, cam2.nViewPortY1 - 120, "hold Q, W, E for scale" );
+    pTarget->DrawString( cam2.nViewPortX1 +  10, cam2.nViewPortY1 - 100, "     A, S, D for angle" );
+    pTarget->DrawString( cam2.nViewPortX1 +  10, cam2.nViewPortY1 -  80, "     Z, X, C for trnsl" );
+    pTarget->DrawString( cam2.nViewPortX1 +  10, cam2.nViewPortY1 -  40, "change value: arrow keys" );
+
+    pTarget->DrawString( cam2.nViewPortX1 + 300, cam2.nViewPortY1 - 120, "hold V for Field of View" );
+    pTarget->DrawString( cam2.nViewPortX1 + 300, cam2.nViewPortY1 - 100, "     N for Near plane"    );
+    pTarget->DrawString( cam2.nViewPortX1 + 300, cam2.nViewPortY1 -  80, "     F for Far  plane"    );
+    pTarget->DrawString( cam2.nViewPortX1 + 300, cam2.nViewPortY1 -  40, "change value: + / - (num pad)" );
+
+    // the first frame draws everything
+    Invalidate();
+}
+
+bool demoScene::RenderFrame() {
+
+    // update camera with new projection matrix - this does nothing if the values didn't change
+    cam1.UpdateCamera( fFoV, fNear, fFar );
+
+    // the local transform of the cube comes from the mValues matrix - the scene graph only recomputes the world
+    // matrices if it really changed
+    transformSRT srtCube;
+    srtCube.xScale = mValues.m[0][0];  srtCube.yScale = mValues.m[0][1];  srtCube.zScale = mValues.m[0][2];
+    srtCube.xAngle = mValues.m[1][0];  srtCube.yAngle = mValues.m[1][1];  srtCube.zAngle = mValues.m[1][2];
+    srtCube.xTrnsl = mValues.m[2][0];  srtCube.yTrnsl = mValues.m[2][1];  srtCube.zTrnsl = mValues.m[2][2];
+    graph.SetLocal( nCubeNode, srtCube );
+    graph.UpdateWorldMatrices();
+    mTransform = graph.GetWorldMatrix( nCubeNode );
+
+    // compare the inputs of this frame with those of the last one, to find out what has to be redone
+    frameState state;
+    state.nSceneVersion  = graph.Version();
+    for (int i = 0; i < graph.NodeCount(); i++)
+        if (graph.GetMesh( i ) != nullptr)
+            state.nMeshVersions += graph.GetMesh( i )->nVersion;
+    state.nCameraVersion = cam1.nVersion;
+    state.nRenderMode    = glbRenderMode;
+    state.bDepthTest     = glbDepthTest;
+    state.nTextureFilter = glbTextureFilter;
+    state.mValues        = mValues;
+    state.mTransform     = mTransform;
+    state.fFoV           = fFoV;
+    state.fNear          = fNear;
+    state.fFar           = fFar;
+
+    bool bProject = !bLastFrameValid || state.nSceneVersion  != lastFrame.nSceneVersion  ||
+                    state.nMeshVersions != lastFrame.nMeshVersions || state.nCameraVersion != lastFrame.nCameraVersion ||
+                    state.nRenderMode   != lastFrame.nRenderMode   || state.bDepthTest     != lastFrame.bDepthTest;
+    bool bDraw    = bProject || state.nTextureFilter != lastFrame.nTextureFilter;
+    bool bPanel   = !bLastFrameValid || std::memcmp( &state.mValues,    &lastFrame.mValues,    sizeof( mat4x4 )) != 0 ||
+                                        std::memcmp( &state.mTransform, &lastFrame.mTransform, sizeof( mat4x4 )) != 0 ||
+                    state.fFoV != lastFrame.fFoV || state.fNear != lastFrame.fNear || state.fFar != lastFrame.fFar;
+#ifdef PROFILER_ENABLED
+    // the profiler overlay shows the timings of the last drawn frame
+    bPanel |= bDraw;
+#endif
+    lastFrame       = state;
+    bLastFrameValid = true;
+    // an idle frame: the render target still shows the last frame, which is still correct
+    if (!bDraw && !bPanel)
+        return false;
+
+    PROFILE_BEGIN_FRAME();
+    // everything that was allocated in the arena during the previous frame is released
+    arena.Reset();
+
+    if (bProject) {
+        // render all objects of the scene, each transformed with its world matrix - the raster list keeps its
+        // capacity from the previous frames
+        RasterList_Clear( trianglesToRaster );
+
+        // the filled modes are drawn by the tile rasterizer, which clips to the viewport itself, so there
+        // the guard band can be used to skip most of the clipping against the viewport borders
+        bool bFilledMode = (glbRenderMode != RM_WIREFRAME && glbRenderMode != RM_WIREFRAME_RGB);
+        cam1.nGuardBand = bFilledMode ? GUARD_BAND : 0;
+
+        // Do the world transform, the culling, and the view and project transform per camera. The output is added
+        // to the vector that is passed as parameter.
+        // NOTE: clipping against all six frustum planes is done in this function.
+        for (int i = 0; i < graph.NodeCount(); i++) {
+            mesh *pMesh = graph.GetMesh( i );
+            if (pMesh != nullptr)
+                cam1.CullViewAndProjectMesh( *pMesh, graph.GetWorldMatrix( i ), trianglesToRaster );
+        }
+        // sort the triangles if needed
+        cam1.RasterizeTriangles( trianglesToRaster );
+    }
+
+    if (bDraw) {
+        // the triangles of the last frame are drawn again if only the texture filter changed
+        {
+            PROFILE_SCOPE( "clear viewports" );
+            cam1.ClearCameraViewPort();
+        }
+        RenderTriangles( cam1, trianglesToRaster );
+
+        pTarget->DrawString( 10, 10, "F1 - F7: select render mode" );
+        // DrawString() draws no background, so the lines that change are cleared first (8 pixels per character), down
+        // to the area that ClearCameraViewPort() just cleared. This also removes the texture filter line when switching
+        // to an untextured mode.
+        pTarget->FillRect( 10, 20, 8 * 32, cam1.nViewPortY1 - 1 - 20, COL_DARK_RED );
+        pTarget->DrawString( 10, 20, glbDepthTest ? "F8: toggle depth buffer - on" : "F8: toggle depth buffer - off" );
+        if (glbRenderMode == RM_TEXTURED || glbRenderMode == RM_TEXTURED_PLUS)
+            pTarget->DrawString( 10, 30, glbTextureFilter == TEXTURE_FILTER_BILINEAR ? "F10: texture filter - bilinear" : "F10: texture filter - nearest" );
+    }
+
+    // the matrix panel is only drawn if its values changed
+    if (bPanel) {
+        cam2.ClearCameraViewPort();
+        // display scaling, rotation and translation values and transformation matrix
+        DisplayMatrix( mTransform, mValues, cam2.nViewPortX1 + 10, cam2.nViewPortY1 + 10 );
+        DisplayProjInfo( fFoV, fNear, fFar, cam2.nViewPortX1 + 300, cam2.nViewPortY1 + 10 );
+        DisplayProfiler( cam2.nViewPortX1 + 300, cam2.nViewPortY1 + 140 );
+    }
+
+    PROFILE_END_FRAME();
+    return true;
+}
+
+void demoScene::Invalidate() {
+    bLastFrameValid = false;
+}
@@ -0,0 +1,92 @@
+#ifndef DEMO_SCENE_H
+#define DEMO_SCENE_H
+
+#include <vector>
+
+#include   "frame_arena.h"
+#include   "graphics_3D.h"
+#include "render_target.h"
+#include    "rasterizer.h"
+#include   "scene_graph.h"
+
+// guard band (in pixels) for the filled render modes - the tile rasterizer handles triangles within this band
+// around the viewport without loss of precision
+#define GUARD_BAND  1024
+
+// The scene of the demo: a unit cube, rendered with a transformation matrix that is built up from the scaling
+// factors, rotation angles and translation offsets in mValues, plus the matrix info. The objects are held in a scene
+// graph, that computes their world matrices. The scene only draws through
+// a renderTarget, so the complete frame can be rendered with or without a window (see main.cpp and
+// bench/bench_headless.cpp). User input is not handled here - the input values are public members.
+class demoScene {
+public:
+    camera cam1,    // for rendering cube
+           cam2;    // for displaying matrix info
+
+    float fFoV, fNear, fFar;
+
+    mat4x4 mTransform,   // tranformation matrix
+           mValues;      // contains scaling factor, rotation angle and translation offset for (x, y, z),
+
+    // Sets up the cube, the cameras and the input values, and draws the static parts of the screen into target.
+    void InitScene( renderTarget *target );
+
+    // Renders one frame: builds the transformation matrix from mValues, renders the cube and displays the info. Only
+    // what changed since the last frame is redone: the cube is only projected again if the scene, the camera or the
+    // render mode changed, and the matrix info is only drawn if its values changed. If nothing changed at all, nothing
+    // is drawn, and false is returned - the render target then still shows the last frame.
+    bool RenderFrame();
+
+    // Makes the next RenderFrame() redo everything, for instance because the contents of the render target were lost
+    void Invalidate();
+
+private:
+    renderTarget *pTarget = nullptr;
+
+    mesh    meshCube;
+    texture texChecker;    // the texture of the cube
+
+    sceneGraph graph;       // the objects of the scene
+    int        nCubeNode;
+
+    tileRasterizer rasterizer;   // multithreaded rasterizer for the filled render modes
+
+    // The per frame data. The raster list is cleared every frame but keeps its capacity, and the arena (used for the
+    // text output) is reset every frame, so once the buffers have grown to their working size a frame doesn't allocate
+    // any heap memory.
+    rasterList trianglesToRaster;
+    frameArena arena;
+
+    // The inputs of the last drawn frame, see RenderFrame()
+    struct frameState {
+        // what trianglesToRaster depends on
+        uint32_t nSceneVersion = 0, nMeshVersions = 0, nCameraVersion = 0;
+        short    nRenderMode   = RM_UNKNOWN;
+        bool     bDepthTest    = false;
+        // what the pixels of the cube viewport depend on as well
+        int      nTextureFilter = TEXTURE_FILTER_NONE;
+        // what the matrix info shows
+        mat4x4   mValues, mTransform;
+        float    fFoV = 0.0f, fNear = 0.0f, fFar = 0.0f;
+    };
+    frameState lastFrame;
+    bool       bLastFrameValid = false;
+
+    // Renders the triangles into the viewport of camera cam
+    void RenderTriangles( camera &cam, rasterList &trisToRender );
+
+    void DisplayMatrix( mat4x4 mTrf, mat4x4 mVal, int x, int y );
+    void DisplayProjInfo( float fFieldOfView, float fNearPlane, float fFarPlane, int x, int y );
+    // only displays something if the profiler is compiled in (see profiler.h)
+    void DisplayProfiler( int x, int y );
+
+    // auxiliary function for initializing cube
+    triangle make_tri( float f01, float f02, float f03, float f04,
+                       float f05, float f06, float f07, float f08,
+                       float f09, float f10, float f11, float f12,
+                       float f13, float f14, float f15,
+                       float f16, float f17, float f18,
+                       float f19, float f20, float f21 );
+};
+
+#endif // DEMO_SCENE_H
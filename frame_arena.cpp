@@ -0,0 +1,87 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include   <cstdarg>
+#include    <cstdio>
+#include   <cstdlib>
+#include       <new>
+
+frameArena::frameArena( size_t nInitialSize ) {
+    AddBlock( std::max( nInitialSize, (size_t)256 ));
+}
+
+frameArena::~frameArena() {
+    for (auto &b : vecBlocks)
+        std::free( b.pData );
+}
+
+void frameArena::AddBlock( size_t nSize ) {
+    block b;
+    b.pData = static_cast<char *>( std::malloc( nSize ));
+    if (b.pData == nullptr)
+        throw std::bad_alloc();
+    b.nSize = nSize;
+    if (!vecBlocks.empty())
+        nUsedBefore += nUsed;
+    vecBlocks.push_back( b );
+    nUsed = 0;
+}
+
+void *frameArena::Allocate( size_t nSize, size_t nAlign ) {
+    // malloc() aligns the blocks to max_align_t, so aligning the offset suffices for the usual alignments
+    block &b = vecBlocks.back();
+    size_t nStart = (nUsed + nAlign - 1) & ~(nAlign - 1);
+    if (nStart + nSize > b.nSize) {
+        // doesn't fit: continue in a new block, that is at least twice as large as the current one
+        AddBlock( std::max( 2 * b.nSize, nSize + nAlign ));
+        return Allocate( nSize, nAlign );
+    }
+    nUsed = nStart + nSize;
+    return vecBlocks.back().pData + nStart;
+}
+
+char *frameArena::Format( const char *sFormat, ... ) {
+    block &b = vecBlocks.back();
+    size_t nAvailable = b.nSize - nUsed;
+
+    // try to format into the rest of the current block, and retry in a new block if that is too small
+    va_list args, argsCopy;
+    va_start( args, sFormat );
+    va_copy( argsCopy, args );
+    int nLength = std::vsnprintf( b.pData + nUsed, nAvailable, sFormat, args );
+    va_end( args );
+
+    char *sResult;
+    if (nLength < 0) {
+        sResult = static_cast<char *>( Allocate( 1, 1 ));
+        sResult[0] = '\0';
+    } else if ((size_t)nLength < nAvailable) {
+        sResult = b.pData + nUsed;
+        nUsed += nLength + 1;
+    } else {
+        sResult = static_cast<char *>( Allocate( nLength + 1, 1 ));
+        std::vsnprintf( sResult, nLength + 1, sFormat, argsCopy );
+    }
+    va_end( argsCopy );
+    return sResult;
+}
+
+void frameArena::Reset() {
+    if (vecBlocks.size() > 1) {
+        // the frame didn't fit in one block: replace all blocks by one that is large enough
+        size_t nTotal = Capacity();
+        for (auto &b : vecBlocks)
+            std::free( b.pData );
+        vecBlocks.clear();
+        AddBlock( nTotal );
+    }
+    nUsed       = 0;
+    nUsedBefore = 0;
+}
+
+size_t frameArena::Capacity() {
+    size_t nTotal = 0;
+    for (auto &b : vecBlocks)
+        nTotal += b.nSize;
+    return nTotal;
+}
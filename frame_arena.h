@@ -0,0 +1,55 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include     <cstddef>
+#include <type_traits>
+#include      <vector>
+
+// A linear ("bump") allocator for data that only lives during one frame. An allocation just advances a pointer in a
+// block of memory, and Reset() - called once at the start of every frame - releases everything at once. Nothing is
+// freed individually and no destructors are called, so only use it for trivially destructible data (arrays of numbers,
+// text, ...).
+//
+// If a frame needs more than the current block, extra blocks are allocated. The next Reset() replaces them all by a
+// single block that is large enough for the whole frame, so after the first few frames the arena doesn't touch the
+// heap anymore.
+class frameArena {
+public:
+    explicit frameArena( size_t nInitialSize = 64 * 1024 );
+    ~frameArena();
+
+    frameArena( const frameArena & ) = delete;
+    frameArena &operator = ( const frameArena & ) = delete;
+
+    // Returns nSize bytes of memory, aligned to nAlign (a power of two), that stay valid until the next Reset()
+    void *Allocate( size_t nSize, size_t nAlign = alignof( std::max_align_t ));
+
+    // Returns an uninitialised array of nCount elements of type T
+    template <typename T>
+    T *AllocateArray( size_t nCount ) {
+        static_assert( std::is_trivially_destructible<T>::value, "frameArena doesn't call destructors" );
+        return static_cast<T *>( Allocate( nCount * sizeof( T ), alignof( T )));
+    }
+
+    // Formats the arguments like printf() into a string in the arena, and returns it
+    char *Format( const char *sFormat, ... );
+
+    // Releases all allocations of the frame
+    void Reset();
+
+    size_t BytesUsed() { return nUsedBefore + nUsed; }    // allocated since the last Reset()
+    size_t Capacity();                                     // total size of the blocks
+
+private:
+    struct block {
+        char  *pData;
+        size_t nSize;
+    };
+    std::vector<block> vecBlocks;    // the last block is the one that is allocated from
+    size_t nUsed       = 0;          // bytes used in the last block
+    size_t nUsedBefore = 0;          // bytes used in the other blocks
+
+    void AddBlock( size_t nSize );
+};
+
+#endif // FRAME_ARENA_H
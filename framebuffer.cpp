@@ -0,0 +1,174 @@
+#include "framebuffer.h"
+
+#include     <array>
+#include <algorithm>
+#include    <cstdio>
+#include   <cstdlib>
+
+frameBuffer::frameBuffer( int nW, int nH ) : nWidth( nW ), nHeight( nH ), vecPixels( nW * nH, COL_BLACK ) {}
+
+void frameBuffer::Draw( int x, int y, uint32_t nColour ) {
+    if (x >= 0 && x < nWidth && y >= 0 && y < nHeight)
+        vecPixels[y * nWidth + x] = nColour;
+}
+
+void frameBuffer::FillRect( int x, int y, int w, int h, uint32_t nColour ) {
+    int x1 = std::max( x, 0 ), x2 = std::min( x + w, nWidth  );
+    int y1 = std::max( y, 0 ), y2 = std::min( y + h, nHeight );
+    for (int j = y1; j < y2; j++)
+        std::fill( vecPixels.begin() + j * nWidth + x1, vecPixels.begin() + j * nWidth + std::max( x1, x2 ), nColour );
+}
+
+// Bresenham's line algorithm - both end points are drawn
+void frameBuffer::DrawLine( int x1, int y1, int x2, int y2, uint32_t nColour ) {
+    int dx =  std::abs( x2 - x1 ), sx = x1 < x2 ? 1 : -1;
+    int dy = -std::abs( y2 - y1 ), sy = y1 < y2 ? 1 : -1;
+    int nError = dx + dy;
+    while (true) {
+        Draw( x1, y1, nColour );
+        if (x1 == x2 && y1 == y2)
+            break;
+        int e2 = 2 * nError;
+        if (e2 >= dy) { nError += dy; x1 += sx; }
+        if (e2 <= dx) { nError += dx; y1 += sy; }
+    }
+}
+
+// Fills all pixels whose centre is inside or on the edge of the triangle
+void frameBuffer::FillTriangle( int x1, int y1, int x2, int y2, int x3, int y3, uint32_t nColour ) {
+    int nMinX = std::max( std::min( { x1, x2, x3 } ), 0 ), nMaxX = std::min( std::max( { x1, x2, x3 } ), nWidth  - 1 );
+    int nMinY = std::max( std::min( { y1, y2, y3 } ), 0 ), nMaxY = std::min( std::max( { y1, y2, y3 } ), nHeight - 1 );
+
+    // with integer coordinates the edge functions can be evaluated exactly
+    auto edge = []( int ax, int ay, int bx, int by, int px, int py ) {
+        return (int64_t)(bx - ax) * (py - ay) - (int64_t)(by - ay) * (px - ax);
+    };
+    int64_t nArea = edge( x1, y1, x2, y2, x3, y3 );
+    if (nArea == 0) {
+        // degenerate triangle - draw it as lines so that it doesn't disappear
+        DrawTriangle( x1, y1, x2, y2, x3, y3, nColour );
+        return;
+    }
+    for (int y = nMinY; y <= nMaxY; y++) {
+        for (int x = nMinX; x <= nMaxX; x++) {
+            int64_t w0 = edge( x2, y2, x3, y3, x, y );
+            int64_t w1 = edge( x3, y3, x1, y1, x, y );
+            int64_t w2 = edge( x1, y1, x2, y2, x, y );
+            // inside if all edge functions have the sign of the area (either winding order is accepted)
+            if (nArea > 0 ? (w0 >= 0 && w1 >= 0 && w2 >= 0) : (w0 <= 0 && w1 <= 0 && w2 <= 0))
+                vecPixels[y * nWidth + x] = nColour;
+        }
+    }
+}
+
+bool frameBuffer::SavePPM( const std::string &sFileName ) {
+    FILE *pFile = std::fopen( sFileName.c_str(), "wb" );
+    if (pFile == nullptr)
+        return false;
+    std::fprintf( pFile, "P6\n%d %d\n255\n", nWidth, nHeight );
+    std::vector<uint8_t> vecRow( nWidth * 3 );
+    bool bOk = true;
+    for (int y = 0; y < nHeight && bOk; y++) {
+        for (int x = 0; x < nWidth; x++) {
+            uint32_t nPixel = vecPixels[y * nWidth + x];
+            vecRow[3 * x + 0] = (uint8_t)Colour_R( nPixel );
+            vecRow[3 * x + 1] = (uint8_t)Colour_G( nPixel );
+            vecRow[3 * x + 2] = (uint8_t)Colour_B( nPixel );
+        }
+        bOk = std::fwrite( vecRow.data(), 1, vecRow.size(), pFile ) == vecRow.size();
+    }
+    return (std::fclose( pFile ) == 0) && bOk;
+}
+
+// ==============================/   PNG output    /==============================
+
+// The PNG file format needs a zlib stream for the image data. To keep things simple (and fast) the data is not
+// compressed, but stored in deflate blocks of type 0. The zlib stream ends with an adler32 checksum, and every
+// chunk of the file with a crc32 checksum.
+
+static uint32_t Png_Crc32( const uint8_t *pData, size_t nSize, uint32_t nCrc = 0 ) {
+    static const std::array<uint32_t, 256> nTable = []() {
+        std::array<uint32_t, 256> t;
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+            t[n] = c;
+        }
+        return t;
+    }();
+    nCrc = ~nCrc;
+    for (size_t i = 0; i < nSize; i++)
+        nCrc = nTable[(nCrc ^ pData[i]) & 0xFF] ^ (nCrc >> 8);
+    return ~nCrc;
+}
+
+static void Png_PutUint32( std::vector<uint8_t> &vecOut, uint32_t n ) {
+    vecOut.push_back( (uint8_t)(n >> 24) );
+    vecOut.push_back( (uint8_t)(n >> 16) );
+    vecOut.push_back( (uint8_t)(n >>  8) );
+    vecOut.push_back( (uint8_t) n        );
+}
+
+// appends a chunk (length, type, data, crc) to vecOut
+static void Png_PutChunk( std::vector<uint8_t> &vecOut, const char *sType, const std::vector<uint8_t> &vecData ) {
+    Png_PutUint32( vecOut, (uint32_t)vecData.size() );
+    size_t nStart = vecOut.size();
+    vecOut.insert( vecOut.end(), sType, sType + 4 );
+    vecOut.insert( vecOut.end(), vecData.begin(), vecData.end() );
+    Png_PutUint32( vecOut, Png_Crc32( vecOut.data() + nStart, vecOut.size() - nStart ));
+}
+
+bool frameBuffer::SavePNG( const std::string &sFileName ) {
+    // the raw image data: each row starts with a filter type byte (0 = none), followed by the RGB values
+    std::vector<uint8_t> vecRaw;
+    vecRaw.reserve( (size_t)nHeight * (1 + 3 * nWidth) );
+    for (int y = 0; y < nHeight; y++) {
+        vecRaw.push_back( 0 );
+        for (int x = 0; x < nWidth; x++) {
+            uint32_t nPixel = vecPixels[y * nWidth + x];
+            vecRaw.push_back( (uint8_t)Colour_R( nPixel ));
+            vecRaw.push_back( (uint8_t)Colour_G( nPixel ));
+            vecRaw.push_back( (uint8_t)Colour_B( nPixel ));
+        }
+    }
+
+    // wrap it in a zlib stream of stored deflate blocks (at most 65535 bytes each)
+    std::vector<uint8_t> vecZlib = { 0x78, 0x01 };
+    size_t nPos = 0;
+    do {
+        size_t nLen = std::min( vecRaw.size() - nPos, (size_t)65535 );
+        bool   bLast = (nPos + nLen == vecRaw.size());
+        vecZlib.push_back( bLast ? 1 : 0 );
+        vecZlib.push_back( (uint8_t)( nLen       & 0xFF) );
+        vecZlib.push_back( (uint8_t)((nLen >> 8) & 0xFF) );
+        vecZlib.push_back( (uint8_t)(~nLen       & 0xFF) );
+        vecZlib.push_back( (uint8_t)((~nLen >> 8) & 0xFF) );
+        vecZlib.insert( vecZlib.end(), vecRaw.begin() + nPos, vecRaw.begin() + nPos + nLen );
+        nPos += nLen;
+    } while (nPos < vecRaw.size());
+
+    uint32_t a = 1, b = 0;
+    for (uint8_t c : vecRaw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    Png_PutUint32( vecZlib, (b << 16) | a );
+
+    // IHDR: width, height, bit depth 8, colour type 2 (RGB), compression, filter and interlace method 0
+    std::vector<uint8_t> vecHeader;
+    Png_PutUint32( vecHeader, (uint32_t)nWidth  );
+    Png_PutUint32( vecHeader, (uint32_t)nHeight );
+    vecHeader.insert( vecHeader.end(), { 8, 2, 0, 0, 0 } );
+
+    std::vector<uint8_t> vecFile = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    Png_PutChunk( vecFile, "IHDR", vecHeader );
+    Png_PutChunk( vecFile, "IDAT", vecZlib );
+    Png_PutChunk( vecFile, "IEND", {} );
+
+    FILE *pFile = std::fopen( sFileName.c_str(), "wb" );
+    if (pFile == nullptr)
+        return false;
+    bool bOk = std::fwrite( vecFile.data(), 1, vecFile.size(), pFile ) == vecFile.size();
+    return (std::fclose( pFile ) == 0) && bOk;
+}
@@ -0,0 +1,38 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <cstdint>
+#include  <string>
+#include  <vector>
+
+#include "render_target.h"
+
+// A render target in memory. It doesn't need a window, so the complete rendering pipeline can run headless (for
+// regression tests and benchmarks). The contents can be written to file as PPM or PNG image.
+// Text output is not supported (DrawString() does nothing).
+class frameBuffer : public renderTarget {
+public:
+    frameBuffer( int nWidth, int nHeight );
+
+    int ScreenWidth()  override { return nWidth;  }
+    int ScreenHeight() override { return nHeight; }
+    uint32_t *GetPixels() override { return vecPixels.data(); }
+
+    void FillRect( int x, int y, int w, int h, uint32_t nColour ) override;
+    void DrawLine( int x1, int y1, int x2, int y2, uint32_t nColour ) override;
+    void FillTriangle( int x1, int y1, int x2, int y2, int x3, int y3, uint32_t nColour ) override;
+
+    // sets pixel (x, y) to nColour, if it's within the buffer
+    void Draw( int x, int y, uint32_t nColour );
+
+    // Write the contents to file as binary PPM (P6) resp. PNG (RGB, 8 bits per channel, uncompressed).
+    // Both return false if the file couldn't be written.
+    bool SavePPM( const std::string &sFileName );
+    bool SavePNG( const std::string &sFileName );
+
+private:
+    int nWidth, nHeight;
+    std::vector<uint32_t> vecPixels;
+};
+
+#endif // FRAMEBUFFER_H
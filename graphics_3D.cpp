@@ -1,4 +1,9 @@
 #include "graphics_3D.h"
+#include    "profiler.h"
+
+#include <cmath>
+#include   <map>
+#include <tuple>
 
 //// To prevent all kinds of include problems I redefined some constants from olcConsoleGameEngine.h here.
 //// I need these constants because the functions GetColour() depend on them.
@@ -9,8 +14,16 @@
 //#define PIXEL_QUARTER           0x2591
 
 short glbRenderMode = RM_GREYFILLED_PLUS;
+bool  glbDepthTest  = true;
+int   glbTextureFilter = TEXTURE_FILTER_BILINEAR;
 float *pDepthBuffer = nullptr;
 
+// The filled and textured modes are drawn with a per pixel depth test, the wire frame modes are not
+bool DepthTestActive() {
+    return glbDepthTest && (glbRenderMode == RM_GREYFILLED || glbRenderMode == RM_GREYFILLED_PLUS ||
+                            glbRenderMode == RM_TEXTURED   || glbRenderMode == RM_TEXTURED_PLUS );
+}
+
 void InitDepthBuffer( int nScreenW, int nScreenH ) {
     // Depth buffer: every pixel on the screen has an associated floating point depth value
     pDepthBuffer = new float[nScreenW * nScreenH];
@@ -23,6 +36,180 @@ void ClearDepthBuffer( int nScreenW, int x1, int y1, int x2, int y2 ) {
             pDepthBuffer[ y * nScreenW + x ] = 0.0f;
 }
 
+// ==============================/   Materials    /==============================
+
+// The material table - a function local static, so that it is initialised (with the default material) before its
+// first use, even if that is during static initialisation
+static std::vector<material> &MaterialTable() {
+    static std::vector<material> vecMaterials( 1 );
+    return vecMaterials;
+}
+
+uint16_t Material_Add( const material &mat ) {
+    std::vector<material> &vecMaterials = MaterialTable();
+    if ((int)vecMaterials.size() >= MATERIAL_MAX)
+        return MATERIAL_DEFAULT;
+    vecMaterials.push_back( mat );
+    return (uint16_t)(vecMaterials.size() - 1);
+}
+
+const material &Material_Get( uint16_t nMaterial ) {
+    return MaterialTable()[nMaterial];
+}
+
+int Material_Count() {
+    return (int)MaterialTable().size();
+}
+
+// ==============================/   Meshes    /==============================
+
+// Builds indexed mesh m from the triangles in vecTris. Vertices with identical coordinates are merged.
+void Mesh_FromTriangles( std::vector<triangle> &vecTris, mesh &m ) {
+    // maps the coordinates of each unique vertex to its index in the vertex buffer
+    std::map<std::tuple<float, float, float, float>, uint32_t> mapVertices;
+    std::vector<vec3d> vecUnique;
+
+    Mesh_ClearView( m );
+    m.indices.clear();
+    m.texs.clear();
+    for (auto &tri : vecTris) {
+        for (int i = 0; i < 3; i++) {
+            auto key = std::make_tuple( tri.p[i].x, tri.p[i].y, tri.p[i].z, tri.p[i].w );
+            auto it  = mapVertices.find( key );
+            if (it == mapVertices.end()) {
+                it = mapVertices.insert( { key, (uint32_t)vecUnique.size() } ).first;
+                vecUnique.push_back( tri.p[i] );
+            }
+            m.indices.push_back( it->second );
+            m.texs.push_back( tri.t[i] );
+        }
+    }
+    VertexStream_Resize( m.verts, (int)vecUnique.size() );
+    for (int i = 0; i < (int)vecUnique.size(); i++)
+        VertexStream_Set( m.verts, i, vecUnique[i] );
+
+    m.nMaterial = MATERIAL_DEFAULT;
+    if (!vecTris.empty() && vecTris[0].renderMode != RM_UNKNOWN) {
+        material mat;
+        mat.renderMode = vecTris[0].renderMode;
+        m.nMaterial = Material_Add( mat );
+    }
+    Mesh_ComputeBounds( m );
+}
+
+// The bounding sphere is centred on the bounding box, with a radius that just encloses all vertices.
+// This isn't the smallest possible sphere, but it is close enough for culling.
+void Mesh_ComputeBounds( mesh &m ) {
+    m.nVersion++;
+    meshBuffers v = Mesh_GetBuffers( m );
+    if (v.nVerts == 0) {
+        m.vBoundsMin = m.vBoundsMax = m.vSphereCentre = { 0.0f, 0.0f, 0.0f };
+        m.fSphereRadius = 0.0f;
+        return;
+    }
+    m.vBoundsMin = m.vBoundsMax = { v.x[0], v.y[0], v.z[0] };
+    for (int i = 1; i < v.nVerts; i++) {
+        m.vBoundsMin.x = std::min( m.vBoundsMin.x, v.x[i] );  m.vBoundsMax.x = std::max( m.vBoundsMax.x, v.x[i] );
+        m.vBoundsMin.y = std::min( m.vBoundsMin.y, v.y[i] );  m.vBoundsMax.y = std::max( m.vBoundsMax.y, v.y[i] );
+        m.vBoundsMin.z = std::min( m.vBoundsMin.z, v.z[i] );  m.vBoundsMax.z = std::max( m.vBoundsMax.z, v.z[i] );
+    }
+    m.vSphereCentre = { 0.5f * (m.vBoundsMin.x + m.vBoundsMax.x),
+                        0.5f * (m.vBoundsMin.y + m.vBoundsMax.y),
+                        0.5f * (m.vBoundsMin.z + m.vBoundsMax.z) };
+    float fMaxDist2 = 0.0f;
+    for (int i = 0; i < v.nVerts; i++) {
+        float dx = v.x[i] - m.vSphereCentre.x, dy = v.y[i] - m.vSphereCentre.y, dz = v.z[i] - m.vSphereCentre.z;
+        fMaxDist2 = std::max( fMaxDist2, dx * dx + dy * dy + dz * dz );
+    }
+    m.fSphereRadius = sqrtf( fMaxDist2 );
+}
+
+// Returns the number of triangles in mesh m
+int Mesh_TriangleCount( mesh &m ) {
+    return (m.pViewOwner != nullptr) ? m.viewBuffers.nTris : (int)m.indices.size() / 3;
+}
+
+meshBuffers Mesh_GetBuffers( mesh &m ) {
+    if (m.pViewOwner != nullptr)
+        return m.viewBuffers;
+    meshBuffers b;
+    b.x       = m.verts.x.data();
+    b.y       = m.verts.y.data();
+    b.z       = m.verts.z.data();
+    b.w       = m.verts.w.data();
+    b.indices = m.indices.data();
+    b.texs    = m.texs.data();
+    b.nVerts  = m.verts.nCount;
+    b.nTris   = (int)m.indices.size() / 3;
+    return b;
+}
+
+void Mesh_ClearView( mesh &m ) {
+    m.viewBuffers = meshBuffers();
+    m.pViewOwner.reset();
+}
+
+// Assembles and returns triangle i of mesh m
+triangle Mesh_GetTriangle( mesh &m, int i ) {
+    meshBuffers b = Mesh_GetBuffers( m );
+    triangle tri;
+    for (int j = 0; j < 3; j++) {
+        uint32_t nIndex = b.indices[3 * i + j];
+        tri.p[j] = { b.x[nIndex], b.y[nIndex], b.z[nIndex], (b.w != nullptr) ? b.w[nIndex] : 1.0f };
+        tri.t[j] = b.texs[3 * i + j];
+    }
+    const material &mat = Material_Get( m.nMaterial );
+    tri.r = Colour_R( mat.nColour );
+    tri.g = Colour_G( mat.nColour );
+    tri.b = Colour_B( mat.nColour );
+    tri.renderMode = mat.renderMode;
+    return tri;
+}
+
+// The world space normal of a triangle follows from its world space vertices directly, so no normal matrix is needed
+void WorldMesh_Update( worldMesh &wm, mesh &m, const mat4x4 &worldMatrix, vec3d vLightDir ) {
+    PROFILE_SCOPE( "world transform" );
+
+    meshBuffers b = Mesh_GetBuffers( m );
+    wm.source    = b;
+    wm.nMaterial = m.nMaterial;
+    if (wm.verts.nCount != b.nVerts)
+        VertexStream_Resize( wm.verts, b.nVerts );
+    Matrix_MultiplyVectorStream( worldMatrix, b.x, b.y, b.z, b.w,
+                                 wm.verts.x.data(), wm.verts.y.data(), wm.verts.z.data(), wm.verts.w.data(), b.nVerts );
+
+    const float *x = wm.verts.x.data(), *y = wm.verts.y.data(), *z = wm.verts.z.data();
+    vec3d vLight = Vector_Normalise( vLightDir );
+    wm.vecLight.resize( b.nTris );
+    for (int i = 0; i < b.nTris; i++) {
+        uint32_t i0 = b.indices[3 * i], i1 = b.indices[3 * i + 1], i2 = b.indices[3 * i + 2];
+        vec3d line1  = { x[i1] - x[i0], y[i1] - y[i0], z[i1] - z[i0] };
+        vec3d line2  = { x[i2] - x[i0], y[i2] - y[i0], z[i2] - z[i0] };
+        vec3d normal = Vector_CrossProduct( line1, line2 );
+        normal = Vector_Normalise( normal );
+        wm.vecLight[i] = std::max( 0.0f, Vector_DotProduct( vLight, normal ));
+    }
+
+    // the world space bounding box of the vertices, and the bounding sphere of the mesh moved along
+    if (b.nVerts == 0) {
+        wm.vBoundsMin = wm.vBoundsMax = { 0.0f, 0.0f, 0.0f };
+    } else {
+        wm.vBoundsMin = wm.vBoundsMax = { x[0], y[0], z[0] };
+        for (int i = 1; i < b.nVerts; i++) {
+            wm.vBoundsMin.x = std::min( wm.vBoundsMin.x, x[i] );  wm.vBoundsMax.x = std::max( wm.vBoundsMax.x, x[i] );
+            wm.vBoundsMin.y = std::min( wm.vBoundsMin.y, y[i] );  wm.vBoundsMax.y = std::max( wm.vBoundsMax.y, y[i] );
+            wm.vBoundsMin.z = std::min( wm.vBoundsMin.z, z[i] );  wm.vBoundsMax.z = std::max( wm.vBoundsMax.z, z[i] );
+        }
+    }
+    float fScale = 0.0f;
+    for (int r = 0; r < 3; r++) {
+        vec3d vRow = { worldMatrix.m[r][0], worldMatrix.m[r][1], worldMatrix.m[r][2] };
+        fScale = std::max( fScale, Vector_Length( vRow ));
+    }
+    wm.vSphereCentre = Matrix_MultiplyVector( worldMatrix, m.vSphereCentre );
+    wm.fSphereRadius = m.fSphereRadius * fScale;
+}
+
 // A camera is defined by its location and orientation (in world space).
 // Since the pitch, yaw and roll determine the orientation they are stored in the camera as well.
 // The resulting projection and view matrices are part of the camera structure.
@@ -30,7 +217,7 @@ void ClearDepthBuffer( int nScreenW, int x1, int y1, int x2, int y2 ) {
 
 // Initializes the camera using the parameters. Calculates camera's projection matrix as well.
 
-void camera::InitCamera( olc::PixelGameEngine *engine, std::string name, int x1, int y1, int x2, int y2,
+void camera::InitCamera( renderTarget *target, std::string name, int x1, int y1, int x2, int y2,
                         float fieldOfViewInDegrees, float nearPlaneDistance, float farPlaneDistance ) {
     sCameraName = name;
 
@@ -46,26 +233,68 @@ void camera::InitCamera( olc::PixelGameEngine *engine, std::string name, int x1,
     nViewPortWidth  = x2 - x1;
     nViewPortHeight = y2 - y1;
 
-    fNearPlane = nearPlaneDistance;     // save these plane distances - they're needed for clipping
-    fFarPlane  = farPlaneDistance;
+    fNearPlane   = nearPlaneDistance;     // save these plane distances - they're needed for clipping
+    fFarPlane    = farPlaneDistance;
+    fFieldOfView = fieldOfViewInDegrees;
     // Projection matrix is only determined once (at init time), because viewport dimensions and field of view
     // are not going to change in the application.
     // Input paramters are: field of view (in degrees), aspect ratio, near plane, far plane
     matProj = Matrix_MakeProjection( fieldOfViewInDegrees, (float)nViewPortHeight / (float)nViewPortWidth, nearPlaneDistance, farPlaneDistance );
+    UpdateFrustum();
 
     minRGBvalue =   0;
     maxRGBvalue = 255;
 
-    gfxEngine = engine;
+    gfxTarget = target;
 }
 
 void camera::UpdateCamera( float fieldOfViewInDegrees, float nearPlaneDistance, float farPlaneDistance ) {
 
-    fNearPlane = nearPlaneDistance;     // save these plane distances - they're needed for clipping
-    fFarPlane  = farPlaneDistance;
+    // the callers typically pass their current settings every frame, so only recompute if they changed
+    if (fieldOfViewInDegrees == fFieldOfView && nearPlaneDistance == fNearPlane && farPlaneDistance == fFarPlane)
+        return;
+
+    fNearPlane   = nearPlaneDistance;     // save these plane distances - they're needed for clipping
+    fFarPlane    = farPlaneDistance;
+    fFieldOfView = fieldOfViewInDegrees;
 
     // Input paramters are: field of view (in degrees), aspect ratio, near plane, far plane
     matProj = Matrix_MakeProjection( fieldOfViewInDegrees, (float)nViewPortHeight / (float)nViewPortWidth, nearPlaneDistance, farPlaneDistance );
+    UpdateFrustum();
+}
+
+// A point p (with w = 1) in world space ends up in clip space as p * matViewProj, so for instance clip x equals the dot
+// product of p with column 0 of matViewProj. The frustum planes in clip space (see ClipOutcode()) can therefore be
+// written as combinations of the columns, which gives the planes in world space directly.
+void camera::UpdateFrustum() {
+    nVersion++;
+    matViewProj = Matrix_MultiplyMatrix( matView, matProj );
+
+    // get the columns of matViewProj as planes
+    plane col[4];
+    for (int c = 0; c < 4; c++) {
+        col[c].n = { matViewProj.m[0][c], matViewProj.m[1][c], matViewProj.m[2][c] };
+        col[c].d =   matViewProj.m[3][c];
+    }
+    // -w <= x <= w, -w <= y <= w, 0 <= z and z <= 1 (where 1 is written as the dot product of p with (0, 0, 0, 1))
+    float fSign[4] = { 1.0f, -1.0f, 1.0f, -1.0f };
+    for (int i = 0; i < 4; i++) {
+        plane &axis = col[i / 2];
+        frustum[i].n = { col[3].n.x + fSign[i] * axis.n.x, col[3].n.y + fSign[i] * axis.n.y, col[3].n.z + fSign[i] * axis.n.z };
+        frustum[i].d =   col[3].d   + fSign[i] * axis.d;
+    }
+    frustum[4]   = col[2];
+    frustum[5].n = { -col[2].n.x, -col[2].n.y, -col[2].n.z };
+    frustum[5].d = 1.0f - col[2].d;
+
+    // normalise the planes, so that Plane_Distance() gives true distances (needed for the bounding sphere test)
+    for (int i = 0; i < 6; i++) {
+        float fLen = Vector_Length( frustum[i].n );
+        if (fLen > 0.0f) {
+            frustum[i].n = Vector_Div( frustum[i].n, fLen );
+            frustum[i].d /= fLen;
+        }
+    }
 }
 
 // ==============================/   Rendering code    /==============================
@@ -77,15 +306,16 @@ void camera::ClearCameraViewPort( bool viewPortBorder ) {
     int x2 = nViewPortX2;
     int y2 = nViewPortY2;
 
-    gfxEngine->FillRect( x1 - 1, y1 - 1, x2 - x1 + 1, y2 - y1 + 1, olc::BLACK );
+    // the viewport is drawn into up to and including x2 and y2, so these are cleared as well
+    gfxTarget->FillRect( x1 - 1, y1 - 1, x2 - x1 + 2, y2 - y1 + 2, COL_BLACK );
     if (viewPortBorder) {
         for (int i = 0; i < 2; i++)
-            gfxEngine->DrawRect( x1 - 1 - i, y1 - 1 - i, (x2 + i) - (x1 - 1 - i), (y2 + i) - (y1 - 1 - i), olc::YELLOW );
+            gfxTarget->DrawRect( x1 - 1 - i, y1 - 1 - i, (x2 + i) - (x1 - 1 - i), (y2 + i) - (y1 - 1 - i), COL_YELLOW );
         if (sCameraName.size() > 0)
-            gfxEngine->DrawString( x1 + 2, y1 + 2, sCameraName, olc::YELLOW );
+            gfxTarget->DrawString( x1 + 2, y1 + 2, sCameraName.c_str(), COL_YELLOW );
     }
     // the depth buffer part corresponding to this viewport is also cleared
-    ClearDepthBuffer( gfxEngine->ScreenWidth(), x1, y1, x2 + 1, y2 + 1 );
+    ClearDepthBuffer( gfxTarget->ScreenWidth(), x1, y1, x2 + 1, y2 + 1 );
 }
 
     // Whenever the fCameraPitch, -Yaw and/or -Roll are changed, this function can be called to recalculate both
@@ -117,9 +347,10 @@ void camera::RecalculateCamera() {
     mat4x4 matCamera = Matrix_PointAt( vPosition, vTarget, vUp );
     // Apply the quick inverse on the PointAt matrix to calculate the View matrix (the PointAt matrix is no longer used hereafter).
     matView = Matrix_QuickInverse( matCamera );
+    UpdateFrustum();
 }
 
-void camera::Tri_PropagateColourInfo( triangle triIn, triangle &triOut ) {
+void camera::Tri_PropagateColourInfo( const triangle &triIn, triangle &triOut ) {
     triOut.r = triIn.r;
     triOut.g = triIn.g;
     triOut.b = triIn.b;
@@ -130,10 +361,17 @@ void camera::Tri_PropagateColourInfo( triangle triIn, triangle &triOut ) {
 
 // Performs a (generic) transform from triIn to triOut, using transformation matrix trfMatrix.
 // The texture coordinates as well as the col and sym values of the triangle are propagated from triIn to triOut.
-void camera::Tri_Transform( triangle &triIn, mat4x4 trfMatrix, triangle &triOut ) {
-    // transform each vertex of the triangle
+// This is a thin wrapper around the batch kernel Matrix_MultiplyVectorStream(): the three vertices are
+// gathered into small SoA arrays, transformed, and scattered into triOut.
+void camera::Tri_Transform( triangle &triIn, mat4x4 &trfMatrix, triangle &triOut ) {
+    float xIn[3], yIn[3], zIn[3], wIn[3], xOut[3], yOut[3], zOut[3], wOut[3];
+    for (int i = 0; i < 3; i++) {
+        xIn[i] = triIn.p[i].x; yIn[i] = triIn.p[i].y; zIn[i] = triIn.p[i].z; wIn[i] = triIn.p[i].w;
+    }
+    Matrix_MultiplyVectorStream( trfMatrix, xIn, yIn, zIn, wIn, xOut, yOut, zOut, wOut, 3 );
+    // put the transformed vertices into the output triangle, and propagate the texture coordinates
     for (int i = 0; i < 3; i++) {
-        triOut.p[i] = Matrix_MultiplyVector( trfMatrix, triIn.p[i] );
+        triOut.p[i] = { xOut[i], yOut[i], zOut[i], wOut[i] };
         triOut.t[i] = triIn.t[i];
     }
     // propagate colour info to transformed triangle
@@ -146,6 +384,30 @@ void camera::Tri_WorldTransform( triangle &triIn, mat4x4 &worldMatrix, triangle
     Tri_Transform( triIn, worldMatrix, triOut );
 }
 
+// Batch world transformation: all vertices of all triangles in vecIn are put in one vertex stream, which is
+// transformed in a single call. The results are put into the triangles of vecOut.
+void camera::Tri_WorldTransform( std::vector<triangle> &vecIn, mat4x4 &worldMatrix, std::vector<triangle> &vecOut ) {
+    // these streams are reused between calls to prevent reallocation for every batch
+    static thread_local vertexStream sModel, sWorld;
+
+    int nVertices = (int)vecIn.size() * 3;
+    VertexStream_Resize( sModel, nVertices );
+    for (int i = 0; i < (int)vecIn.size(); i++)
+        for (int j = 0; j < 3; j++)
+            VertexStream_Set( sModel, 3 * i + j, vecIn[i].p[j] );
+
+    Matrix_MultiplyVertexStream( worldMatrix, sModel, sWorld );
+
+    vecOut.resize( vecIn.size() );
+    for (int i = 0; i < (int)vecIn.size(); i++) {
+        for (int j = 0; j < 3; j++) {
+            vecOut[i].p[j] = VertexStream_Get( sWorld, 3 * i + j );
+            vecOut[i].t[j] = vecIn[i].t[j];
+        }
+        Tri_PropagateColourInfo( vecIn[i], vecOut[i] );
+    }
+}
+
 // Performs view transformation (from world to view space) using viewMatrix. As a result
 // the input triIn is transformed into triOut
 void camera::Tri_ViewTransform( triangle &triIn, mat4x4 &viewMatrix, triangle &triOut ) {
@@ -217,150 +479,637 @@ void camera::Tri_ScaleIntoCameraView( triangle &triIn, triangle &triOut ) {
     triOut.p[2].y = triOut.p[2].y * 0.5f * (float)nViewPortHeight + (float)nViewPortY1;
 }
 
-// Performs culling, view transform and projection transform in the triangle inputTri. Because of clipping
-// against the near plane, the result can be 0, 1 or 2 triangles, that are added to vecOfTris
-void camera::CullViewAndProjectTriangle( triangle &inputTri, std::vector<triangle> &vecOfTris, vec3d vLightDir ) {
+// Does the same as Tri_ScaleIntoCameraView() (with the same floating point operations, so the results are identical),
+// for one vertex
+rasterVertex camera::ScaleIntoCameraView( const vec3d &p, const vec2d &t ) {
+    rasterVertex r;
+    float x = p.x / p.w, y = -(p.y / p.w);
+    r.x  = (x + 1.0f) * 0.5f * (float)nViewPortWidth  + (float)nViewPortX1;
+    r.y  = (y + 1.0f) * 0.5f * (float)nViewPortHeight + (float)nViewPortY1;
+    r.z  = p.z / p.w;
+    r.iw = 1.0f / p.w;
+    r.u  = t.u / p.w;
+    r.v  = t.v / p.w;
+    return r;
+}
+
+// Backface culling in clip space: the determinant of the (x, y, w) rows of the vertices of a triangle is proportional to
+// the volume spanned by the camera and the triangle, so its sign tells which side of the triangle faces the camera. It
+// is negative for front faces. Returns true if the triangle faces away from the camera (or is seen exactly edge on).
+// It needs no world space vertices, so the mesh and the triangle paths use the same test.
+static bool ClipSpaceBackface( float x0, float y0, float w0, float x1, float y1, float w1, float x2, float y2, float w2 ) {
+    float fDet = x0 * (y1 * w2 - w1 * y2) -
+                 y0 * (x1 * w2 - w1 * x2) +
+                 w0 * (x1 * y2 - y1 * x2);
+    return fDet >= 0.0f;
+}
+
+// Performs culling, view transform, projection transform and clipping on the triangle inputTri. Because of clipping
+// against the frustum planes, the result can be 0 up to 7 triangles, that are added to out
+void camera::CullViewAndProjectTriangle( triangle &inputTri, rasterList &out, uint16_t nMaterial, vec3d vLightDir ) {
 
-    triangle triTransformed, triViewed, triProjected, triFinal;
-    std::vector<triangle> tmpVecOfTris;
+    PROFILE_COUNT( PROF_TRIS_IN, 1 );
 
-    // The triangle passed as input parameters must not change - make a copy to prevent the original being overwritten
-    triTransformed = inputTri;
+    // Transform from world space straight into clip space with the combined view and projection matrix. The input
+    // triangle is left unchanged.
+    triangle triProjected;
+    Tri_Transform( inputTri, matViewProj, triProjected );
 
-    // This is where the normals of the triangles are considered to see if triangles are visible or not.
-    vec3d normal, line1, line2;
-    // Get lines either side of the triangle
-    line1 = Vector_Sub( triTransformed.p[1], triTransformed.p[0] );   // determine line1 = line A
-    line2 = Vector_Sub( triTransformed.p[2], triTransformed.p[0] );   // determine line2 = line B
-    // Take cross product of lines to get normal vector to triangle surface
-    normal = Vector_CrossProduct( line1, line2 );
-    // Make sure the normal vector is normalized in length
+    // backface culling on the clip space vertices, the same test as in CullViewAndProjectMesh()
+    bool bNoCulling = (glbRenderMode == RM_WIREFRAME || glbRenderMode == RM_WIREFRAME_RGB);
+    if (!bNoCulling && ClipSpaceBackface( triProjected.p[0].x, triProjected.p[0].y, triProjected.p[0].w,
+                                          triProjected.p[1].x, triProjected.p[1].y, triProjected.p[1].w,
+                                          triProjected.p[2].x, triProjected.p[2].y, triProjected.p[2].w )) {
+        PROFILE_COUNT( PROF_TRIS_CULLED, 1 );
+        return;
+    }
+
+    // Add illumination, to make the 3d objects more intuitive
+    // Single direction lighting - light is shining towards the player. The normal is only needed for the lighting, so
+    // it is only computed (in world space) for the triangles that are visible.
+    vec3d line1  = Vector_Sub( inputTri.p[1], inputTri.p[0] );
+    vec3d line2  = Vector_Sub( inputTri.p[2], inputTri.p[0] );
+    vec3d normal = Vector_CrossProduct( line1, line2 );
     normal = Vector_Normalise( normal );
+    vec3d light_direction = Vector_Normalise( vLightDir );
+
+    // determine the alignment between the normal and the light direction
+    float dot_prod = std::max( 0.0f, Vector_DotProduct( light_direction, normal ));
+    // use the alignment to determine the grey shade
+    int nShade = GetColour2( dot_prod );     // alternatively use GetColour()
+
+    // clip against the frustum planes, and scale into the viewport
+    ClipAndScaleTriangle( triProjected, nMaterial, nShade, out );
+}
+
+// ==============================/   Clipping in clip space    /==============================
+
+// A vertex of the polygon that is being clipped
+struct clipVertex {
+    vec3d p;
+    vec2d t;
+};
+
+// Returns the outcode (see CLIP_LEFT etc.) for clip space point (x, y, z, w). With the projection matrix of
+// Matrix_MakeProjection() the frustum in clip space is given by -w <= x <= w, -w <= y <= w and 0 <= z <= 1
+// (z is mapped linearly from [near, far] to [0, 1], and w holds the view space z).
+// The guard band planes are at -w * fGuardX <= x <= w * fGuardX, and similar for y.
+static int ClipOutcode( float x, float y, float z, float w, float fGuardX, float fGuardY ) {
+    int nCode = 0;
+    if (x < -w          ) nCode |= CLIP_LEFT;
+    if (x >  w          ) nCode |= CLIP_RIGHT;
+    if (y < -w          ) nCode |= CLIP_BOTTOM;
+    if (y >  w          ) nCode |= CLIP_TOP;
+    if (z <  0.0f       ) nCode |= CLIP_NEAR;
+    if (z >  1.0f       ) nCode |= CLIP_FAR;
+    if (x < -w * fGuardX) nCode |= CLIP_GUARD_LEFT;
+    if (x >  w * fGuardX) nCode |= CLIP_GUARD_RIGHT;
+    if (y < -w * fGuardY) nCode |= CLIP_GUARD_BOTTOM;
+    if (y >  w * fGuardY) nCode |= CLIP_GUARD_TOP;
+    return nCode;
+}
 
-    // Backface culling is done by wrapping the projection code in an if block, depending on the normal
+// Returns the signed distance of clip space point p to the plane nPlane (one of the outcode bits in CLIP_MASK_CLIP).
+// The distance is positive on the inside, and is linear in p, so that it can be interpolated along an edge.
+static float ClipDistance( vec3d &p, int nPlane, float fGuardX, float fGuardY ) {
+    switch (nPlane) {
+        case CLIP_NEAR        : return p.z;
+        case CLIP_FAR         : return 1.0f - p.z;
+        case CLIP_GUARD_LEFT  : return p.w * fGuardX + p.x;
+        case CLIP_GUARD_RIGHT : return p.w * fGuardX - p.x;
+        case CLIP_GUARD_BOTTOM: return p.w * fGuardY + p.y;
+        case CLIP_GUARD_TOP   : return p.w * fGuardY - p.y;
+    }
+    return 0.0f;
+}
+
+// One step of the Sutherland-Hodgman algorithm: clips the convex polygon pIn (with nIn vertices) against plane nPlane,
+// and puts the result in pOut. For each edge the end vertex is kept if it is inside, and the intersection point
+// is added if the edge crosses the plane. Returns the number of vertices in pOut (at most CLIP_MAX_VERTICES).
+// Position and texture coordinates are interpolated linearly, which is correct in clip space (before the divide by w).
+static int ClipPolygonAgainstPlane( clipVertex *pIn, int nIn, clipVertex *pOut, int nPlane, float fGuardX, float fGuardY ) {
+    int nOut = 0;
+    clipVertex *pPrev = &pIn[nIn - 1];
+    float fPrevDist = ClipDistance( pPrev->p, nPlane, fGuardX, fGuardY );
+
+    for (int i = 0; i < nIn; i++) {
+        clipVertex *pCur = &pIn[i];
+        float fCurDist = ClipDistance( pCur->p, nPlane, fGuardX, fGuardY );
+
+        // the check on nOut only matters for degenerate (numerically non convex) polygons
+        if ((fPrevDist >= 0.0f) != (fCurDist >= 0.0f) && nOut < CLIP_MAX_VERTICES) {
+            float t = fPrevDist / (fPrevDist - fCurDist);
+            clipVertex &v = pOut[nOut++];
+            v.p.x = pPrev->p.x + t * (pCur->p.x - pPrev->p.x);
+            v.p.y = pPrev->p.y + t * (pCur->p.y - pPrev->p.y);
+            v.p.z = pPrev->p.z + t * (pCur->p.z - pPrev->p.z);
+            v.p.w = pPrev->p.w + t * (pCur->p.w - pPrev->p.w);
+            v.t.u = pPrev->t.u + t * (pCur->t.u - pPrev->t.u);
+            v.t.v = pPrev->t.v + t * (pCur->t.v - pPrev->t.v);
+            v.t.w = pPrev->t.w + t * (pCur->t.w - pPrev->t.w);
+        }
+        if (fCurDist >= 0.0f && nOut < CLIP_MAX_VERTICES)
+            pOut[nOut++] = *pCur;
 
-    // how much of the z-component of the triangles normal is aligned with the line
-    // between the camera position and the location of the normal.
+        pPrev     = pCur;
+        fPrevDist = fCurDist;
+    }
+    return nOut;
+}
 
-    // Get Ray from triangle to camera [ by subtracting 2 points you get a vector :))
-    // p[0] is used here, but any point on the plane will do
-    vec3d vCameraRay = Vector_Sub( triTransformed.p[0], vPosition );
+// The viewport spans 2 units in clip space (from -w to w), so n pixels of guard band correspond to 2 * n / width units
+void camera::GetGuardBandFactors( float &fGuardX, float &fGuardY ) {
+    fGuardX = 1.0f + 2.0f * (float)nGuardBand / (float)nViewPortWidth;
+    fGuardY = 1.0f + 2.0f * (float)nGuardBand / (float)nViewPortHeight;
+}
 
-    // culling if statement here!
-    if (glbRenderMode == RM_WIREFRAME || glbRenderMode == RM_WIREFRAME_RGB || Vector_DotProduct( normal, vCameraRay ) < 0.0f) {
+// Clips the clip space triangle triProjected against the six frustum planes, and scales the resulting triangles
+// into the viewport. The results are added to raster list out.
+void camera::ClipAndScaleTriangle( triangle &triProjected, uint16_t nMaterial, int nShade, rasterList &out ) {
+    float fGuardX, fGuardY;
+    GetGuardBandFactors( fGuardX, fGuardY );
 
-        // Add illumination, to make the 3d objects more intuitive
-        // Single direction lighting - light is shining towards the player
-//        vec3d light_direction = { 0.0f, 0.0f, -1.0f };
-        vec3d light_direction = Vector_Normalise( vLightDir );
+    int nCode[3];
+    for (int i = 0; i < 3; i++)
+        nCode[i] = ClipOutcode( triProjected.p[i].x, triProjected.p[i].y, triProjected.p[i].z, triProjected.p[i].w, fGuardX, fGuardY );
 
-        // determine the alignment between the normal and the light direction
-        float dot_prod = std::max( 0.0f, Vector_DotProduct( light_direction, normal ));
-        // use the alignment to determine the grey shade, and store it in the triangle
-        GetColour2( dot_prod, triTransformed );     // alternatively use GetColour()
+    // trivial reject: all vertices are outside the same plane
+    if (nCode[0] & nCode[1] & nCode[2] & CLIP_MASK_REJECT) {
+        PROFILE_COUNT( PROF_TRIS_CULLED, 1 );
+        return;
+    }
 
-        // Before clipping and projection, first transform from world space to view space
-        Tri_ViewTransform( triTransformed, matView, triViewed );
+    rasterTriangle triFinal;
+    triFinal.nMaterial = nMaterial;
+    triFinal.nShade    = (uint8_t)nShade;
+    int nPlanes = (nCode[0] | nCode[1] | nCode[2]) & CLIP_MASK_CLIP;
+    if (nPlanes == 0) {
+        // trivial accept: no clipping needed
+        for (int i = 0; i < 3; i++) {
+            triFinal.v[i] = (uint32_t)out.vecVerts.size();
+            out.vecVerts.push_back( ScaleIntoCameraView( triProjected.p[i], triProjected.t[i] ));
+        }
+        out.vecTris.push_back( triFinal );
+    } else {
+        [[maybe_unused]] int nClipOut = ClipPolygonAndScale( triProjected.p, triProjected.t, nPlanes, fGuardX, fGuardY, triFinal, 0, out );
+        PROFILE_COUNT( PROF_TRIS_CLIPPED, 1 );
+        PROFILE_COUNT( PROF_TRIS_CLIP_OUT, nClipOut );
+    }
+}
 
-        // ====================/  Clipping against near plane  /====================
+// Clips the triangle with clip space vertices pClip and texture coordinates pTex against the planes in nPlanes, and adds
+// the resulting triangle fan to out. Only the planes that at least one of the vertices is outside of need to be
+// considered: vertices created by clipping lie on an edge of the triangle, so they are inside all other planes as well.
+int camera::ClipPolygonAndScale( const vec3d *pClip, const vec2d *pTex, int nPlanes, float fGuardX, float fGuardY,
+                                 const rasterTriangle &triTemplate, uint32_t nIndexBase, rasterList &out ) {
+
+    // Two fixed size polygon buffers are used alternately as input and output for each plane (ping-pong),
+    // so no memory is allocated here.
+    clipVertex bufferA[CLIP_MAX_VERTICES], bufferB[CLIP_MAX_VERTICES];
+    clipVertex *pIn  = bufferA;
+    clipVertex *pOut = bufferB;
+    for (int i = 0; i < 3; i++) {
+        pIn[i].p = pClip[i];
+        pIn[i].t = pTex[i];
+    }
+    int nIn = 3;
+
+    // the near plane goes first, so that w > 0 holds for all vertices that are left over for the divide by w
+    static const int nPlaneOrder[6] = { CLIP_NEAR, CLIP_FAR, CLIP_GUARD_LEFT, CLIP_GUARD_RIGHT, CLIP_GUARD_BOTTOM, CLIP_GUARD_TOP };
+    for (int i = 0; i < 6 && nIn >= 3; i++) {
+        if (nPlanes & nPlaneOrder[i]) {
+            nIn = ClipPolygonAgainstPlane( pIn, nIn, pOut, nPlaneOrder[i], fGuardX, fGuardY );
+            std::swap( pIn, pOut );
+        }
+    }
 
-        // Clip Viewed Triangle against near plane, this could form two additional triangles.
-        // the array is for retrieving the resulting triangles
-        int nClippedTriangles = 0;
-        triangle clipped[2];
+    if (nIn < 3)
+        return 0;
+
+    // The clipped polygon is convex, so it can be split into a triangle fan around its first vertex.
+    // This keeps the winding order of the original triangle. The triangles of the fan share the polygon vertices.
+    uint32_t nBase = nIndexBase + (uint32_t)out.vecVerts.size();
+    for (int i = 0; i < nIn; i++)
+        out.vecVerts.push_back( ScaleIntoCameraView( pIn[i].p, pIn[i].t ));
+    rasterTriangle triFinal = triTemplate;   // the copy propagates the material and shade
+    for (int i = 1; i + 1 < nIn; i++) {
+        triFinal.v[0] = nBase;
+        triFinal.v[1] = nBase + i;
+        triFinal.v[2] = nBase + i + 1;
+        out.vecTris.push_back( triFinal );
+    }
+    return nIn - 2;
+}
 
-        // the first parameter is a point on the near plane, the second is the normal to the near plane
-        nClippedTriangles = Triangle_ClipAgainstPlane({ 0.0f, 0.0f, fNearPlane }, { 0.0f, 0.0f, 1.0f }, triViewed, clipped[0], clipped[1]);
+// The bounding sphere of mesh m in world space - the radius is scaled by the largest scale factor of the world matrix
+static void WorldBoundingSphere( mesh &m, const mat4x4 &worldMatrix, vec3d &vCentre, float &fRadius ) {
+    vCentre = Matrix_MultiplyVector( worldMatrix, m.vSphereCentre );
+    float fScale = 0.0f;
+    for (int r = 0; r < 3; r++) {
+        vec3d vRow = { worldMatrix.m[r][0], worldMatrix.m[r][1], worldMatrix.m[r][2] };
+        fScale = std::max( fScale, Vector_Length( vRow ));
+    }
+    fRadius = m.fSphereRadius * fScale;
+}
 
-        // We may end up with multiple triangles form the clip, store them for clipping against the far plane
-        for (int n = 0; n < nClippedTriangles; n++)
-            tmpVecOfTris.push_back( clipped[n] );
+// Tests the bounding volumes of mesh m against the frustum. The bounding sphere test is the cheapest, and rejects
+// most of the invisible meshes. If it is inconclusive, the eight corners of the bounding box are transformed into clip
+// space, and their outcodes decide.
+int camera::MeshInFrustum( mesh &m, const mat4x4 &worldMatrix ) {
+    vec3d vCentre;
+    float fRadius;
+    WorldBoundingSphere( m, worldMatrix, vCentre, fRadius );
+    if (!SphereInFrustum( vCentre, fRadius ))
+        return FRUSTUM_OUTSIDE;
+    // the bounding box is tested in model space, taken into clip space in one go
+    return BoxInFrustum( m.vBoundsMin, m.vBoundsMax, Matrix_MultiplyMatrix( worldMatrix, matViewProj ));
+}
 
-        // ====================/  Clipping against far plane  /====================
+bool camera::SphereInFrustum( vec3d vCentre, float fRadius ) {
+    for (int i = 0; i < 6; i++)
+        if (Plane_Distance( frustum[i], vCentre ) < -fRadius)
+            return false;
+    return true;
+}
 
-        for (auto tri : tmpVecOfTris) {
-            // Clip Viewed Triangle against far plane, this could form two additional triangles per triangle.
-            nClippedTriangles = 0;
+int camera::BoxInFrustum( const vec3d &vBoxMin, const vec3d &vBoxMax, const mat4x4 &matBoxToClip ) {
+
+    // test the corners of the bounding box in clip space
+    int nCodeAnd = ~0, nCodeOr = 0;
+    for (int i = 0; i < 8; i++) {
+        vec3d vCorner = { (i & 1) ? vBoxMax.x : vBoxMin.x,
+                          (i & 2) ? vBoxMax.y : vBoxMin.y,
+                          (i & 4) ? vBoxMax.z : vBoxMin.z };
+        vec3d p = Matrix_MultiplyVector( matBoxToClip, vCorner );
+        int nCode = ClipOutcode( p.x, p.y, p.z, p.w, 1.0f, 1.0f );
+        nCodeAnd &= nCode;
+        nCodeOr  |= nCode;
+    }
+    if (nCodeAnd & CLIP_MASK_REJECT)
+        return FRUSTUM_OUTSIDE;
+    // Only report inside if the box is within the viewport itself. If it is only within the guard band, the
+    // per vertex outcodes are still needed to reject the triangles that are outside the viewport.
+    if ((nCodeOr & CLIP_MASK_REJECT) == 0)
+        return FRUSTUM_INSIDE;
+    return FRUSTUM_INTERSECT;
+}
 
-            // the first parameter is a point on the far plane, the second is the normal to the far plane
-            nClippedTriangles = Triangle_ClipAgainstPlane({ 0.0f, 0.0f, fFarPlane }, { 0.0f, 0.0f, -1.0f }, tri, clipped[0], clipped[1]);
+// Performs world transform, culling, view transform, projection transform and clipping on all triangles of mesh m.
+// If the mesh is completely outside the frustum nothing is done at all. Otherwise all unique vertices are transformed
+// straight into clip space with one combined matrix, and the triangles are assembled from them (see ProjectMesh()).
+void camera::CullViewAndProjectMesh( mesh &m, const mat4x4 &worldMatrix, rasterList &out, vec3d vLightDir ) {
 
-            // We may end up with multiple triangles form the clip, so project 0, 1 or 2 as required
-            for (int n = 0; n < nClippedTriangles; n++) {
+    PROFILE_SCOPE( "cull/view/project" );
+    PROFILE_COUNT( PROF_TRIS_IN, Mesh_TriangleCount( m ));
 
-                // Project the points of the triangle from 3D -->  2D
-                Tri_ProjectTransform( clipped[n], matProj, triProjected );
+    int nVisibility = MeshInFrustum( m, worldMatrix );
+    if (nVisibility == FRUSTUM_OUTSIDE) {
+        PROFILE_COUNT( PROF_TRIS_CULLED, Mesh_TriangleCount( m ));
+        return;
+    }
 
-                // scale into view - i.e. normalize, invert x and y, and scale to viewport dimensions
-                Tri_ScaleIntoCameraView( triProjected, triFinal );
+    meshBuffers b = Mesh_GetBuffers( m );
+    if (sClipVerts.nCount < b.nVerts)
+        VertexStream_Resize( sClipVerts, b.nVerts );
+    vec3d light_direction = Vector_Normalise( vLightDir );
+    ProjectMesh( b, Matrix_MultiplyMatrix( worldMatrix, matViewProj ), Matrix_MakeNormalMatrix( worldMatrix ), nullptr,
+                 nVisibility == FRUSTUM_INTERSECT, m.nMaterial, light_direction, out );
+}
 
-                // Store the triangles that are going to be drawn for sorting
-                vecOfTris.push_back( triFinal );
-            }
+void camera::CullViewAndProjectInstances( mesh &m, const mat4x4 *pWorldMatrices, int nInstances, rasterList &out,
+                                          const uint16_t *pMaterials, vec3d vLightDir ) {
+
+    PROFILE_SCOPE( "cull/view/project instances" );
+    meshBuffers b = Mesh_GetBuffers( m );
+    PROFILE_COUNT( PROF_TRIS_IN, (long long)b.nTris * nInstances );
+
+    // Everything that doesn't depend on the world matrix is done once for all instances. This includes the face
+    // normals, which are computed in model space here, and taken into world space per instance by its normal matrix.
+    if (sClipVerts.nCount < b.nVerts)
+        VertexStream_Resize( sClipVerts, b.nVerts );
+    vecFaceNormals.resize( b.nTris );
+    for (int i = 0; i < b.nTris; i++) {
+        const uint32_t *pIndex = &b.indices[3 * i];
+        uint32_t i0 = pIndex[0], i1 = pIndex[1], i2 = pIndex[2];
+        vec3d m0 = { b.x[i0], b.y[i0], b.z[i0] }, m1 = { b.x[i1], b.y[i1], b.z[i1] }, m2 = { b.x[i2], b.y[i2], b.z[i2] };
+        vec3d line1 = Vector_Sub( m1, m0 );
+        vec3d line2 = Vector_Sub( m2, m0 );
+        vecFaceNormals[i]   = Vector_CrossProduct( line1, line2 );
+        vecFaceNormals[i].w = 0.0f;
+    }
+    vec3d light_direction = Vector_Normalise( vLightDir );
+
+    for (int i = 0; i < nInstances; i++) {
+        const mat4x4 &worldMatrix = pWorldMatrices[i];
+
+        // Cull the instance as a whole (see MeshInFrustum()). World, view and projection are concatenated only once,
+        // into the matrix that takes both the bounding box and the vertices from model space into clip space.
+        vec3d vCentre;
+        float fRadius;
+        WorldBoundingSphere( m, worldMatrix, vCentre, fRadius );
+        if (!SphereInFrustum( vCentre, fRadius )) {
+            PROFILE_COUNT( PROF_TRIS_CULLED, b.nTris );
+            continue;
+        }
+        mat4x4 matMVP = Matrix_MultiplyMatrix( worldMatrix, matViewProj );
+        int nVisibility = BoxInFrustum( m.vBoundsMin, m.vBoundsMax, matMVP );
+        if (nVisibility == FRUSTUM_OUTSIDE) {
+            PROFILE_COUNT( PROF_TRIS_CULLED, b.nTris );
+            continue;
         }
+
+        // The clip space vertices of an instance are only needed until its triangles are in the raster list, so all
+        // instances use the same (small) buffer, which stays in the cache.
+        ProjectMesh( b, matMVP, Matrix_MakeNormalMatrix( worldMatrix ), vecFaceNormals.data(), nVisibility == FRUSTUM_INTERSECT,
+                     (pMaterials != nullptr) ? pMaterials[i] : m.nMaterial, light_direction, out );
     }
 }
 
-// Performs the rasterizing of all the triangles in the vector trisToRaster
-void camera::RasterizeTriangles( std::vector<triangle> &trisToRaster, std::vector<triangle> &trisToRender ) {
-
-//    if (glbRenderMode == RM_GREYFILLED || glbRenderMode == RM_GREYFILLED_PLUS || glbRenderMode == RM_WIREFRAME || glbRenderMode == RM_WIREFRAME_RGB) {
-        // Sort triangles from back to front - using a function from the algorithm standard lib
-        // standard function sort() requires starting point, ending point, and sorting criterium
-        // This implements the painting algorithm for drawing.
-        sort( trisToRaster.begin(), trisToRaster.end(),
-             // this lambda provides the sorting criterium
-             [](triangle &t1, triangle &t2) {
-                 // determine z-value of midpoints for both triangles
-                 float z1 = (t1.p[0].z + t1.p[1].z + t1.p[2].z) / 3.0f;
-                 float z2 = (t2.p[0].z + t2.p[1].z + t2.p[2].z) / 3.0f;
-                 // return if they are in the right ordering already (the sorting criterium)
-                 return z1 > z2;
-             });
-//    }
-
-    std::list<triangle> listTriangles;    // this is the queue from the slides / notes (a std::list)
-
-    for (auto &rasterTri : trisToRaster) {
-        // Clip triangles against all four screen edges, this could yield a bunch of triangles, so create a queue
-        // that we traverse to ensure we only test new triangles generated against planes
-        triangle clipped[2];
-
-        // Add initial triangle
-        listTriangles.clear();
-        listTriangles.push_back(rasterTri);
-        int nNewTriangles = 1;
-
-        // look at the pseudo code in the notes for explanation
-        for (int p = 0; p < 4; p++) {   // iterate 4 planes
-            int nTrisToAdd = 0;
-            while (nNewTriangles > 0) {
-                // Take triangle from front of queue
-                triangle test = listTriangles.front();
-                listTriangles.pop_front();
-                nNewTriangles--;
-
-                // Clip it against a plane. We only need to test each subsequent plane, against subsequent new triangles
-                // as all triangles after a plane clip are guaranteed to lie on the inside of the plane.
-                vec3d clipPIP, clipNormal;   // point in plane to clip, normal vector on plane to clip
-                switch (p) {
-                    case 0:	clipPIP = { 0.0f, (float)nViewPortY1 + 0.1f, 0.0f }; clipNormal = {  0.0f,  1.0f, 0.0f }; break;  // top        of viewport, normal pointing downwards
-                    case 1:	clipPIP = { 0.0f, (float)nViewPortY2 - 1.0f, 0.0f }; clipNormal = {  0.0f, -1.0f, 0.0f }; break;  // bottom     of viewport, normal pointing upwards
-                    case 2:	clipPIP = { (float)nViewPortX1 + 0.1f, 0.0f, 0.0f }; clipNormal = {  1.0f,  0.0f, 0.0f }; break;  // left side  of viewport, normal pointing right
-                    case 3:	clipPIP = { (float)nViewPortX2 - 1.0f, 0.0f, 0.0f }; clipNormal = { -1.0f,  0.0f, 0.0f }; break;  // right side of viewport, normal pointing left
+void camera::CullViewAndProjectWorldMesh( const worldMesh &wm, rasterList &out ) {
+
+    PROFILE_SCOPE( "cull/view/project" );
+    PROFILE_COUNT( PROF_TRIS_IN, wm.source.nTris );
+
+    // the bounds are in world space already, so the box only needs the view and projection transform
+    int nVisibility = SphereInFrustum( wm.vSphereCentre, wm.fSphereRadius ) ? BoxInFrustum( wm.vBoundsMin, wm.vBoundsMax, matViewProj )
+                                                                            : FRUSTUM_OUTSIDE;
+    if (nVisibility == FRUSTUM_OUTSIDE) {
+        PROFILE_COUNT( PROF_TRIS_CULLED, wm.source.nTris );
+        return;
+    }
+
+    meshBuffers b = wm.source;
+    b.x = wm.verts.x.data();
+    b.y = wm.verts.y.data();
+    b.z = wm.verts.z.data();
+    b.w = wm.verts.w.data();
+    if (sClipVerts.nCount < b.nVerts)
+        VertexStream_Resize( sClipVerts, b.nVerts );
+    vec3d vUnused;
+    ProjectMesh( b, matViewProj, Matrix_MakeIdentity(), nullptr, nVisibility == FRUSTUM_INTERSECT, wm.nMaterial, vUnused, out,
+                 wm.vecLight.data());
+}
+
+void camera::ProjectMesh( meshBuffers &b, const mat4x4 &matMVP, const mat4x4 &matNormal, const vec3d *pFaceNormals,
+                          bool bNeedsClipping, uint16_t nMaterial, vec3d &light_direction, rasterList &out, const float *pLight ) {
+
+    assembleParams p;
+    p.pBuffers   = &b;
+    p.xClip      = sClipVerts.x.data();
+    p.yClip      = sClipVerts.y.data();
+    p.zClip      = sClipVerts.z.data();
+    p.wClip      = sClipVerts.w.data();
+    p.pNormals   = pFaceNormals;
+    p.matNormal  = matNormal;
+    p.vLight     = light_direction;
+    p.pLight     = pLight;
+    p.nMaterial  = nMaterial;
+    p.bTextured  = (Material_Get( nMaterial ).pTexture != nullptr);
+    p.bNoCulling = (glbRenderMode == RM_WIREFRAME || glbRenderMode == RM_WIREFRAME_RGB);
+    GetGuardBandFactors( p.fGuardX, p.fGuardY );
+    if (bNeedsClipping)
+        vecOutcodes.resize( b.nVerts );
+    p.pOutcodes = bNeedsClipping ? vecOutcodes.data() : nullptr;
+
+    assembleStats stats;
+    if (pPool != nullptr && pPool->ThreadCount() > 1 && b.nTris >= CAMERA_PARALLEL_MIN_TRIS)
+        ProjectMeshParallel( p, matMVP, out, stats );
+    else {
+        // model space -> clip space in one transform, the mesh data is read in place
+        float *xClip = sClipVerts.x.data(), *yClip = sClipVerts.y.data();
+        float *zClip = sClipVerts.z.data(), *wClip = sClipVerts.w.data();
+        {
+            PROFILE_SCOPE( "transform" );
+            Matrix_MultiplyVectorStream( matMVP, b.x, b.y, b.z, b.w, xClip, yClip, zClip, wClip, b.nVerts );
+        }
+
+        // determine the outcodes of all unique vertices
+        if (bNeedsClipping)
+            for (int i = 0; i < b.nVerts; i++)
+                vecOutcodes[i] = ClipOutcode( xClip[i], yClip[i], zClip[i], wClip[i], p.fGuardX, p.fGuardY );
+
+        // Untextured triangles share their screen space vertices: a vertex is scaled into the viewport when the first
+        // visible triangle uses it, and vecVertexMap maps it to its index in the raster list.
+        if (!p.bTextured)
+            vecVertexMap.assign( b.nVerts, UINT32_MAX );
+        AssembleTriangles( p, 0, b.nTris, vecVertexMap.data(), 0, out, stats );
+    }
+
+    PROFILE_COUNT( PROF_TRIS_CULLED,   stats.nCulled  );
+    PROFILE_COUNT( PROF_TRIS_CLIPPED,  stats.nClipped );
+    PROFILE_COUNT( PROF_TRIS_CLIP_OUT, stats.nClipOut );
+}
+
+void camera::AssembleTriangles( const assembleParams &p, int nFirst, int nLast, uint32_t *pVertexMap, uint32_t nIndexBase,
+                                rasterList &out, assembleStats &stats ) {
+
+    const meshBuffers &b = *p.pBuffers;
+    const float *xClip = p.xClip, *yClip = p.yClip, *zClip = p.zClip, *wClip = p.wClip;
+    vec3d light_direction = p.vLight;
+    vec2d texNone;
+
+    for (int i = nFirst; i < nLast; i++) {
+        const uint32_t *pIndex = &b.indices[3 * i];
+        uint32_t i0 = pIndex[0], i1 = pIndex[1], i2 = pIndex[2];
+
+        // trivial reject: all vertices are outside the same frustum plane
+        int nCode0 = 0, nCode1 = 0, nCode2 = 0;
+        if (p.pOutcodes != nullptr) {
+            nCode0 = p.pOutcodes[i0];
+            nCode1 = p.pOutcodes[i1];
+            nCode2 = p.pOutcodes[i2];
+            if (nCode0 & nCode1 & nCode2 & CLIP_MASK_REJECT) {
+                stats.nCulled++;
+                continue;
+            }
+        }
+
+        if (!p.bNoCulling && ClipSpaceBackface( xClip[i0], yClip[i0], wClip[i0], xClip[i1], yClip[i1], wClip[i1],
+                                                xClip[i2], yClip[i2], wClip[i2] )) {
+            stats.nCulled++;
+            continue;
+        }
+
+        // Lighting with the model space face normal, taken into world space by the normal matrix - unless the lighting
+        // is given
+        float dot_prod;
+        if (p.pLight != nullptr)
+            dot_prod = p.pLight[i];
+        else {
+            vec3d normal;
+            if (p.pNormals != nullptr)
+                normal = p.pNormals[i];
+            else {
+                vec3d m0 = { b.x[i0], b.y[i0], b.z[i0] }, m1 = { b.x[i1], b.y[i1], b.z[i1] }, m2 = { b.x[i2], b.y[i2], b.z[i2] };
+                vec3d line1 = Vector_Sub( m1, m0 );
+                vec3d line2 = Vector_Sub( m2, m0 );
+                normal   = Vector_CrossProduct( line1, line2 );
+                normal.w = 0.0f;
+            }
+            normal = Matrix_MultiplyVector( p.matNormal, normal );
+            normal = Vector_Normalise( normal );
+            dot_prod = std::max( 0.0f, Vector_DotProduct( light_direction, normal ));
+        }
+
+        // the triangle is visible - it only carries its material and shade, the rest is looked up at raster time
+        rasterTriangle triFinal;
+        triFinal.nMaterial = p.nMaterial;
+        triFinal.nShade    = (uint8_t)GetColour2( dot_prod );
+
+        int nPlanes = (nCode0 | nCode1 | nCode2) & CLIP_MASK_CLIP;
+        if (nPlanes == 0) {
+            // trivial accept: no clipping needed. Textured triangles get their own three vertices, since the texture
+            // coordinates are per triangle corner.
+            for (int j = 0; j < 3; j++) {
+                uint32_t v = pIndex[j];
+                if (p.bTextured) {
+                    triFinal.v[j] = nIndexBase + (uint32_t)out.vecVerts.size();
+                    out.vecVerts.push_back( ScaleIntoCameraView( { xClip[v], yClip[v], zClip[v], wClip[v] }, b.texs[3 * i + j] ));
+                } else if (pVertexMap == nullptr) {
+                    triFinal.v[j] = v;
+                } else {
+                    if (pVertexMap[v] == UINT32_MAX) {
+                        pVertexMap[v] = nIndexBase + (uint32_t)out.vecVerts.size();
+                        out.vecVerts.push_back( ScaleIntoCameraView( { xClip[v], yClip[v], zClip[v], wClip[v] }, texNone ));
+                    }
+                    triFinal.v[j] = pVertexMap[v];
                 }
-                nTrisToAdd = Triangle_ClipAgainstPlane( clipPIP, clipNormal, test, clipped[0], clipped[1]);
+            }
+            out.vecTris.push_back( triFinal );
+        } else {
+            // assemble the triangle in clip space for the clipper
+            vec3d pClip[3];
+            vec2d pTex[3];
+            for (int j = 0; j < 3; j++) {
+                uint32_t v = pIndex[j];
+                pClip[j] = { xClip[v], yClip[v], zClip[v], wClip[v] };
+                pTex[j]  = p.bTextured ? b.texs[3 * i + j] : texNone;
+            }
+            stats.nClipped++;
+            stats.nClipOut += ClipPolygonAndScale( pClip, pTex, nPlanes, p.fGuardX, p.fGuardY, triFinal, nIndexBase, out );
+        }
+    }
+}
 
-                // Clipping may yield a variable number of triangles, so add these new ones to the back of the queue
-                // for subsequent clipping against next planes
-                for (int w = 0; w < nTrisToAdd; w++)
-                    listTriangles.push_back(clipped[w]);
+// The work is done in three rounds of tasks, with the bookkeeping in between on the calling thread:
+//   1. per chunk of vertices: transform into clip space, determine the outcodes, and - for untextured meshes - scale
+//      the vertices into the viewport, straight into their place in out. Scaling all vertices up front (instead of on
+//      first use, like ProjectMesh() does) costs some work for invisible ones, but lets the triangle chunks refer to
+//      the shared vertices without any coordination.
+//   2. per chunk of triangles: AssembleTriangles() into the raster list of the chunk. The new vertices of a chunk
+//      (those of clipped and textured triangles) get provisional indices from nShared on.
+//   3. per chunk of triangles: copy its triangles and vertices to their place in out, which follows from the prefix
+//      sums of the chunk sizes, and correct the provisional vertex indices.
+// Each task writes to its own part of the memory only, so no locks are needed.
+void camera::ProjectMeshParallel( const assembleParams &p, const mat4x4 &matMVP, rasterList &out, assembleStats &stats ) {
+
+    const meshBuffers &b = *p.pBuffers;
+    uint32_t nBase   = (uint32_t)out.vecVerts.size();
+    uint32_t nShared = p.bTextured ? 0 : (uint32_t)b.nVerts;
+    int nVertChunks  = (b.nVerts + CAMERA_CHUNK_SIZE - 1) / CAMERA_CHUNK_SIZE;
+    int nTriChunks   = (b.nTris  + CAMERA_CHUNK_SIZE - 1) / CAMERA_CHUNK_SIZE;
+
+    if ((int)vecChunkOut.size() < nTriChunks) {
+        vecChunkOut.resize( nTriChunks );
+        vecChunkStats.resize( nTriChunks );
+        vecChunkVertStart.resize( nTriChunks );
+        vecChunkTriStart.resize( nTriChunks );
+    }
+    out.vecVerts.resize( nBase + nShared );
+
+    // the lambdas only capture two pointers, which std::function can store without allocating on the heap
+    struct {
+        const assembleParams *pParams;
+        const mat4x4 *pMVP;
+        float *xClip, *yClip, *zClip, *wClip;
+        rasterList *pOut;
+        uint32_t nBase, nShared, nTriBase;
+    } job = { &p, &matMVP, sClipVerts.x.data(), sClipVerts.y.data(), sClipVerts.z.data(), sClipVerts.w.data(),
+              &out, nBase, nShared, 0 };
+
+    {
+        PROFILE_SCOPE( "transform" );
+        pPool->ParallelFor( nVertChunks, [this, &job]( int c ) {
+            const meshBuffers &b = *job.pParams->pBuffers;
+            int nStart = c * CAMERA_CHUNK_SIZE;
+            int nCount = std::min( CAMERA_CHUNK_SIZE, b.nVerts - nStart );
+            Matrix_MultiplyVectorStream( *job.pMVP, b.x + nStart, b.y + nStart, b.z + nStart,
+                                         (b.w != nullptr) ? b.w + nStart : nullptr,
+                                         job.xClip + nStart, job.yClip + nStart, job.zClip + nStart, job.wClip + nStart, nCount );
+            for (int i = nStart; i < nStart + nCount; i++) {
+                if (job.pParams->pOutcodes != nullptr)
+                    vecOutcodes[i] = ClipOutcode( job.xClip[i], job.yClip[i], job.zClip[i], job.wClip[i],
+                                                  job.pParams->fGuardX, job.pParams->fGuardY );
+                if (job.nShared > 0)
+                    job.pOut->vecVerts[job.nBase + i] = ScaleIntoCameraView( { job.xClip[i], job.yClip[i], job.zClip[i], job.wClip[i] }, vec2d() );
             }
-            nNewTriangles = listTriangles.size();
+        } );
+    }
+
+    pPool->ParallelFor( nTriChunks, [this, &job]( int c ) {
+        int nFirst = c * CAMERA_CHUNK_SIZE;
+        int nLast  = std::min( nFirst + CAMERA_CHUNK_SIZE, job.pParams->pBuffers->nTris );
+        RasterList_Clear( vecChunkOut[c] );
+        vecChunkStats[c] = assembleStats();
+        AssembleTriangles( *job.pParams, nFirst, nLast, nullptr, job.nShared, vecChunkOut[c], vecChunkStats[c] );
+    } );
+
+    // prefix sums of the chunk sizes
+    uint32_t nVerts = 0, nTris = 0;
+    for (int c = 0; c < nTriChunks; c++) {
+        vecChunkVertStart[c] = nVerts;
+        vecChunkTriStart[c]  = nTris;
+        nVerts += (uint32_t)vecChunkOut[c].vecVerts.size();
+        nTris  += (uint32_t)vecChunkOut[c].vecTris.size();
+        stats.nCulled  += vecChunkStats[c].nCulled;
+        stats.nClipped += vecChunkStats[c].nClipped;
+        stats.nClipOut += vecChunkStats[c].nClipOut;
+    }
+    job.nTriBase = (uint32_t)out.vecTris.size();
+    out.vecVerts.resize( nBase + nShared + nVerts );
+    out.vecTris.resize( job.nTriBase + nTris );
+
+    pPool->ParallelFor( nTriChunks, [this, &job]( int c ) {
+        const rasterList &chunk = vecChunkOut[c];
+        std::copy( chunk.vecVerts.begin(), chunk.vecVerts.end(),
+                   job.pOut->vecVerts.begin() + job.nBase + job.nShared + vecChunkVertStart[c] );
+        // shared vertex v is at nBase + v, and the new vertex with provisional index nShared + k at
+        // nBase + nShared + (vertex start of the chunk) + k
+        rasterTriangle *pDst = job.pOut->vecTris.data() + job.nTriBase + vecChunkTriStart[c];
+        for (const rasterTriangle &t : chunk.vecTris) {
+            rasterTriangle tri = t;
+            for (int j = 0; j < 3; j++)
+                tri.v[j] = job.nBase + tri.v[j] + ((tri.v[j] < job.nShared) ? 0 : vecChunkVertStart[c]);
+            *pDst++ = tri;
         }
-        // store all processed triangles in a separate vector for rendering later on.
-        for (auto &t : listTriangles)
-            trisToRender.push_back( t );
+    } );
+}
+
+// Prepares all the triangles in raster list l for drawing
+void camera::RasterizeTriangles( rasterList &l ) {
+    PROFILE_SCOPE( "sort" );
+
+    // With depth testing the draw order doesn't matter, so the sort is only needed for the painters algorithm
+    if (!DepthTestActive()) {
+        // Sort triangles from back to front. The sort key of a triangle is computed once: the sum of the z values of its
+        // vertices (three times the z of its midpoint) as an order preserving integer, flipped so that the farthest
+        // triangle comes first, in the upper 32 bits, and the index of the triangle in the lower 32 bits. The keys are
+        // created in index order, so the radix sort only needs the upper 32 bits, and triangles at the same depth keep
+        // their order. Then the (16 byte) triangles are moved to their place, the vertices stay where they are.
+        const std::vector<rasterVertex> &v = l.vecVerts;
+        uint32_t nTris = (uint32_t)l.vecTris.size();
+        vecSortKeys.resize( nTris );
+        for (uint32_t i = 0; i < nTris; i++) {
+            const rasterTriangle &t = l.vecTris[i];
+            uint32_t nDepth = ~RadixSort_FloatKey( v[t.v[0]].z + v[t.v[1]].z + v[t.v[2]].z );
+            vecSortKeys[i] = ((uint64_t)nDepth << 32) | i;
+        }
+        RadixSort( vecSortKeys, vecSortTemp, 4, pPool );
+
+        vecSortTris.resize( nTris );
+        for (uint32_t i = 0; i < nTris; i++)
+            vecSortTris[i] = l.vecTris[(uint32_t)vecSortKeys[i]];
+        std::copy( vecSortTris.begin(), vecSortTris.end(), l.vecTris.begin());
     }
 }
 
@@ -398,13 +1147,10 @@ int camera::VaryShadeReversed( float a, float a_min, float a_max, int b_min, int
 // This function is a variant of GetColour(). It uses less black and white shades and thus makes
 // the shades more distinguishable. I noticed that so many black or near black shades were rendered
 // that I often felt like the regular GetColour() wasn't working at all :)
-void camera::GetColour2( float lum, triangle &tri ) {
+int camera::GetColour2( float lum ) {
 
 // This part is for the pixelGameEngine
-    int grey_rgb = VaryShade( lum, 0.0f, 1.0f, minRGBvalue, maxRGBvalue );
-    tri.r = grey_rgb;
-    tri.g = grey_rgb;
-    tri.b = grey_rgb;
+    return VaryShade( lum, 0.0f, 1.0f, minRGBvalue, maxRGBvalue );
 }
 
 // Clipping function, returns the number of triangles that are created by it.
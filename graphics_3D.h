@@ -2,22 +2,32 @@
 #define GRAPHICS_3D_H
 
 #include  <iostream>
+#include    <string>
 #include    <vector>
-#include      <list>
 #include <algorithm>
-
-#include "olcPixelGameEngine.h"
-
-#include   "vec3d.h"
-#include  "mat4x4.h"
+#include   <cstdint>
+#include    <memory>
+
+#include         "vec3d.h"
+#include        "mat4x4.h"
+#include "render_target.h"
+#include       "texture.h"
+#include   "thread_pool.h"
+#include    "radix_sort.h"
+
+// The graphics code doesn't depend on the olcPixelGameEngine - it draws through the renderTarget interface. Only
+// the sprite pointer for textured triangles is kept, so a forward declaration suffices.
+namespace olc {
+    class Sprite;
+}
 
 // ============================================================
 
 /* Render modes defined here.
  *
  * Note that depending on the rendering type the painters algorithm and/or a depth buffer is
- * applied. The painters algorithm is used in all grey filled and wire frame modes,
- * the depth buffer is used for all textured modes.
+ * applied. The wire frame modes always use the painters algorithm. The grey filled and textured
+ * modes use the depth buffer if glbDepthTest is set, and the painters algorithm otherwise.
  */
 #define RM_UNKNOWN         -1
 #define RM_INVISIBLE        0    // Useful to keep wireframe object alive, but not to render (for instance bounding boxes)
@@ -28,14 +38,47 @@
 #define RM_TEXTURED         5    // Textured      without wire frame drawing
 #define RM_TEXTURED_PLUS    6    //               with     "     "      "
 
+// Clipping is done in homogeneous clip space (after projection, before the divide by w) against all six frustum
+// planes in one pass. Each plane can add at most one vertex to the polygon, so a clipped triangle has at most 3 + 6
+// vertices, and results in at most 7 triangles.
+#define CLIP_MAX_VERTICES    9
+
+// Meshes with at least CAMERA_PARALLEL_MIN_TRIS triangles are projected in parallel if the camera has a thread pool (see
+// camera::pPool). Their vertices and triangles are then split into tasks of CAMERA_CHUNK_SIZE each.
+#define CAMERA_PARALLEL_MIN_TRIS   16384
+#define CAMERA_CHUNK_SIZE           4096
+
+// Outcode bits - a bit is set if a vertex is on the outside of the corresponding plane. The first six are the
+// frustum planes, the guard band bits are for the left/right/top/bottom planes moved outwards by the guard band.
+#define CLIP_LEFT            0x001
+#define CLIP_RIGHT           0x002
+#define CLIP_BOTTOM          0x004
+#define CLIP_TOP             0x008
+#define CLIP_NEAR            0x010
+#define CLIP_FAR             0x020
+#define CLIP_GUARD_LEFT      0x040
+#define CLIP_GUARD_RIGHT     0x080
+#define CLIP_GUARD_BOTTOM    0x100
+#define CLIP_GUARD_TOP       0x200
+// a triangle is rejected if all its vertices are outside one of these planes...
+#define CLIP_MASK_REJECT     (CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR | CLIP_FAR)
+// ... and it needs clipping if any of its vertices is outside one of these
+#define CLIP_MASK_CLIP       (CLIP_GUARD_LEFT | CLIP_GUARD_RIGHT | CLIP_GUARD_BOTTOM | CLIP_GUARD_TOP | CLIP_NEAR | CLIP_FAR)
+
 // colour for wireframe drawing
 #define RM_FRAMECOL_CGE     FG_WHITE    // consoleGameEngine
 #define RM_FRAMECOL_PGE     olc::WHITE  // pixelGameEngine
+#define RM_FRAMECOL         COL_WHITE   // renderTarget
 
 // ============================================================
 
 extern short glbRenderMode;  // default initialized to RM_GREYFILLED_PLUS
-extern float *pDepthBuffer;
+extern bool  glbDepthTest;   // default initialized to true - use the depth buffer for the filled render modes
+extern int   glbTextureFilter;   // default initialized to TEXTURE_FILTER_BILINEAR - filtering for the textured modes
+extern float *pDepthBuffer;  // holds 1/w per pixel - larger values are closer to the camera, 0.0f is infinitely far
+
+// returns true if the current render mode draws using the depth buffer (i.e. without the painters algorithm)
+bool DepthTestActive();
 
 struct renderColour {
     // pixelGameEngine: rgb values for the colour
@@ -49,13 +92,170 @@ struct triangle {
     vec2d t[3];    // ... if textured also three texture coordinates
 
     // pixelGameEngine: rgb values for the colour
-    int r, g, b; // could also be short: values between 0 and 255 (including)
+    int r = 0, g = 0, b = 0; // could also be short: values between 0 and 255 (including)
 
-    int renderMode;
+    int renderMode = RM_UNKNOWN;
+
+    olc::Sprite *ptrSprite = nullptr;
+};
+
+// ==============================/   Materials    /==============================
+
+// The appearance of a mesh. The pipeline doesn't carry the appearance info along with the geometry: a triangle only
+// holds the id of its material, which is looked up in the material table when the triangle is rasterized.
+struct material {
+    uint32_t       nColour    = COL_WHITE;   // in the layout of Colour_Pack(), multiplied by the shade of the lighting
+    int            renderMode = RM_UNKNOWN;
+    const texture *pTexture   = nullptr;     // if set, the triangles are textured (and the texture coordinates are kept)
+};
+
+// Material 0 is always there: white, without texture. It is used for everything that doesn't specify a material.
+#define MATERIAL_DEFAULT   0
+#define MATERIAL_MAX       0xFFFF
+
+// Adds mat to the material table and returns its id. If the table is full (MATERIAL_MAX materials), MATERIAL_DEFAULT
+// is returned. Don't add materials while a frame is being rendered, since that may move the table in memory.
+uint16_t Material_Add( const material &mat );
+// Returns the material with id nMaterial
+const material &Material_Get( uint16_t nMaterial );
+// Returns the number of materials in the table (including the default material)
+int Material_Count();
+
+// ==============================/   Raster lists    /==============================
+
+// A vertex in screen space, as it is passed to the rasterizer: the screen coordinates, z / w (for the painters
+// algorithm), 1/w (for the depth buffer and perspective correct interpolation) and the texture coordinates divided
+// by w. The texture coordinates are only filled in for textured materials.
+struct rasterVertex {
+    float x, y, z;
+    float iw;
+    float u, v;
+};
+
+// A triangle in screen space: three indices into the vertices of its raster list, the material and the grey shade
+// (between minRGBvalue and maxRGBvalue of the camera) that the lighting gave it. Triangles of the same mesh share
+// their vertices.
+struct rasterTriangle {
+    uint32_t v[3];
+    uint16_t nMaterial;
+    uint8_t  nShade;
+    uint8_t  nPad = 0;
+};
+
+// The output of the CullViewAndProject...() functions, and the input of the rasterizer. Both vectors keep their
+// capacity when the list is cleared, so the list can be reused every frame without allocating.
+struct rasterList {
+    std::vector<rasterVertex>   vecVerts;
+    std::vector<rasterTriangle> vecTris;
+};
 
-    olc::Sprite *ptrSprite;
+inline void RasterList_Clear( rasterList &l ) {
+    l.vecVerts.clear();
+    l.vecTris.clear();
+}
+
+// Returns the colour of raster triangle t: the colour of its material, shaded
+inline uint32_t RasterTriangle_Colour( const rasterTriangle &t ) {
+    uint32_t nColour = Material_Get( t.nMaterial ).nColour;
+    return Colour_Pack( Colour_R( nColour ) * t.nShade / 255, Colour_G( nColour ) * t.nShade / 255, Colour_B( nColour ) * t.nShade / 255 );
+}
+
+// Read only access to the data of a mesh, wherever it is stored (see Mesh_GetBuffers())
+struct meshBuffers {
+    const float    *x = nullptr, *y = nullptr, *z = nullptr;
+    const float    *w = nullptr;          // nullptr means that w = 1.0f for all vertices
+    const uint32_t *indices = nullptr;    // three per triangle
+    const vec2d    *texs    = nullptr;    // three per triangle
+    int nVerts = 0, nTris = 0;
 };
 
+// A mesh is stored in indexed form: a vertex buffer holding each unique vertex once (in structure of arrays layout,
+// see vertexStream) and an index buffer holding three 32-bit vertex indices per triangle. This way vertices that
+// are shared by several triangles are transformed only once.
+// The texture coordinates are stored per triangle corner (so three per triangle), since faces that share a vertex
+// generally use different texture coordinates for it.
+// Instead of holding its data in verts, indices and texs, a mesh can also be a read only view on memory that is owned
+// by something else, like a memory mapped cache file (see mesh_cache.h). The pipeline reads the data through
+// Mesh_GetBuffers(), so it handles both cases.
+struct mesh {
+    vertexStream          verts;      // the unique vertices of the mesh
+    std::vector<uint32_t> indices;    // three indices into verts per triangle, in clockwise order
+    std::vector<vec2d>    texs;       // three texture coordinates per triangle
+
+    // appearance info, used for all triangles of the mesh (see Material_Add())
+    uint16_t nMaterial = MATERIAL_DEFAULT;
+
+    // Incremented by Mesh_ComputeBounds(), so by every change of the vertices that is done properly. Renderers that cache
+    // their results (see demoScene::RenderFrame()) compare it to see whether the mesh changed. Increment it yourself
+    // after other changes, like a new material.
+    uint32_t nVersion = 0;
+
+    // bounding volumes in model space, see Mesh_ComputeBounds()
+    vec3d vBoundsMin, vBoundsMax;    // axis aligned bounding box
+    vec3d vSphereCentre;             // bounding sphere
+    float fSphereRadius = 0.0f;
+
+    // only used if the mesh is a view: the data, and the object that keeps it alive
+    meshBuffers           viewBuffers;
+    std::shared_ptr<void> pViewOwner;
+};
+
+// A plane in the form a * x + b * y + c * z + d = 0, with (a, b, c) stored in n. Points with a positive
+// distance (see Plane_Distance()) are on the inside of the plane.
+struct plane {
+    vec3d n;
+    float d = 0.0f;
+};
+
+// returns the signed distance of point p to plane pl (which must be normalised for the result to be a true distance)
+inline float Plane_Distance( plane &pl, vec3d &p ) {
+    return pl.n.x * p.x + pl.n.y * p.y + pl.n.z * p.z + pl.d;
+}
+
+// results of frustum tests: the object is completely outside, partly inside or completely inside the frustum
+#define FRUSTUM_OUTSIDE    0
+#define FRUSTUM_INTERSECT  1
+#define FRUSTUM_INSIDE     2
+
+// Builds indexed mesh m from the triangles in vecTris. Vertices with identical coordinates are merged
+// into one vertex. The render mode of the first triangle makes up the material of the mesh (the colour of the material
+// is white, the colours of the triangles are only set by the lighting, and the sprite of a triangle can't be sampled -
+// give the mesh a material with a texture for that). The bounds are computed as well.
+void Mesh_FromTriangles( std::vector<triangle> &vecTris, mesh &m );
+// (Re)computes the bounding box and bounding sphere of mesh m from its vertices, and increments its version. Call this
+// whenever the vertices change.
+void Mesh_ComputeBounds( mesh &m );
+// Returns the number of triangles in mesh m
+int Mesh_TriangleCount( mesh &m );
+// Returns pointers to the vertices, indices and texture coordinates of mesh m - either into its own vectors, or
+// into the memory it is a view on
+meshBuffers Mesh_GetBuffers( mesh &m );
+// Turns mesh m back into a mesh that holds its own data (leaving it empty), if it was a view
+void Mesh_ClearView( mesh &m );
+// Assembles and returns triangle i of mesh m (including texture coordinates and appearance info)
+triangle Mesh_GetTriangle( mesh &m, int i );
+
+// The camera independent part of the pipeline for one mesh (see WorldMesh_Update()): its vertices in world space, the
+// lighting of its triangles and its bounds in world space. When a scene is seen by several cameras, this is done once
+// per frame, and each camera only does its own view and projection transform, culling and clipping on it (see
+// camera::CullViewAndProjectWorldMesh() and multi_view.h).
+struct worldMesh {
+    vertexStream       verts;       // the vertices of the mesh in world space
+    std::vector<float> vecLight;    // per triangle the amount of light it gets (0 - 1), see GetColour2()
+    meshBuffers        source;      // the data of the mesh, for the indices and texture coordinates
+    uint16_t           nMaterial = MATERIAL_DEFAULT;
+
+    // bounding volumes in world space
+    vec3d vBoundsMin, vBoundsMax;
+    vec3d vSphereCentre;
+    float fSphereRadius = 0.0f;
+};
+
+// Transforms mesh m with worldMatrix into world mesh wm, and lights its triangles from direction vLightDir. The data of
+// m is referenced, not copied, so m must stay unchanged while wm is used. The buffers of wm keep their capacity, so
+// calling this every frame doesn't allocate once they are large enough.
+void WorldMesh_Update( worldMesh &wm, mesh &m, const mat4x4 &worldMatrix, vec3d vLightDir = { 1.0f, 1.0f, 1.0f } );
+
 // initialize a depthbuffer with the screen size as passed in the parameters.
 void InitDepthBuffer( int nScreenW, int nScreenH );
 // this is a clear screen, but then scoped to the size as specified
@@ -82,14 +282,33 @@ public:
     float fCameraRoll;
 
     float fNearPlane, fFarPlane;
+    float fFieldOfView;   // in degrees
 
     int   nViewPortX1, nViewPortX2, nViewPortWidth;    // define the view port for this camera
     int   nViewPortY1, nViewPortY2, nViewPortHeight;
 
+    // Guard band (in pixels) around the viewport. Triangles that lie within the viewport extended by the guard band are
+    // not clipped against the left/right/top/bottom planes. Only use this if the triangles are drawn with a
+    // rasterizer that clips to the viewport itself (like tileRasterizer). Default is 0 (no guard band).
+    int   nGuardBand = 0;
+
+    // Thread pool that large meshes are projected with (see CullViewAndProjectMesh()). If it is nullptr (the default),
+    // all work is done on the calling thread.
+    threadPool *pPool = nullptr;
+
     mat4x4 matView;   // view matrix for this camera - calculated using point-at & look-at matrix
     mat4x4 matProj;   // projection matrix for the view port with this camera
+    mat4x4 matViewProj;   // matView * matProj - updated together with the frustum planes
+
+    // The frustum planes in world space (left, right, bottom, top, near, far), normalised and pointing inwards.
+    // They are extracted from matViewProj whenever the view or projection matrix changes.
+    plane frustum[6];
 
-    olc::PixelGameEngine *gfxEngine = nullptr;
+    // Incremented whenever the view or projection matrix changes, so that renderers that cache their results can see
+    // whether the camera changed
+    uint32_t nVersion = 0;
+
+    renderTarget *gfxTarget = nullptr;   // the target to draw the viewport into
 
     // In the GetColour a minimum and maximum RGB-value is used. Theoretically these values are in [0, 255].
     // To get a better visibility, you can set other minimum and maximum RGB values for the
@@ -100,10 +319,10 @@ public:
     // Initializes the camera using the parameters. Calculates camera's projection matrix as well.
     // The rotation angles fCameraPitch, fCameraYaw and fCameraRoll are set to 0.0f.
     // the points (x1, y1) and (x2, y2) are top left resp. bottom righ corner of the viewport (in screen coordinates)
-    void InitCamera( olc::PixelGameEngine *engine, std::string name, int x1, int y1, int x2, int y2,
+    void InitCamera( renderTarget *target, std::string name, int x1, int y1, int x2, int y2,
                          float fieldOfViewInDegrees = 90.0f, float nearPlaneDistance = 0.1f, float farPlaneDistance = 1000.0f );
 
-    // update the camera's projection matrix with the parameters provided
+    // update the camera's projection matrix with the parameters provided - nothing is done if they didn't change
     void UpdateCamera( float fieldOfViewInDegrees, float nearPlaneDistance, float farPlaneDistance );
 
     // Kind of clear screen for the viewport associated with the camera
@@ -113,11 +332,17 @@ public:
     // the coordinate system of the camera and its view matrix
     void RecalculateCamera();
 
+    // Tests mesh m, transformed with worldMatrix, against the frustum of this camera. Returns FRUSTUM_OUTSIDE if the
+    // mesh can't be visible, FRUSTUM_INSIDE if it is completely within the frustum (so none of its triangles need
+    // clipping), and FRUSTUM_INTERSECT otherwise. The bounding sphere is tested first, and if that's inconclusive,
+    // the corners of the bounding box are tested.
+    int MeshInFrustum( mesh &m, const mat4x4 &worldMatrix );
+
 protected:
     // Performs a transform from triIn to triOut, using transformation matrix trfMatrix.
     // The col and sym values of the triangle are propagated.
     // Note: This method is declared static since it called by static method Tri_WorldTransform()
-    static void Tri_Transform( triangle &triIn, mat4x4 trfMatrix, triangle &triOut );
+    static void Tri_Transform( triangle &triIn, mat4x4 &trfMatrix, triangle &triOut );
 
 public:
     // Performs "world transformation" (the transform from model to world space) on the input triangle triIn,
@@ -125,6 +350,10 @@ public:
     // Note 1: Each model in the world potentially needs its own worldMatrix.
     // Note 2: This method is declared static since it is not depending on any specific camera
     static void Tri_WorldTransform( triangle &triIn, mat4x4 &worldMatrix, triangle &triOut );
+    // Batch version of the above: all triangles of vecIn are transformed in one go using worldMatrix, and the
+    // transformed triangles are put in vecOut (which is resized to match vecIn).
+    // The vertices are gathered into a vertex stream, so that they can be transformed by one call to the SoA kernel.
+    static void Tri_WorldTransform( std::vector<triangle> &vecIn, mat4x4 &worldMatrix, std::vector<triangle> &vecOut );
 
 protected:
     // Performs view transformation (from world to view space) on the input triangle triIn, using viewMatrix.
@@ -139,14 +368,49 @@ protected:
 public:
     // Scales the coordinates of TriIn into the camera's viewport. The scaled triangle is passed in triOut
     void Tri_ScaleIntoCameraView( triangle &triIn, triangle &triOut );
-
-    // Performs culling, view transform and projection transform on the triangle inputTri. Because of clipping
-    // against the near plane, the result can be 0, 1 or 2 triangles, that are added to vecOfTris
-    void CullViewAndProjectTriangle( triangle &inputTri, std::vector<triangle> &vecOfTris, vec3d vLightDir = { 1.0f, 1.0f, 1.0f } );
-
-    // Performs the rasterizing and drawing of all the triangles in the vector trisToRaster,
-    // and leaves the result in trisToRender
-    void RasterizeTriangles( std::vector<triangle> &trisToRaster, std::vector<triangle> &trisToRender );
+    // Same for a single vertex: returns clip space point p with texture coordinate t as a screen space raster vertex
+    rasterVertex ScaleIntoCameraView( const vec3d &p, const vec2d &t );
+
+    // Clips triangle triProjected (in clip space, i.e. projected but not yet divided by w) against the six frustum
+    // planes, and scales the resulting triangles into the viewport. The results (0 up to 7 triangles, with material
+    // nMaterial and shade nShade) are added to rasterList out. Triangles that are completely inside (see nGuardBand)
+    // are passed without clipping.
+    void ClipAndScaleTriangle( triangle &triProjected, uint16_t nMaterial, int nShade, rasterList &out );
+
+    // Performs culling, view transform, projection transform and clipping on the triangle inputTri.
+    // The resulting triangles (with material nMaterial) are added to out
+    void CullViewAndProjectTriangle( triangle &inputTri, rasterList &out, uint16_t nMaterial = MATERIAL_DEFAULT,
+                                     vec3d vLightDir = { 1.0f, 1.0f, 1.0f } );
+
+    // Performs world transform, culling, view transform, projection transform and clipping on all triangles of mesh m.
+    // The world, view and projection matrices are concatenated, so each unique vertex of the mesh is transformed into
+    // clip space only once, with a single matrix. The triangles are assembled from the index buffer for culling (in clip
+    // space) and clipping, and lit with the normal matrix (see Matrix_MakeNormalMatrix()), so no world or view space
+    // copies of the vertices are needed. The resulting triangles are added to out, where they share the screen space
+    // vertices of the mesh. Meshes that are outside the frustum (see MeshInFrustum()) are rejected before any vertex
+    // is touched.
+    void CullViewAndProjectMesh( mesh &m, const mat4x4 &worldMatrix, rasterList &out, vec3d vLightDir = { 1.0f, 1.0f, 1.0f } );
+
+    // Instanced version of the above: renders nInstances copies of mesh m, copy i with world matrix pWorldMatrices[i].
+    // If pMaterials is not nullptr, copy i gets material pMaterials[i] instead of the material of the mesh. The work that
+    // doesn't depend on the world matrix (like the face normals) is done once per call. Every copy is tested against
+    // the frustum as a whole (see MeshInFrustum()). For the visible ones, world, view and projection are concatenated
+    // into one matrix, that takes both the bounding box and the vertices from model space straight into clip space.
+    // Backface culling is done in clip space and lighting uses the normal matrix (see Matrix_MakeNormalMatrix()), so no
+    // world or view space vertices are needed.
+    void CullViewAndProjectInstances( mesh &m, const mat4x4 *pWorldMatrices, int nInstances, rasterList &out,
+                                      const uint16_t *pMaterials = nullptr, vec3d vLightDir = { 1.0f, 1.0f, 1.0f } );
+
+    // Same as CullViewAndProjectMesh(), for a mesh that has already been transformed into world space and lit by
+    // WorldMesh_Update(). The world mesh is only read, so several cameras can project the same world mesh at the same
+    // time, from different threads.
+    void CullViewAndProjectWorldMesh( const worldMesh &wm, rasterList &out );
+
+    // Prepares the triangles in raster list l for drawing: they are sorted back to front (painters algorithm), unless
+    // the depth buffer is used (see DepthTestActive()), in which case the draw order doesn't matter. The sort is a radix
+    // sort (see radix_sort.h), which uses pPool for large lists.
+    // Note: the triangles are already clipped against the viewport edges in the CullViewAndProject...() functions.
+    void RasterizeTriangles( rasterList &l );
 
 private:
     // GetColour stuff:
@@ -156,9 +420,81 @@ private:
     // The following two functions use this feature.
     short minRGBvalue, maxRGBvalue;
 
+    // Vertex buffer for CullViewAndProjectMesh() and CullViewAndProjectInstances(): the clip space vertices of the mesh,
+    // resp. of one instance at a time. Kept in the camera to prevent reallocation every frame.
+    vertexStream          sClipVerts;
+    std::vector<int>      vecOutcodes;
+    std::vector<vec3d>    vecFaceNormals;    // the model space face normals of the instanced mesh
+    std::vector<uint32_t> vecVertexMap;      // per mesh vertex its index in the raster list (see ProjectMesh())
+
+    // Transforms mesh data b into clip space with matMVP (world, view and projection combined), into sClipVerts, and
+    // assembles, culls, lights, clips and scales its triangles. The results get material nMaterial, and are added to
+    // out. matNormal takes the face normals into world space. If pFaceNormals is not nullptr it holds them in model
+    // space, otherwise they are computed here. light_direction must be normalised.
+    // If pLight isn't nullptr, it holds the lighting per triangle (see worldMesh), and the normals and light_direction
+    // are not used.
+    void ProjectMesh( meshBuffers &b, const mat4x4 &matMVP, const mat4x4 &matNormal, const vec3d *pFaceNormals,
+                      bool bNeedsClipping, uint16_t nMaterial, vec3d &light_direction, rasterList &out,
+                      const float *pLight = nullptr );
+
+    // everything AssembleTriangles() needs to know about the mesh that is being projected
+    struct assembleParams {
+        const meshBuffers *pBuffers;
+        const float *xClip, *yClip, *zClip, *wClip;    // the clip space vertices
+        const int   *pOutcodes;                        // their outcodes, nullptr if the mesh needs no clipping
+        const vec3d *pNormals;                         // model space face normals, nullptr to compute them
+        mat4x4   matNormal;
+        vec3d    vLight;                               // normalised
+        const float *pLight;                           // the lighting per triangle, nullptr if it is computed here
+        uint16_t nMaterial;
+        bool     bTextured, bNoCulling;
+        float    fGuardX, fGuardY;
+    };
+    // What happened to the assembled triangles. This is collected per call rather than counted directly, so that the
+    // (atomic) profiler counters are updated once per mesh instead of once per triangle.
+    struct assembleStats {
+        long long nCulled = 0, nClipped = 0, nClipOut = 0;
+    };
+    // Assembles, culls, lights, clips and scales triangles nFirst up to nLast (exclusive) of the mesh in p, and adds
+    // them to out. The vertex indices of the triangles are the positions in out plus nIndexBase. Vertices of untextured
+    // triangles that need no clipping are shared: if pVertexMap isn't nullptr they are added to out on first use and
+    // pVertexMap maps mesh vertices to their index, otherwise they are expected to be scaled already, and mesh vertex v
+    // gets index v. Doesn't change the camera, so it can be called from several threads at once.
+    void AssembleTriangles( const assembleParams &p, int nFirst, int nLast, uint32_t *pVertexMap, uint32_t nIndexBase,
+                            rasterList &out, assembleStats &stats );
+    // The parallel version of ProjectMesh(), for large meshes. The vertices and the triangles are each split into
+    // chunks of CAMERA_CHUNK_SIZE, which are processed by the tasks of pPool. The triangles of each chunk go into a
+    // raster list of their own, and these are appended to out in chunk order, so the result doesn't depend on which
+    // thread did what.
+    void ProjectMeshParallel( const assembleParams &p, const mat4x4 &matMVP, rasterList &out, assembleStats &stats );
+    std::vector<rasterList>    vecChunkOut;      // per triangle chunk, kept to prevent reallocation every frame
+    std::vector<assembleStats> vecChunkStats;
+    std::vector<uint32_t>      vecChunkVertStart, vecChunkTriStart;
+
+    // buffers for the painters algorithm sort (see RasterizeTriangles())
+    std::vector<uint64_t>       vecSortKeys, vecSortTemp;
+    std::vector<rasterTriangle> vecSortTris;
+
+    // recalculates matViewProj and the frustum planes - called whenever matView or matProj changes
+    void UpdateFrustum();
+
+    // The two halves of the frustum test of MeshInFrustum(): the test of the bounding sphere in world space (false if
+    // it is outside), and the test of the corners of the bounding box (vBoxMin, vBoxMax), which are taken into clip
+    // space by matBoxToClip
+    bool SphereInFrustum( vec3d vCentre, float fRadius );
+    int  BoxInFrustum( const vec3d &vBoxMin, const vec3d &vBoxMax, const mat4x4 &matBoxToClip );
+
+    // returns the factors by which the x and y clipping planes are moved outwards by the guard band
+    void GetGuardBandFactors( float &fGuardX, float &fGuardY );
+    // Clips triProjected against the planes in nPlanes (a combination of outcode bits), and scales the resulting
+    // triangles into the viewport. The results (which get the material and shade of triTemplate) are added to out, with
+    // vertex indices that are the positions in out plus nIndexBase. Returns the number of resulting triangles.
+    int ClipPolygonAndScale( const vec3d *pClip, const vec2d *pTex, int nPlanes, float fGuardX, float fGuardY,
+                             const rasterTriangle &triTemplate, uint32_t nIndexBase, rasterList &out );
+
     // copies all colour info from triIn to triOut
     // Note: This method is declared static since it called by static method Tri_WorldTransform()
-    static void Tri_PropagateColourInfo( triangle triIn, triangle &triOut );
+    static void Tri_PropagateColourInfo( const triangle &triIn, triangle &triOut );
 
     // This function translates a variable a with value in a range between a_min and a_max into
     // a corresponding (i.e. proportional) value in the range b_min to b_max.
@@ -172,13 +508,16 @@ private:
     // This function is a variant of GetColour(). It uses less black and white shades and thus makes
     // the shades more distinguishable. I noticed that so many black or near black shades were rendered
     // that I often felt like the regular GetColour() wasn't working at all :)
-    void GetColour2( float lum, triangle &tri );
+    // Returns the grey shade for luminance lum - the colour of the material is applied at raster time.
+    int GetColour2( float lum );
 
+public:
     // Clipping function, returns the number of triangles that are created by it.
     // inputs:   plane_p, plane_n --> the plane equation parameters (a point in the plane and the normal vector to the plane)
     //           in_tri           --> the triangle to be clipped
     // outputs:  out_tri1 and out_tri2 (either neither, or the first, or both triangles will be useful)
-    int Triangle_ClipAgainstPlane(vec3d plane_p, vec3d plane_n, triangle &in_tri, triangle &out_tri1, triangle &out_tri2);
+    // Note: This method is declared static since it doesn't depend on any specific camera
+    static int Triangle_ClipAgainstPlane(vec3d plane_p, vec3d plane_n, triangle &in_tri, triangle &out_tri1, triangle &out_tri2);
 };
 
 // This function is a variant of the clipping algorithm. It calculates the intersection line segment between a triangle
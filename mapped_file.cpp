@@ -0,0 +1,99 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include    <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include   <unistd.h>
+#endif
+
+mappedFile::~mappedFile() {
+    Close();
+}
+
+#ifdef _WIN32
+
+bool mappedFile::Open( const std::string &sFileName ) {
+    Close();
+    HANDLE hFileWin = CreateFileA( sFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if (hFileWin == INVALID_HANDLE_VALUE)
+        return false;
+    hFile = hFileWin;
+
+    LARGE_INTEGER nFileSize;
+    if (!GetFileSizeEx( hFileWin, &nFileSize )) {
+        Close();
+        return false;
+    }
+    if (nFileSize.QuadPart == 0)
+        return true;
+
+    hMapping = CreateFileMappingA( hFileWin, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    if (hMapping == nullptr) {
+        Close();
+        return false;
+    }
+    pData = (const char *)MapViewOfFile( (HANDLE)hMapping, FILE_MAP_READ, 0, 0, 0 );
+    if (pData == nullptr) {
+        Close();
+        return false;
+    }
+    nSize = (size_t)nFileSize.QuadPart;
+    return true;
+}
+
+void mappedFile::Close() {
+    if (pData    != nullptr) UnmapViewOfFile( pData );
+    if (hMapping != nullptr) CloseHandle( (HANDLE)hMapping );
+    if (hFile    != nullptr) CloseHandle( (HANDLE)hFile );
+    pData    = nullptr;
+    nSize    = 0;
+    hMapping = nullptr;
+    hFile    = nullptr;
+}
+
+#else
+
+bool mappedFile::Open( const std::string &sFileName ) {
+    Close();
+    int nFile = open( sFileName.c_str(), O_RDONLY );
+    if (nFile < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat( nFile, &fileStat ) != 0) {
+        close( nFile );
+        return false;
+    }
+    if (fileStat.st_size == 0) {
+        close( nFile );
+        return true;
+    }
+
+    void *pMap = mmap( nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, nFile, 0 );
+    // the mapping stays valid after closing the file descriptor
+    close( nFile );
+    if (pMap == MAP_FAILED)
+        return false;
+#ifdef MADV_WILLNEED
+    // the file is going to be read completely, so let the kernel read ahead
+    madvise( pMap, (size_t)fileStat.st_size, MADV_WILLNEED );
+#endif
+    pData = (const char *)pMap;
+    nSize = (size_t)fileStat.st_size;
+    return true;
+}
+
+void mappedFile::Close() {
+    if (pData != nullptr)
+        munmap( (void *)pData, nSize );
+    pData = nullptr;
+    nSize = 0;
+}
+
+#endif // _WIN32
@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include  <string>
+
+// A file that is memory mapped read only. The contents can be accessed directly through Data(), without copying the
+// file into a buffer first - the operating system loads the pages on demand. Uses mmap() on POSIX systems and a file
+// mapping object on Windows.
+class mappedFile {
+public:
+    mappedFile() = default;
+    ~mappedFile();
+
+    mappedFile( const mappedFile & ) = delete;
+    mappedFile &operator = ( const mappedFile & ) = delete;
+
+    // Maps the complete file sFileName. Returns false if the file can't be opened or mapped. An empty file is mapped
+    // successfully, with Data() == nullptr and Size() == 0.
+    bool Open( const std::string &sFileName );
+    // unmaps the file (also done by the destructor)
+    void Close();
+
+    const char *Data() const { return pData; }
+    size_t      Size() const { return nSize; }
+
+private:
+    const char *pData = nullptr;
+    size_t      nSize = 0;
+#ifdef _WIN32
+    void *hFile    = nullptr;    // the Windows handles, stored as void * to keep windows.h out of this header
+    void *hMapping = nullptr;
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -1,20 +1,91 @@
 #include "mat4x4.h"
 #include <cmath>
 
+#if MAT4X4_SSE2
+    #include <emmintrin.h>
+#endif
+
 // ===== matrix utility functions - implementation ----- //
 
 // Returns the matrix multiplication result of vector i and matrix m.
 // The vector is considered a row vector, so the i-th element of the vector is
 // calculated using column i of the matrix.
-vec3d Matrix_MultiplyVector( mat4x4 &m, vec3d &i ) {
+vec3d Matrix_MultiplyVector( const mat4x4 &m, const vec3d &i ) {
     vec3d v;
+#if MAT4X4_SSE2
+    // the result is a linear combination of the matrix rows: x * row0 + y * row1 + z * row2 + w * row3
+    __m128 r =         _mm_mul_ps( _mm_set1_ps( i.x ), _mm_load_ps( m.m[0] ));
+    r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( i.y ), _mm_load_ps( m.m[1] )));
+    r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( i.z ), _mm_load_ps( m.m[2] )));
+    r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( i.w ), _mm_load_ps( m.m[3] )));
+    _mm_store_ps( &v.x, r );
+#else
     v.x = i.x * m.m[0][0] + i.y * m.m[1][0] + i.z * m.m[2][0] + i.w * m.m[3][0];
     v.y = i.x * m.m[0][1] + i.y * m.m[1][1] + i.z * m.m[2][1] + i.w * m.m[3][1];
     v.z = i.x * m.m[0][2] + i.y * m.m[1][2] + i.z * m.m[2][2] + i.w * m.m[3][2];
     v.w = i.x * m.m[0][3] + i.y * m.m[1][3] + i.z * m.m[2][3] + i.w * m.m[3][3];
+#endif
     return v;
 }
 
+// Batch version of Matrix_MultiplyVector() for vertices in structure of arrays layout. The matrix elements
+// are copied into locals first, so that the compiler doesn't have to reload them for every vertex, and the
+// __restrict qualifiers tell it that the arrays don't overlap. This lets the loop auto-vectorize.
+void Matrix_MultiplyVectorStream( const mat4x4 &m,
+                                  const float *__restrict xIn, const float *__restrict yIn, const float *__restrict zIn, const float *__restrict wIn,
+                                  float *__restrict xOut, float *__restrict yOut, float *__restrict zOut, float *__restrict wOut, int nCount ) {
+    const float m00 = m.m[0][0], m01 = m.m[0][1], m02 = m.m[0][2], m03 = m.m[0][3];
+    const float m10 = m.m[1][0], m11 = m.m[1][1], m12 = m.m[1][2], m13 = m.m[1][3];
+    const float m20 = m.m[2][0], m21 = m.m[2][1], m22 = m.m[2][2], m23 = m.m[2][3];
+    const float m30 = m.m[3][0], m31 = m.m[3][1], m32 = m.m[3][2], m33 = m.m[3][3];
+
+    int i = 0;
+#if MAT4X4_SSE2
+    // explicit SSE2 version: 4 vertices per iteration, with each matrix element broadcast over a register
+    const __m128 v00 = _mm_set1_ps( m00 ), v01 = _mm_set1_ps( m01 ), v02 = _mm_set1_ps( m02 ), v03 = _mm_set1_ps( m03 );
+    const __m128 v10 = _mm_set1_ps( m10 ), v11 = _mm_set1_ps( m11 ), v12 = _mm_set1_ps( m12 ), v13 = _mm_set1_ps( m13 );
+    const __m128 v20 = _mm_set1_ps( m20 ), v21 = _mm_set1_ps( m21 ), v22 = _mm_set1_ps( m22 ), v23 = _mm_set1_ps( m23 );
+    const __m128 v30 = _mm_set1_ps( m30 ), v31 = _mm_set1_ps( m31 ), v32 = _mm_set1_ps( m32 ), v33 = _mm_set1_ps( m33 );
+    const __m128 vOne = _mm_set1_ps( 1.0f );
+
+    for ( ; i + 4 <= nCount; i += 4) {
+        __m128 x = _mm_loadu_ps( xIn + i ), y = _mm_loadu_ps( yIn + i ), z = _mm_loadu_ps( zIn + i );
+        __m128 w = (wIn != nullptr) ? _mm_loadu_ps( wIn + i ) : vOne;
+        _mm_storeu_ps( xOut + i, _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, v00 ), _mm_mul_ps( y, v10 )), _mm_mul_ps( z, v20 )), _mm_mul_ps( w, v30 )));
+        _mm_storeu_ps( yOut + i, _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, v01 ), _mm_mul_ps( y, v11 )), _mm_mul_ps( z, v21 )), _mm_mul_ps( w, v31 )));
+        _mm_storeu_ps( zOut + i, _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, v02 ), _mm_mul_ps( y, v12 )), _mm_mul_ps( z, v22 )), _mm_mul_ps( w, v32 )));
+        _mm_storeu_ps( wOut + i, _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, v03 ), _mm_mul_ps( y, v13 )), _mm_mul_ps( z, v23 )), _mm_mul_ps( w, v33 )));
+    }
+#endif
+    // scalar loop - handles the remaining vertices (or all of them if SIMD is not available)
+    for ( ; i < nCount; i++) {
+        float x = xIn[i], y = yIn[i], z = zIn[i], w = (wIn != nullptr) ? wIn[i] : 1.0f;
+        xOut[i] = x * m00 + y * m10 + z * m20 + w * m30;
+        yOut[i] = x * m01 + y * m11 + z * m21 + w * m31;
+        zOut[i] = x * m02 + y * m12 + z * m22 + w * m32;
+        wOut[i] = x * m03 + y * m13 + z * m23 + w * m33;
+    }
+}
+
+// Transforms all vertices of vertex stream sIn using matrix m, and puts the result in sOut.
+void Matrix_MultiplyVertexStream( const mat4x4 &m, vertexStream &sIn, vertexStream &sOut ) {
+    if (sOut.nCount != sIn.nCount)
+        VertexStream_Resize( sOut, sIn.nCount );
+    Matrix_MultiplyVectorStream( m, sIn.x.data(),  sIn.y.data(),  sIn.z.data(),  sIn.w.data(),
+                                   sOut.x.data(), sOut.y.data(), sOut.z.data(), sOut.w.data(), sIn.nCount );
+}
+
+// Calculates both the sine and cosine of fAngleRad. GCC provides a fused sincos that is about as
+// expensive as one of both functions. Other compilers usually combine the two calls themselves.
+void Matrix_SinCos( float fAngleRad, float &fSin, float &fCos ) {
+#if defined( __GNUC__ ) && !defined( __clang__ )
+    __builtin_sincosf( fAngleRad, &fSin, &fCos );
+#else
+    fSin = sinf( fAngleRad );
+    fCos = cosf( fAngleRad );
+#endif
+}
+
 // Builds a matrix using the 16 parameters. Both rows and columns count from 0 to 3.
 // Returns the resulting matrix.
 mat4x4 Matrix_Buildup( float r0c0, float r0c1, float r0c2, float r0c3,
@@ -47,12 +118,14 @@ mat4x4 Matrix_MakeIdentity() {
 // Returns the matrix for rotation around the X-axis with angle theta.
 // IMPORTANT NOTE: this transformation matrix is only to be used with points represented as row-vectors!
 mat4x4 Matrix_MakeRotationX( float fAngleRad ) {
+    float fSin, fCos;
+    Matrix_SinCos( fAngleRad, fSin, fCos );
     mat4x4 matrix;
     matrix.m[0][0] = 1.0f;
-    matrix.m[1][1] =  cosf( fAngleRad );
-    matrix.m[1][2] =  sinf( fAngleRad );
-    matrix.m[2][1] = -sinf( fAngleRad );
-    matrix.m[2][2] =  cosf( fAngleRad );
+    matrix.m[1][1] =  fCos;
+    matrix.m[1][2] =  fSin;
+    matrix.m[2][1] = -fSin;
+    matrix.m[2][2] =  fCos;
     matrix.m[3][3] = 1.0f;
     return matrix;
 }
@@ -60,12 +133,14 @@ mat4x4 Matrix_MakeRotationX( float fAngleRad ) {
 // Returns the matrix for rotation around the Y-axis with angle theta.
 // IMPORTANT NOTE: this transformation matrix is to be used with points represented as row-vectors!
 mat4x4 Matrix_MakeRotationY( float fAngleRad ) {
+    float fSin, fCos;
+    Matrix_SinCos( fAngleRad, fSin, fCos );
     mat4x4 matrix;
-    matrix.m[0][0] =  cosf( fAngleRad );
-    matrix.m[0][2] =  sinf( fAngleRad );
-    matrix.m[2][0] = -sinf( fAngleRad );
+    matrix.m[0][0] =  fCos;
+    matrix.m[0][2] =  fSin;
+    matrix.m[2][0] = -fSin;
     matrix.m[1][1] = 1.0f;
-    matrix.m[2][2] =  cosf( fAngleRad );
+    matrix.m[2][2] =  fCos;
     matrix.m[3][3] = 1.0f;
     return matrix;
 }
@@ -73,11 +148,13 @@ mat4x4 Matrix_MakeRotationY( float fAngleRad ) {
 // Returns the matrix for rotation around the Z-axis with angle theta.
 // IMPORTANT NOTE: this transformation matrix is only to be used with points represented as row-vectors!
 mat4x4 Matrix_MakeRotationZ( float fAngleRad ) {
+    float fSin, fCos;
+    Matrix_SinCos( fAngleRad, fSin, fCos );
     mat4x4 matrix;
-    matrix.m[0][0] =  cosf( fAngleRad );
-    matrix.m[0][1] =  sinf( fAngleRad );
-    matrix.m[1][0] = -sinf( fAngleRad );
-    matrix.m[1][1] =  cosf( fAngleRad );
+    matrix.m[0][0] =  fCos;
+    matrix.m[0][1] =  fSin;
+    matrix.m[1][0] = -fSin;
+    matrix.m[1][1] =  fCos;
     matrix.m[2][2] = 1.0f;
     matrix.m[3][3] = 1.0f;
     return matrix;
@@ -132,37 +209,101 @@ mat4x4 Matrix_MakeProjection( float fFovDegrees, float fAspectRatio, float fNear
 
 // Returns the result of matrix multiplication of m1 and m2.
 // the new value at (r, c) is constructed using the row vector r of m1 and the column vector c of m2
-mat4x4 Matrix_MultiplyMatrix( mat4x4 &m1, mat4x4 &m2 ) {
+mat4x4 Matrix_MultiplyMatrix( const mat4x4 &m1, const mat4x4 &m2 ) {
     mat4x4 matrix;
+#if MAT4X4_SSE2
+    // row r of the result is the linear combination of the rows of m2, weighted by the elements of row r of m1
+    __m128 row0 = _mm_load_ps( m2.m[0] ), row1 = _mm_load_ps( m2.m[1] ), row2 = _mm_load_ps( m2.m[2] ), row3 = _mm_load_ps( m2.m[3] );
+    for (int r = 0; r < 4; r++) {
+        __m128 res =           _mm_mul_ps( _mm_set1_ps( m1.m[r][0] ), row0 );
+        res = _mm_add_ps( res, _mm_mul_ps( _mm_set1_ps( m1.m[r][1] ), row1 ));
+        res = _mm_add_ps( res, _mm_mul_ps( _mm_set1_ps( m1.m[r][2] ), row2 ));
+        res = _mm_add_ps( res, _mm_mul_ps( _mm_set1_ps( m1.m[r][3] ), row3 ));
+        _mm_store_ps( matrix.m[r], res );
+    }
+#else
     for (int c = 0; c < 4; c++)
         for (int r = 0; r < 4; r++)
             matrix.m[r][c] = m1.m[r][0] * m2.m[0][c] +
                              m1.m[r][1] * m2.m[1][c] +
                              m1.m[r][2] * m2.m[2][c] +
                              m1.m[r][3] * m2.m[3][c];
+#endif
+    return matrix;
+}
+
+// Returns the transpose of matrix m (rows become columns and vice versa).
+mat4x4 Matrix_Transpose( const mat4x4 &m ) {
+    mat4x4 matrix;
+#if MAT4X4_SSE2
+    __m128 row0 = _mm_load_ps( m.m[0] ), row1 = _mm_load_ps( m.m[1] ), row2 = _mm_load_ps( m.m[2] ), row3 = _mm_load_ps( m.m[3] );
+    _MM_TRANSPOSE4_PS( row0, row1, row2, row3 );
+    _mm_store_ps( matrix.m[0], row0 );
+    _mm_store_ps( matrix.m[1], row1 );
+    _mm_store_ps( matrix.m[2], row2 );
+    _mm_store_ps( matrix.m[3], row3 );
+#else
+    for (int r = 0; r < 4; r++)
+        for (int c = 0; c < 4; c++)
+            matrix.m[r][c] = m.m[c][r];
+#endif
+    return matrix;
+}
+
+mat4x4 Matrix_MakeNormalMatrix( const mat4x4 &m ) {
+    // row i of the result is the cross product of the other two rows of m (in cyclic order)
+    mat4x4 matrix;
+    for (int i = 0; i < 3; i++) {
+        const float *a = m.m[(i + 1) % 3], *b = m.m[(i + 2) % 3];
+        matrix.m[i][0] = a[1] * b[2] - a[2] * b[1];
+        matrix.m[i][1] = a[2] * b[0] - a[0] * b[2];
+        matrix.m[i][2] = a[0] * b[1] - a[1] * b[0];
+    }
+    matrix.m[3][3] = 1.0f;
     return matrix;
 }
 
 // Creates and returns a transformation matrix using the scale factors, the rotation angles and
 // translation distances in the parameter list.
+//
+// The matrix equals rotY * scale * rotZ * rotX * translate. Instead of building these five matrices and doing
+// four full matrix multiplications, the product is written out in closed form. Each sine and cosine is
+// calculated only once. Because of the row vector convention, the translation simply ends up in row 3.
 mat4x4 Matrix_MakeTransformComplete( float xScale, float yScale, float zScale,
                                      float xAngle, float yAngle, float zAngle,
                                      float xTrnsl, float yTrnsl, float zTrnsl ) {
-        // Set up rotation matrices, then translation matrix, and then build transform matrix
-        // by multiplying all matrices in the right order
-        mat4x4 matScale = Matrix_MakeScaling( xScale, yScale, zScale );
-        mat4x4 matRotX  = Matrix_MakeRotationX( xAngle );
-        mat4x4 matRotY  = Matrix_MakeRotationY( yAngle );
-        mat4x4 matRotZ  = Matrix_MakeRotationZ( zAngle );
-        mat4x4 matTrans = Matrix_MakeTranslation( xTrnsl, yTrnsl, zTrnsl );
+    float sx, cx, sy, cy, sz, cz;
+    Matrix_SinCos( xAngle, sx, cx );
+    Matrix_SinCos( yAngle, sy, cy );
+    Matrix_SinCos( zAngle, sz, cz );
+
+    // rows of rotY * scale * rotZ (only the upper 3x3 part is non trivial)
+    float a00 =  cy * xScale * cz, a01 =  cy * xScale * sz, a02 = sy * zScale;
+    float a10 = -yScale * sz,      a11 =  yScale * cz;   // a12 = 0
+    float a20 = -sy * xScale * cz, a21 = -sy * xScale * sz, a22 = cy * zScale;
 
-        mat4x4 matrix;
-        matrix   = Matrix_MultiplyMatrix( matRotY, matScale );
-        matrix   = Matrix_MultiplyMatrix( matrix,  matRotZ  );
-        matrix   = Matrix_MultiplyMatrix( matrix,  matRotX  );
-        matrix   = Matrix_MultiplyMatrix( matrix,  matTrans );
+    // multiply by rotX: column 0 is unchanged, columns 1 and 2 are rotated
+    mat4x4 matrix;
+    matrix.m[0][0] = a00; matrix.m[0][1] = a01 * cx - a02 * sx; matrix.m[0][2] = a01 * sx + a02 * cx;
+    matrix.m[1][0] = a10; matrix.m[1][1] = a11 * cx;            matrix.m[1][2] = a11 * sx;
+    matrix.m[2][0] = a20; matrix.m[2][1] = a21 * cx - a22 * sx; matrix.m[2][2] = a21 * sx + a22 * cx;
+
+    // and finally the translation
+    matrix.m[3][0] = xTrnsl; matrix.m[3][1] = yTrnsl; matrix.m[3][2] = zTrnsl; matrix.m[3][3] = 1.0f;
+
+    return matrix;
+}
+
+mat4x4 Matrix_MakeTransformComplete( const transformSRT &srt ) {
+    return Matrix_MakeTransformComplete( srt.xScale, srt.yScale, srt.zScale,
+                                         srt.xAngle, srt.yAngle, srt.zAngle,
+                                         srt.xTrnsl, srt.yTrnsl, srt.zTrnsl );
+}
 
-        return matrix;
+// Creates nCount transformation matrices into pMatrices, from the parameter sets in pParams.
+void Matrix_MakeTransformCompleteBatch( const transformSRT *pParams, mat4x4 *pMatrices, int nCount ) {
+    for (int i = 0; i < nCount; i++)
+        pMatrices[i] = Matrix_MakeTransformComplete( pParams[i] );
 }
 
 // Intuitively the point-at matrix is used to make translations from the world coordinate system to the camera coordinate system.
@@ -193,8 +334,22 @@ mat4x4 Matrix_PointAt( vec3d &pos, vec3d &target, vec3d &up ) {
 }
 
 // Matrix_QuickInverse() creates the "LookAt" - matrix. This is the matrix that translates the world coordinates into camera (view) coordinates.
-mat4x4 Matrix_QuickInverse(mat4x4 &m) { // Only for Rotation/Translation Matrices
+mat4x4 Matrix_QuickInverse( const mat4x4 &m ) { // Only for Rotation/Translation Matrices
     mat4x4 matrix;
+#if MAT4X4_SSE2
+    // transpose the 3x3 rotation part (the 4th row is zero, so the 4th column of the result becomes zero)
+    __m128 row0 = _mm_load_ps( m.m[0] ), row1 = _mm_load_ps( m.m[1] ), row2 = _mm_load_ps( m.m[2] ), row3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS( row0, row1, row2, row3 );
+    _mm_store_ps( matrix.m[0], row0 );
+    _mm_store_ps( matrix.m[1], row1 );
+    _mm_store_ps( matrix.m[2], row2 );
+    // the translation row is minus the original translation, multiplied by the transposed rotation part
+    __m128 t =         _mm_mul_ps( _mm_set1_ps( m.m[3][0] ), row0 );
+    t = _mm_add_ps( t, _mm_mul_ps( _mm_set1_ps( m.m[3][1] ), row1 ));
+    t = _mm_add_ps( t, _mm_mul_ps( _mm_set1_ps( m.m[3][2] ), row2 ));
+    _mm_store_ps( matrix.m[3], _mm_sub_ps( _mm_setzero_ps(), t ));
+    matrix.m[3][3] = 1.0f;
+#else
     matrix.m[0][0] = m.m[0][0]; matrix.m[0][1] = m.m[1][0]; matrix.m[0][2] = m.m[2][0]; matrix.m[0][3] = 0.0f;
     matrix.m[1][0] = m.m[0][1]; matrix.m[1][1] = m.m[1][1]; matrix.m[1][2] = m.m[2][1]; matrix.m[1][3] = 0.0f;
     matrix.m[2][0] = m.m[0][2]; matrix.m[2][1] = m.m[1][2]; matrix.m[2][2] = m.m[2][2]; matrix.m[2][3] = 0.0f;
@@ -203,6 +358,7 @@ mat4x4 Matrix_QuickInverse(mat4x4 &m) { // Only for Rotation/Translation Matrice
     matrix.m[3][1] = -(m.m[3][0] * matrix.m[0][1] + m.m[3][1] * matrix.m[1][1] + m.m[3][2] * matrix.m[2][1]);
     matrix.m[3][2] = -(m.m[3][0] * matrix.m[0][2] + m.m[3][1] * matrix.m[1][2] + m.m[3][2] * matrix.m[2][2]);
     matrix.m[3][3] = 1.0f;
+#endif
     return matrix;
 }
 
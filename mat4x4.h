@@ -7,19 +7,52 @@
 
 #define PI 3.1415926535f
 
+// SIMD SELECTION
+// The matrix kernels use SSE2 if the target supports it (SSE2 is part of the x86-64 baseline).
+// Define MAT4X4_NO_SIMD (e.g. compile with -DMAT4X4_NO_SIMD) to select the portable scalar code instead.
+#if !defined( MAT4X4_NO_SIMD ) && (defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2))
+    #define MAT4X4_SSE2 1
+#else
+    #define MAT4X4_SSE2 0
+#endif
+
 // DATATYPES
 
-struct mat4x4 {
+struct alignas(16) mat4x4 {
     // matrix compatible with vec3d - ordering is row - column
+    // 16 byte aligned, so that each row can be loaded into an SSE register in one go
     float m[4][4] = { 0 };
 };
 
+// The nine input parameters of a complete transformation matrix: scale factors, rotation angles (in radians)
+// and translation offsets, all for the x, y and z dimension. See Matrix_MakeTransformComplete().
+struct transformSRT {
+    float xScale = 1.0f, yScale = 1.0f, zScale = 1.0f;
+    float xAngle = 0.0f, yAngle = 0.0f, zAngle = 0.0f;
+    float xTrnsl = 0.0f, yTrnsl = 0.0f, zTrnsl = 0.0f;
+};
+
 // FUNCTION PROTOTYPES
 
+// Calculates both the sine and cosine of fAngleRad, using a fused sincos if the compiler provides one.
+void Matrix_SinCos( float fAngleRad, float &fSin, float &fCos );
+
 // Returns the matrix multiplication result between vector i and matrix m.
 // The vector is considered a row vector, so the i-th element of the vector is
 // calculated using column i of the matrix.
-vec3d Matrix_MultiplyVector( mat4x4 &m, vec3d &v );
+vec3d Matrix_MultiplyVector( const mat4x4 &m, const vec3d &v );
+
+// Batch version of Matrix_MultiplyVector(). Transforms nCount vertices that are stored in structure of arrays
+// layout (the x, y, z and w coordinates each in their own array). The vertices are considered row vectors.
+// The loop is written so that the compiler can auto-vectorize it: input and output arrays must not overlap.
+// If wIn is nullptr, w = 1.0f is used for all input vertices.
+void Matrix_MultiplyVectorStream( const mat4x4 &m,
+                                  const float *xIn, const float *yIn, const float *zIn, const float *wIn,
+                                  float *xOut, float *yOut, float *zOut, float *wOut, int nCount );
+
+// Transforms all vertices of vertex stream sIn using matrix m, and puts the result in sOut (which is resized if needed).
+// sIn and sOut must be different streams.
+void Matrix_MultiplyVertexStream( const mat4x4 &m, vertexStream &sIn, vertexStream &sOut );
 
 // Builds a matrix using the 16 parameters. Both rows and columns count from 0 to 3.
 // Returns the resulting matrix.
@@ -62,13 +95,28 @@ mat4x4 Matrix_MakeProjection( float fFovDegrees, float fAspectRatio, float fNear
 
 // Returns the result of matrix multiplication of m1 and m2.
 // the new value at (r, c) is constructed using the row vector r of m1 and the column vector c of m2
-mat4x4 Matrix_MultiplyMatrix(  mat4x4 &m1, mat4x4 &m2 );
+mat4x4 Matrix_MultiplyMatrix( const mat4x4 &m1, const mat4x4 &m2 );
+
+// Returns the transpose of matrix m (rows become columns and vice versa).
+mat4x4 Matrix_Transpose( const mat4x4 &m );
+
+// Returns the matrix that transforms the normals of surfaces that are transformed with m. Only the upper left 3x3 part
+// of m is used: the result is its cofactor matrix. It isn't normalised: the face normal n = cross( p1 - p0, p2 - p0 ) of
+// a triangle is transformed into exactly the face normal of the transformed triangle, also for non uniform scaling and
+// mirroring. Transform normals with w = 0 (so without translation).
+mat4x4 Matrix_MakeNormalMatrix( const mat4x4 &m );
 
 // Creates and returns a complete transformation matrix using the scale factors, the rotation angles
-// and translation distances.
+// and translation distances. The result equals rotY * scale * rotZ * rotX * translate, but it is composed
+// in closed form, without building and multiplying the separate matrices.
 mat4x4 Matrix_MakeTransformComplete( float xScale, float yScale, float zScale,
                                      float xAngle, float yAngle, float zAngle,
                                      float xTrnsl, float yTrnsl, float zTrnsl );
+mat4x4 Matrix_MakeTransformComplete( const transformSRT &srt );
+
+// Batch version of the above: creates nCount transformation matrices into pMatrices, from the parameter
+// sets in pParams.
+void Matrix_MakeTransformCompleteBatch( const transformSRT *pParams, mat4x4 *pMatrices, int nCount );
 
 // Intuitively the point-at matrix is used to make translations from the world coordinate system to the camera coordinate system.
 // It doesn't translate anything into the world itself, but only puts the camera in the correct world coordinates.
@@ -78,7 +126,7 @@ mat4x4 Matrix_PointAt( vec3d &pos, vec3d &target, vec3d &up );
 // Matrix_QuickInverse() creates the "Look-At" - matrix. This is the matrix that translates the world coordinates into camera (view)
 // coordinates. The Look-At matrix is also known as view matrix
 // IMPORTANT NOTE: only for Rotation/Translation Matrices - DOES NOT WORK in combination with scaling matrices
-mat4x4 Matrix_QuickInverse( mat4x4 &m );
+mat4x4 Matrix_QuickInverse( const mat4x4 &m );
 
 // Prints the contents of a matrix to a string, and returns the string
 // can be used to std::cout printing or for saving to a file
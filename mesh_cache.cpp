@@ -0,0 +1,131 @@
+#include  "mesh_cache.h"
+
+#include     <cstdio>
+#include    <cstring>
+#include <filesystem>
+
+#include "mapped_file.h"
+
+static_assert( sizeof( vec2d ) == 3 * sizeof( float ), "the texs block stores vec2d as 3 floats" );
+
+// rounds nOffset up to the next multiple of MESH_CACHE_ALIGN
+static uint64_t MeshCache_Align( uint64_t nOffset ) {
+    return (nOffset + MESH_CACHE_ALIGN - 1) / MESH_CACHE_ALIGN * MESH_CACHE_ALIGN;
+}
+
+// writes nSize bytes from pData at position nOffset of the file, padding the gap since the current position with zeros
+static bool MeshCache_WriteBlock( FILE *pFile, uint64_t &nPosition, uint64_t nOffset, const void *pData, size_t nSize ) {
+    static const char cZeros[MESH_CACHE_ALIGN] = { 0 };
+    if (nOffset > nPosition && std::fwrite( cZeros, 1, nOffset - nPosition, pFile ) != nOffset - nPosition)
+        return false;
+    if (nSize > 0 && std::fwrite( pData, 1, nSize, pFile ) != nSize)
+        return false;
+    nPosition = nOffset + nSize;
+    return true;
+}
+
+bool MeshCache_Save( const std::string &sFileName, mesh &m ) {
+    meshBuffers b = Mesh_GetBuffers( m );
+
+    // the vertices are stored with w = 1, so a mesh with other w values can't be cached
+    if (b.w != nullptr)
+        for (int i = 0; i < b.nVerts; i++)
+            if (b.w[i] != 1.0f)
+                return false;
+
+    meshCacheHeader header;
+    std::memset( &header, 0, sizeof( header ));
+    std::memcpy( header.sMagic, MESH_CACHE_MAGIC, sizeof( header.sMagic ));
+    header.nVersion       = MESH_CACHE_VERSION;
+    header.nEndianTag     = MESH_CACHE_ENDIAN;
+    header.nVerts         = (uint32_t)b.nVerts;
+    header.nTris          = (uint32_t)b.nTris;
+    uint64_t nVertBytes   = (uint64_t)b.nVerts * sizeof( float );
+    header.nOffsetX       = MeshCache_Align( sizeof( header ));
+    header.nOffsetY       = MeshCache_Align( header.nOffsetX + nVertBytes );
+    header.nOffsetZ       = MeshCache_Align( header.nOffsetY + nVertBytes );
+    header.nOffsetIndices = MeshCache_Align( header.nOffsetZ + nVertBytes );
+    header.nOffsetTexs    = MeshCache_Align( header.nOffsetIndices + 3 * (uint64_t)b.nTris * sizeof( uint32_t ));
+    header.nFileSize      = header.nOffsetTexs + 3 * (uint64_t)b.nTris * sizeof( vec2d );
+    header.fBoundsMin[0]    = m.vBoundsMin.x;     header.fBoundsMin[1]    = m.vBoundsMin.y;     header.fBoundsMin[2]    = m.vBoundsMin.z;
+    header.fBoundsMax[0]    = m.vBoundsMax.x;     header.fBoundsMax[1]    = m.vBoundsMax.y;     header.fBoundsMax[2]    = m.vBoundsMax.z;
+    header.fSphereCentre[0] = m.vSphereCentre.x;  header.fSphereCentre[1] = m.vSphereCentre.y;  header.fSphereCentre[2] = m.vSphereCentre.z;
+    header.fSphereRadius    = m.fSphereRadius;
+
+    std::string sTempName = sFileName + ".tmp";
+    FILE *pFile = std::fopen( sTempName.c_str(), "wb" );
+    if (pFile == nullptr)
+        return false;
+    uint64_t nPosition = 0;
+    bool bOk = MeshCache_WriteBlock( pFile, nPosition, 0,                     &header,   sizeof( header )) &&
+               MeshCache_WriteBlock( pFile, nPosition, header.nOffsetX,       b.x,       nVertBytes ) &&
+               MeshCache_WriteBlock( pFile, nPosition, header.nOffsetY,       b.y,       nVertBytes ) &&
+               MeshCache_WriteBlock( pFile, nPosition, header.nOffsetZ,       b.z,       nVertBytes ) &&
+               MeshCache_WriteBlock( pFile, nPosition, header.nOffsetIndices, b.indices, 3 * (size_t)b.nTris * sizeof( uint32_t )) &&
+               MeshCache_WriteBlock( pFile, nPosition, header.nOffsetTexs,    b.texs,    3 * (size_t)b.nTris * sizeof( vec2d ));
+    bOk = (std::fclose( pFile ) == 0) && bOk;
+
+    std::error_code ec;
+    if (bOk)
+        std::filesystem::rename( sTempName, sFileName, ec );
+    if (!bOk || ec) {
+        std::remove( sTempName.c_str() );
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache_Load( const std::string &sFileName, mesh &m ) {
+    auto pFile = std::make_shared<mappedFile>();
+    if (!pFile->Open( sFileName ) || pFile->Size() < sizeof( meshCacheHeader ))
+        return false;
+
+    // Check the header, and that all blocks are aligned and within the file. The contents of the blocks are not
+    // checked, that would mean reading the whole file.
+    meshCacheHeader header;
+    std::memcpy( &header, pFile->Data(), sizeof( header ));
+    uint64_t nVertBytes  = (uint64_t)header.nVerts * sizeof( float );
+    uint64_t nIndexBytes = 3 * (uint64_t)header.nTris * sizeof( uint32_t );
+    uint64_t nTexBytes   = 3 * (uint64_t)header.nTris * sizeof( vec2d );
+    auto fnBlockOk = [&]( uint64_t nOffset, uint64_t nSize ) {
+        return nOffset % MESH_CACHE_ALIGN == 0 && nOffset >= sizeof( header ) && nOffset <= header.nFileSize && nSize <= header.nFileSize - nOffset;
+    };
+    if (std::memcmp( header.sMagic, MESH_CACHE_MAGIC, sizeof( header.sMagic )) != 0 ||
+        header.nVersion   != MESH_CACHE_VERSION ||
+        header.nEndianTag != MESH_CACHE_ENDIAN  ||
+        header.nFileSize  != pFile->Size()      ||
+        header.nVerts > INT32_MAX || header.nTris > INT32_MAX / 3 ||
+        !fnBlockOk( header.nOffsetX,       nVertBytes  ) ||
+        !fnBlockOk( header.nOffsetY,       nVertBytes  ) ||
+        !fnBlockOk( header.nOffsetZ,       nVertBytes  ) ||
+        !fnBlockOk( header.nOffsetIndices, nIndexBytes ) ||
+        !fnBlockOk( header.nOffsetTexs,    nTexBytes   ))
+        return false;
+
+    // release the data the mesh may hold itself, and make it a view on the mapped file
+    m.verts   = vertexStream();
+    m.indices = std::vector<uint32_t>();
+    m.texs    = std::vector<vec2d>();
+
+    const char *pData = pFile->Data();
+    meshBuffers &b = m.viewBuffers;
+    b.x       = (const float    *)(pData + header.nOffsetX);
+    b.y       = (const float    *)(pData + header.nOffsetY);
+    b.z       = (const float    *)(pData + header.nOffsetZ);
+    b.w       = nullptr;
+    b.indices = (const uint32_t *)(pData + header.nOffsetIndices);
+    b.texs    = (const vec2d    *)(pData + header.nOffsetTexs);
+    b.nVerts  = (int)header.nVerts;
+    b.nTris   = (int)header.nTris;
+    m.pViewOwner = pFile;
+
+    m.vBoundsMin    = { header.fBoundsMin[0],    header.fBoundsMin[1],    header.fBoundsMin[2]    };
+    m.vBoundsMax    = { header.fBoundsMax[0],    header.fBoundsMax[1],    header.fBoundsMax[2]    };
+    m.vSphereCentre = { header.fSphereCentre[0], header.fSphereCentre[1], header.fSphereCentre[2] };
+    m.fSphereRadius = header.fSphereRadius;
+    return true;
+}
+
+std::string MeshCache_FileName( const std::string &sSourceFile ) {
+    return sSourceFile + ".meshcache";
+}
@@ -0,0 +1,47 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include  <string>
+
+#include "graphics_3D.h"
+
+// Binary mesh cache files
+//
+// A cache file holds the data of an indexed mesh in the exact layout that the pipeline uses, so it can be memory mapped
+// and used in place: loading it takes no parsing and no copying, only the pages that are touched are read from disk.
+// The file consists of a header followed by five blocks, each starting at a multiple of MESH_CACHE_ALIGN bytes:
+//     x, y, z       nVerts floats each - the vertex positions (w = 1)
+//     indices       3 * nTris uint32_t - three vertex indices per triangle
+//     texs          3 * nTris vec2d    - three texture coordinates per triangle
+// All values are stored in the byte order of the machine that wrote the file. A file with another version, or
+// written on a machine with another byte order, is rejected (and will be rewritten from the source file).
+
+#define MESH_CACHE_MAGIC      "MTDMESH"      // 7 characters plus the terminating 0
+#define MESH_CACHE_VERSION    1
+#define MESH_CACHE_ENDIAN     0x01020304u
+#define MESH_CACHE_ALIGN      64
+
+struct meshCacheHeader {
+    char     sMagic[8];
+    uint32_t nVersion;
+    uint32_t nEndianTag;                // MESH_CACHE_ENDIAN, as written by the machine that made the file
+    uint32_t nVerts, nTris;
+    uint64_t nOffsetX, nOffsetY, nOffsetZ, nOffsetIndices, nOffsetTexs;    // byte offsets of the blocks
+    uint64_t nFileSize;
+    float    fBoundsMin[3], fBoundsMax[3];    // the bounding volumes, so they don't have to be recomputed on loading
+    float    fSphereCentre[3], fSphereRadius;
+};
+
+// Writes mesh m to cache file sFileName. The file is written under a temporary name first and then renamed, so a
+// reader never sees a partly written file. Returns false if the file can't be written.
+bool MeshCache_Save( const std::string &sFileName, mesh &m );
+
+// Maps cache file sFileName, and makes mesh m a view on it (see mesh in graphics_3D.h). The appearance info of m is
+// not changed. Returns false (and leaves m unchanged) if the file can't be mapped or isn't a valid cache file.
+bool MeshCache_Load( const std::string &sFileName, mesh &m );
+
+// returns the name of the cache file that belongs to source file sSourceFile (it is stored next to it)
+std::string MeshCache_FileName( const std::string &sSourceFile );
+
+#endif // MESH_CACHE_H
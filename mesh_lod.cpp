@@ -0,0 +1,499 @@
+#include "mesh_lod.h"
+
+#include <algorithm>
+#include     <cmath>
+#include <functional>
+
+#define SIMPLIFY_BORDER_WEIGHT    100.0    // weight of the planes that keep border edges in place
+#define SIMPLIFY_MIN_NORMAL_DOT   0.2      // a collapse may turn a triangle by at most acos( this ) (about 78 degrees)
+
+// ==============================/   Quadrics    /==============================
+
+// A symmetric 4x4 matrix Q, such that v^T Q v (with v = (x, y, z, 1)) is the sum of the squared distances of v to a
+// set of planes. Only the upper triangle is stored. w is the number of triangle planes in the sum, so that the error
+// can be given as the root mean square distance (the border planes are not counted, so they weigh in fully). Doubles,
+// since the sums of many planes lose too much precision in floats.
+struct quadric {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+    double            a11 = 0.0, a12 = 0.0, a13 = 0.0;
+    double                       a22 = 0.0, a23 = 0.0;
+    double                                  a33 = 0.0;
+    double w = 0.0;
+};
+
+// adds plane a * x + b * y + c * z + d = 0 (normalised) with weight w to q
+static void Quadric_AddPlane( quadric &q, double a, double b, double c, double d, double w ) {
+    q.a00 += w * a * a;  q.a01 += w * a * b;  q.a02 += w * a * c;  q.a03 += w * a * d;
+                         q.a11 += w * b * b;  q.a12 += w * b * c;  q.a13 += w * b * d;
+                                              q.a22 += w * c * c;  q.a23 += w * c * d;
+                                                                   q.a33 += w * d * d;
+}
+
+static quadric Quadric_Add( const quadric &p, const quadric &q ) {
+    quadric r;
+    r.a00 = p.a00 + q.a00;  r.a01 = p.a01 + q.a01;  r.a02 = p.a02 + q.a02;  r.a03 = p.a03 + q.a03;
+                            r.a11 = p.a11 + q.a11;  r.a12 = p.a12 + q.a12;  r.a13 = p.a13 + q.a13;
+                                                    r.a22 = p.a22 + q.a22;  r.a23 = p.a23 + q.a23;
+                                                                            r.a33 = p.a33 + q.a33;
+    r.w = p.w + q.w;
+    return r;
+}
+
+// returns v^T Q v / w for v = (x, y, z, 1): the mean squared distance of v to the triangle planes of q
+static double Quadric_Error( const quadric &q, double x, double y, double z ) {
+    double fError = x * (q.a00 * x + 2.0 * (q.a01 * y + q.a02 * z + q.a03)) +
+                    y * (q.a11 * y + 2.0 * (q.a12 * z + q.a13)) +
+                    z * (q.a22 * z + 2.0 * q.a23) + q.a33;
+    return fError / std::max( q.w, 1.0 );
+}
+
+// Finds the point where the error of q is smallest, by solving the 3x3 system of its derivatives (Cramer's rule).
+// Returns false if the system is (nearly) singular, as it is for flat or straight neighbourhoods.
+static bool Quadric_Minimum( const quadric &q, double &x, double &y, double &z ) {
+    double c00 = q.a11 * q.a22 - q.a12 * q.a12, c01 = q.a02 * q.a12 - q.a01 * q.a22, c02 = q.a01 * q.a12 - q.a02 * q.a11;
+    double fDet = q.a00 * c00 + q.a01 * c01 + q.a02 * c02;
+    double fScale = q.a00 + q.a11 + q.a22;
+    if (std::fabs( fDet ) <= 1e-9 * fScale * fScale * fScale)
+        return false;
+    double c11 = q.a00 * q.a22 - q.a02 * q.a02, c12 = q.a01 * q.a02 - q.a00 * q.a12, c22 = q.a00 * q.a11 - q.a01 * q.a01;
+    x = -(c00 * q.a03 + c01 * q.a13 + c02 * q.a23) / fDet;
+    y = -(c01 * q.a03 + c11 * q.a13 + c12 * q.a23) / fDet;
+    z = -(c02 * q.a03 + c12 * q.a13 + c22 * q.a23) / fDet;
+    return true;
+}
+
+// ==============================/   Simplifier    /==============================
+
+// The state of a simplification: the vertices with their quadrics, the triangles that are left, and the edges that can
+// be collapsed, in a heap ordered by cost. A collapse changes the quadric and position of the vertex that remains, so
+// the heap entries of its edges become stale. Rather than updating them, every vertex has a stamp that is incremented
+// on each change, and entries with stamps that don't match any more are skipped when they come up.
+struct simplifier {
+    std::vector<double>   x, y, z;
+    std::vector<quadric>  vecQuadrics;
+    std::vector<uint32_t> vecStamps;
+    std::vector<uint8_t>  vecRemovedVerts;
+
+    std::vector<uint32_t> vecIndices;         // three per triangle, the vertices of removed triangles are stale
+    std::vector<uint8_t>  vecRemovedTris;
+    std::vector<std::vector<uint32_t>> vecVertTris;    // per vertex the triangles that use it (may include removed ones)
+    int nTris = 0;
+
+    struct collapse {
+        double   fCost;
+        uint32_t v1, v2;          // v2 is collapsed into v1
+        uint32_t nStamp1, nStamp2;
+        double   x, y, z;         // the new position of v1
+        bool operator>( const collapse &c ) const { return fCost > c.fCost; }
+    };
+    std::vector<collapse> vecHeap;
+    std::vector<uint32_t> vecMarks;           // per vertex, for the neighbour tests
+    uint32_t nMark = 0;
+    double   fMaxCost = 0.0;
+
+    const vec2d *pTexs = nullptr;             // the texture coordinates of the source mesh, per triangle corner
+    uint16_t nMaterial = MATERIAL_DEFAULT;
+
+    void Init( mesh &m );
+    void PushEdge( uint32_t v1, uint32_t v2 );
+    bool TryCollapse( const collapse &c );
+    void Run( int nTargetTris );
+    void Output( mesh &dst );
+    // returns the (non normalised) normal of triangle t, with vertex vOld moved to (nx, ny, nz)
+    void TriangleNormal( uint32_t t, uint32_t vOld, double nx, double ny, double nz, double n[3] );
+};
+
+void simplifier::TriangleNormal( uint32_t t, uint32_t vOld, double nx, double ny, double nz, double n[3] ) {
+    double p[3][3];
+    for (int k = 0; k < 3; k++) {
+        uint32_t v = vecIndices[3 * t + k];
+        p[k][0] = (v == vOld) ? nx : x[v];
+        p[k][1] = (v == vOld) ? ny : y[v];
+        p[k][2] = (v == vOld) ? nz : z[v];
+    }
+    double e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+    double e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+void simplifier::Init( mesh &m ) {
+    meshBuffers b = Mesh_GetBuffers( m );
+    x.assign( b.x, b.x + b.nVerts );
+    y.assign( b.y, b.y + b.nVerts );
+    z.assign( b.z, b.z + b.nVerts );
+    vecQuadrics.assign( b.nVerts, quadric() );
+    vecStamps.assign( b.nVerts, 0 );
+    vecRemovedVerts.assign( b.nVerts, 0 );
+    vecMarks.assign( b.nVerts, 0 );
+    vecIndices.assign( b.indices, b.indices + 3 * b.nTris );
+    vecRemovedTris.assign( b.nTris, 0 );
+    vecVertTris.assign( b.nVerts, std::vector<uint32_t>() );
+    nTris     = b.nTris;
+    pTexs     = b.texs;
+    nMaterial = m.nMaterial;
+
+    // the planes of the triangles
+    for (int t = 0; t < b.nTris; t++) {
+        double n[3];
+        TriangleNormal( t, UINT32_MAX, 0.0, 0.0, 0.0, n );
+        double fLength = std::sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+        for (int k = 0; k < 3; k++)
+            vecVertTris[vecIndices[3 * t + k]].push_back( t );
+        if (fLength == 0.0)
+            continue;    // degenerate, it has no plane
+        n[0] /= fLength;  n[1] /= fLength;  n[2] /= fLength;
+        uint32_t v0 = vecIndices[3 * t];
+        double d = -(n[0] * x[v0] + n[1] * y[v0] + n[2] * z[v0]);
+        for (int k = 0; k < 3; k++) {
+            Quadric_AddPlane( vecQuadrics[vecIndices[3 * t + k]], n[0], n[1], n[2], d, 1.0 );
+            vecQuadrics[vecIndices[3 * t + k]].w += 1.0;
+        }
+    }
+
+    // The edges, as (smallest vertex, largest vertex, triangle), sorted so that the copies of an edge are adjacent. An
+    // edge that only one triangle has is a border edge, and gets a plane through it, perpendicular to its triangle.
+    struct edge {
+        uint32_t v1, v2, t;
+        bool operator<( const edge &e ) const { return v1 != e.v1 ? v1 < e.v1 : v2 < e.v2; }
+    };
+    std::vector<edge> vecEdges;
+    vecEdges.reserve( 3 * (size_t)b.nTris );
+    for (int t = 0; t < b.nTris; t++)
+        for (int k = 0; k < 3; k++) {
+            uint32_t v1 = vecIndices[3 * t + k], v2 = vecIndices[3 * t + (k + 1) % 3];
+            if (v1 != v2)
+                vecEdges.push_back( { std::min( v1, v2 ), std::max( v1, v2 ), (uint32_t)t } );
+        }
+    std::sort( vecEdges.begin(), vecEdges.end() );
+    for (size_t i = 0; i < vecEdges.size(); ) {
+        size_t j = i + 1;
+        while (j < vecEdges.size() && vecEdges[j].v1 == vecEdges[i].v1 && vecEdges[j].v2 == vecEdges[i].v2)
+            j++;
+        const edge &e = vecEdges[i];
+        if (j - i == 1) {
+            double n[3];
+            TriangleNormal( e.t, UINT32_MAX, 0.0, 0.0, 0.0, n );
+            double d[3] = { x[e.v2] - x[e.v1], y[e.v2] - y[e.v1], z[e.v2] - z[e.v1] };
+            double p[3] = { d[1] * n[2] - d[2] * n[1], d[2] * n[0] - d[0] * n[2], d[0] * n[1] - d[1] * n[0] };
+            double fLength = std::sqrt( p[0] * p[0] + p[1] * p[1] + p[2] * p[2] );
+            if (fLength > 0.0) {
+                p[0] /= fLength;  p[1] /= fLength;  p[2] /= fLength;
+                double fOffset = -(p[0] * x[e.v1] + p[1] * y[e.v1] + p[2] * z[e.v1]);
+                Quadric_AddPlane( vecQuadrics[e.v1], p[0], p[1], p[2], fOffset, SIMPLIFY_BORDER_WEIGHT );
+                Quadric_AddPlane( vecQuadrics[e.v2], p[0], p[1], p[2], fOffset, SIMPLIFY_BORDER_WEIGHT );
+            }
+        }
+        i = j;
+    }
+
+    vecHeap.clear();
+    for (size_t i = 0; i < vecEdges.size(); i++)
+        if (i == 0 || vecEdges[i].v1 != vecEdges[i - 1].v1 || vecEdges[i].v2 != vecEdges[i - 1].v2)
+            PushEdge( vecEdges[i].v1, vecEdges[i].v2 );
+    fMaxCost = 0.0;
+}
+
+// Computes the cheapest position for the collapse of edge (v1, v2): the minimum of the summed quadric if it has one
+// near the edge, otherwise the best of the two end points and the midpoint. Adds the collapse to the heap.
+void simplifier::PushEdge( uint32_t v1, uint32_t v2 ) {
+    quadric q = Quadric_Add( vecQuadrics[v1], vecQuadrics[v2] );
+    collapse c;
+    bool bMinimum = Quadric_Minimum( q, c.x, c.y, c.z );
+    if (bMinimum) {
+        // a nearly singular system can put the minimum far away - keep it within an edge length of the midpoint
+        double dx = x[v2] - x[v1], dy = y[v2] - y[v1], dz = z[v2] - z[v1];
+        double mx = c.x - 0.5 * (x[v1] + x[v2]), my = c.y - 0.5 * (y[v1] + y[v2]), mz = c.z - 0.5 * (z[v1] + z[v2]);
+        bMinimum = mx * mx + my * my + mz * mz <= dx * dx + dy * dy + dz * dz;
+    }
+    if (!bMinimum) {
+        double fCandidates[3][3] = { { x[v1], y[v1], z[v1] }, { x[v2], y[v2], z[v2] },
+                                     { 0.5 * (x[v1] + x[v2]), 0.5 * (y[v1] + y[v2]), 0.5 * (z[v1] + z[v2]) } };
+        double fBest = -1.0;
+        for (auto &p : fCandidates) {
+            double fError = Quadric_Error( q, p[0], p[1], p[2] );
+            if (fBest < 0.0 || fError < fBest) {
+                fBest = fError;
+                c.x = p[0];  c.y = p[1];  c.z = p[2];
+            }
+        }
+    }
+    c.fCost   = std::max( 0.0, Quadric_Error( q, c.x, c.y, c.z ));
+    c.v1      = v1;
+    c.v2      = v2;
+    c.nStamp1 = vecStamps[v1];
+    c.nStamp2 = vecStamps[v2];
+    vecHeap.push_back( c );
+    std::push_heap( vecHeap.begin(), vecHeap.end(), std::greater<collapse>() );
+}
+
+// Does collapse c, unless it would make the mesh non manifold or flip a triangle. Returns whether it was done.
+bool simplifier::TryCollapse( const collapse &c ) {
+    uint32_t v1 = c.v1, v2 = c.v2;
+
+    // The link condition: the vertices that are neighbours of both v1 and v2 must be exactly the third vertices of the
+    // triangles that have both. Otherwise the collapse would pinch the surface together.
+    nMark++;
+    for (uint32_t t : vecVertTris[v1])
+        if (!vecRemovedTris[t])
+            for (int k = 0; k < 3; k++)
+                vecMarks[vecIndices[3 * t + k]] = nMark;
+    int nShared = 0, nCommon = 0;
+    for (uint32_t t : vecVertTris[v2]) {
+        if (vecRemovedTris[t])
+            continue;
+        bool bHasV1 = false;
+        for (int k = 0; k < 3; k++)
+            bHasV1 |= (vecIndices[3 * t + k] == v1);
+        nShared += bHasV1;
+    }
+    uint32_t nMarkCommon = ++nMark;    // marks the common neighbours, so each is counted once
+    for (uint32_t t : vecVertTris[v2])
+        if (!vecRemovedTris[t])
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = vecIndices[3 * t + k];
+                if (v != v1 && v != v2 && vecMarks[v] == nMarkCommon - 1) {
+                    vecMarks[v] = nMarkCommon;
+                    nCommon++;
+                }
+            }
+    if (nCommon != nShared)
+        return false;
+
+    // no triangle that remains may turn over (or nearly so)
+    for (uint32_t v : { v1, v2 })
+        for (uint32_t t : vecVertTris[v]) {
+            if (vecRemovedTris[t])
+                continue;
+            const uint32_t *p = &vecIndices[3 * t];
+            if ((p[0] == v1 || p[1] == v1 || p[2] == v1) && (p[0] == v2 || p[1] == v2 || p[2] == v2))
+                continue;    // this one disappears
+            double nOld[3], nNew[3];
+            TriangleNormal( t, UINT32_MAX, 0.0, 0.0, 0.0, nOld );
+            TriangleNormal( t, v, c.x, c.y, c.z, nNew );
+            double fDot  = nOld[0] * nNew[0] + nOld[1] * nNew[1] + nOld[2] * nNew[2];
+            double fOld2 = nOld[0] * nOld[0] + nOld[1] * nOld[1] + nOld[2] * nOld[2];
+            double fNew2 = nNew[0] * nNew[0] + nNew[1] * nNew[1] + nNew[2] * nNew[2];
+            if (fOld2 > 0.0 && fDot < SIMPLIFY_MIN_NORMAL_DOT * std::sqrt( fOld2 * fNew2 ))
+                return false;
+        }
+
+    // do it: v1 moves, the triangles of v2 get v1 instead, and the ones that had both disappear
+    x[v1] = c.x;  y[v1] = c.y;  z[v1] = c.z;
+    vecQuadrics[v1] = Quadric_Add( vecQuadrics[v1], vecQuadrics[v2] );
+    vecStamps[v1]++;
+    vecRemovedVerts[v2] = 1;
+    for (uint32_t t : vecVertTris[v2]) {
+        if (vecRemovedTris[t])
+            continue;
+        uint32_t *p = &vecIndices[3 * t];
+        if (p[0] == v1 || p[1] == v1 || p[2] == v1) {
+            vecRemovedTris[t] = 1;
+            nTris--;
+        } else {
+            for (int k = 0; k < 3; k++)
+                if (p[k] == v2)
+                    p[k] = v1;
+            vecVertTris[v1].push_back( t );
+        }
+    }
+    vecVertTris[v2].clear();
+    vecVertTris[v2].shrink_to_fit();
+
+    // drop the removed triangles of v1, and requeue its edges with the new quadric
+    auto &vecTris = vecVertTris[v1];
+    vecTris.erase( std::remove_if( vecTris.begin(), vecTris.end(), [this]( uint32_t t ) { return vecRemovedTris[t] != 0; } ),
+                   vecTris.end() );
+    nMark++;
+    vecMarks[v1] = nMark;
+    for (uint32_t t : vecTris)
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = vecIndices[3 * t + k];
+            if (vecMarks[v] != nMark) {
+                vecMarks[v] = nMark;
+                PushEdge( v1, v );
+            }
+        }
+    fMaxCost = std::max( fMaxCost, c.fCost );
+    return true;
+}
+
+void simplifier::Run( int nTargetTris ) {
+    while (nTris > nTargetTris && !vecHeap.empty()) {
+        std::pop_heap( vecHeap.begin(), vecHeap.end(), std::greater<collapse>() );
+        collapse c = vecHeap.back();
+        vecHeap.pop_back();
+        if (vecRemovedVerts[c.v1] || vecRemovedVerts[c.v2] ||
+            vecStamps[c.v1] != c.nStamp1 || vecStamps[c.v2] != c.nStamp2)
+            continue;    // stale
+        TryCollapse( c );
+    }
+}
+
+// Puts the triangles that are left into mesh dst, with only the vertices they use
+void simplifier::Output( mesh &dst ) {
+    Mesh_ClearView( dst );
+    dst.indices.clear();
+    dst.texs.clear();
+    std::vector<uint32_t> vecNewIndex( x.size(), UINT32_MAX );
+    std::vector<vec3d>    vecVerts;
+    for (size_t t = 0; t < vecRemovedTris.size(); t++) {
+        if (vecRemovedTris[t])
+            continue;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = vecIndices[3 * t + k];
+            if (vecNewIndex[v] == UINT32_MAX) {
+                vecNewIndex[v] = (uint32_t)vecVerts.size();
+                vecVerts.push_back( { (float)x[v], (float)y[v], (float)z[v] } );
+            }
+            dst.indices.push_back( vecNewIndex[v] );
+            dst.texs.push_back( pTexs != nullptr ? pTexs[3 * t + k] : vec2d() );
+        }
+    }
+    VertexStream_Resize( dst.verts, (int)vecVerts.size() );
+    for (int i = 0; i < (int)vecVerts.size(); i++)
+        VertexStream_Set( dst.verts, i, vecVerts[i] );
+    dst.nMaterial = nMaterial;
+    Mesh_ComputeBounds( dst );
+}
+
+float Mesh_Simplify( mesh &m, int nTargetTris, mesh &dst ) {
+    simplifier s;
+    s.Init( m );
+    s.Run( nTargetTris );
+    s.Output( dst );
+    return (float)std::sqrt( s.fMaxCost );
+}
+
+// ==============================/   LOD meshes    /==============================
+
+void LodMesh_Build( lodMesh &lm, mesh &m, int nMaxLevels ) {
+    lm.pBase = &m;
+    lm.vecLevels.clear();
+    lm.vecError.assign( 1, 0.0f );
+
+    // every level continues the simplification of the previous one
+    simplifier s;
+    s.Init( m );
+    int nTris = Mesh_TriangleCount( m );
+    while ((int)lm.vecError.size() < nMaxLevels) {
+        int nTarget = (int)(nTris * LOD_LEVEL_RATIO);
+        if (nTarget < LOD_MIN_TRIANGLES)
+            break;
+        s.Run( nTarget );
+        if (s.nTris >= nTris)
+            break;    // nothing more can be collapsed
+        nTris = s.nTris;
+        lm.vecLevels.emplace_back();
+        s.Output( lm.vecLevels.back() );
+        lm.vecError.push_back( (float)std::sqrt( s.fMaxCost ));
+    }
+}
+
+int LodMesh_LevelCount( const lodMesh &lm ) {
+    return 1 + (int)lm.vecLevels.size();
+}
+
+mesh &LodMesh_Level( lodMesh &lm, int nLevel ) {
+    return (nLevel == 0) ? *lm.pBase : lm.vecLevels[nLevel - 1];
+}
+
+// ==============================/   LOD selection    /==============================
+
+int lodSelector::Select( camera &cam, lodMesh *const *ppMeshes, const mat4x4 *pWorldMatrices, int nObjects ) {
+    if ((int)vecWanted.size() != nObjects)
+        vecWanted.assign( nObjects, -1 );
+    vecLevel.resize( nObjects );
+    vecPixelScale.resize( nObjects );
+    vecMeshes.assign( ppMeshes, ppMeshes + nObjects );
+
+    // the size in pixels of one unit at depth 1 in view space
+    float fPixelsPerUnit = cam.matProj.m[1][1] * 0.5f * (float)cam.nViewPortHeight;
+
+    int nTriangles = 0;
+    for (int i = 0; i < nObjects; i++) {
+        lodMesh &lm = *ppMeshes[i];
+        mesh &m = *lm.pBase;
+        const mat4x4 &matWorld = pWorldMatrices[i];
+        if (cam.MeshInFrustum( m, matWorld ) == FRUSTUM_OUTSIDE) {
+            vecLevel[i] = -1;
+            continue;
+        }
+
+        // the bounding sphere in world space (as in camera::MeshInFrustum()), and the depth of its nearest point
+        float fScale = 0.0f;
+        for (int r = 0; r < 3; r++) {
+            vec3d vRow = { matWorld.m[r][0], matWorld.m[r][1], matWorld.m[r][2] };
+            fScale = std::max( fScale, Vector_Length( vRow ));
+        }
+        vec3d vCentre = Matrix_MultiplyVector( matWorld, m.vSphereCentre );
+        float fDepth  = Matrix_MultiplyVector( cam.matView, vCentre ).z - m.fSphereRadius * fScale;
+        float fPixelScale = fScale * fPixelsPerUnit / std::max( fDepth, cam.fNearPlane );
+        vecPixelScale[i] = fPixelScale;
+
+        // the coarsest level with an error of at most fLimit pixels
+        int nLevels = LodMesh_LevelCount( lm );
+        auto fnCoarsest = [&lm, nLevels, fPixelScale]( float fLimit ) {
+            int n = 0;
+            while (n + 1 < nLevels && lm.vecError[n + 1] * fPixelScale <= fLimit)
+                n++;
+            return n;
+        };
+        int &nWanted = vecWanted[i];
+        if (nWanted < 0 || nWanted >= nLevels)
+            nWanted = fnCoarsest( fMaxPixelError );
+        else {
+            int nCoarser = fnCoarsest( fMaxPixelError * (1.0f - fHysteresis));
+            int nFiner   = fnCoarsest( fMaxPixelError * (1.0f + fHysteresis));
+            if (nCoarser > nWanted)
+                nWanted = nCoarser;
+            else if (nFiner < nWanted)
+                nWanted = nFiner;
+        }
+        vecLevel[i] = nWanted;
+        nTriangles += Mesh_TriangleCount( LodMesh_Level( lm, nWanted ));
+    }
+
+    if (nTriangleBudget > 0 && nTriangles > nTriangleBudget)
+        FitBudget( nTriangles );
+    return nTriangles;
+}
+
+// Coarsens the levels of the visible objects until nTriangles fits in the budget, the one that adds the smallest error
+// in pixels first (greedy, with a heap that has one entry per object: its next coarser level)
+void lodSelector::FitBudget( int &nTriangles ) {
+    vecHeap.clear();
+    auto fnPush = [this]( int i ) {
+        int nNext = vecLevel[i] + 1;
+        if (nNext < LodMesh_LevelCount( *vecMeshes[i] )) {
+            vecHeap.push_back( { vecMeshes[i]->vecError[nNext] * vecPixelScale[i], i, nNext } );
+            std::push_heap( vecHeap.begin(), vecHeap.end(), std::greater<coarsening>() );
+        }
+    };
+    for (int i = 0; i < (int)vecLevel.size(); i++)
+        if (vecLevel[i] >= 0)
+            fnPush( i );
+
+    while (nTriangles > nTriangleBudget && !vecHeap.empty()) {
+        std::pop_heap( vecHeap.begin(), vecHeap.end(), std::greater<coarsening>() );
+        coarsening c = vecHeap.back();
+        vecHeap.pop_back();
+        lodMesh &lm = *vecMeshes[c.nObject];
+        nTriangles += Mesh_TriangleCount( LodMesh_Level( lm, c.nLevel )) - Mesh_TriangleCount( LodMesh_Level( lm, vecLevel[c.nObject] ));
+        vecLevel[c.nObject] = c.nLevel;
+        fnPush( c.nObject );
+    }
+}
+
+int lodSelector::Level( int i ) {
+    return vecLevel[i];
+}
+
+mesh *lodSelector::Mesh( int i ) {
+    return (vecLevel[i] < 0) ? nullptr : &LodMesh_Level( *vecMeshes[i], vecLevel[i] );
+}
+
+void lodSelector::Reset() {
+    vecWanted.clear();
+}
@@ -0,0 +1,103 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <cstdint>
+#include  <vector>
+
+#include "graphics_3D.h"
+
+// Level of detail (LOD) meshes
+//
+// A far away object that covers a few pixels costs as much per triangle as a close one. A lodMesh therefore holds
+// simplified versions of a mesh, made once (when the mesh is loaded) by Mesh_Simplify(), and a lodSelector picks one
+// of them per object per frame, from how large the object is on screen.
+//
+// Mesh_Simplify() is a quadric error metric simplifier (Garland and Heckbert, "Surface simplification using quadric
+// error metrics", 1997): every vertex gets a quadric that sums the squared distances to the planes of its triangles,
+// and the edge whose collapse adds the least error is collapsed first, into the point where the summed quadric of its
+// two vertices is smallest. The error of a collapse is the root mean square distance of that point to the planes of
+// the original triangles around it, and every level records the largest error of the collapses that made it. The
+// selector projects that distance to pixels, and uses the coarsest level whose error stays below
+// lodSelector::fMaxPixelError.
+
+#define LOD_MAX_LEVELS          8        // the most levels of a lodMesh, including the mesh itself
+#define LOD_LEVEL_RATIO         0.25f    // the number of triangles of a level relative to the previous level
+#define LOD_MIN_TRIANGLES       64       // no level is made with fewer triangles than this
+#define LOD_HYSTERESIS          0.25f    // see lodSelector::fHysteresis
+
+// Simplifies mesh m to about nTargetTris triangles, and puts the result in dst (which gets the material of m and its
+// own bounds). Edges on the border of the mesh are kept in place as much as possible, and collapses that would flip a
+// triangle are not done, so the result can have more triangles than asked for. The texture coordinates of the
+// remaining triangle corners are kept as they are. Returns the largest error of the collapses, as a distance in model
+// space.
+float Mesh_Simplify( mesh &m, int nTargetTris, mesh &dst );
+
+// A mesh with its simplified versions. Level 0 is the mesh itself (which is not owned, and must stay alive as long
+// as the lodMesh), every next level has about LOD_LEVEL_RATIO of the triangles of the previous one.
+struct lodMesh {
+    mesh              *pBase = nullptr;
+    std::vector<mesh>  vecLevels;    // levels 1 and up
+    std::vector<float> vecError;     // per level (including level 0, with error 0) the error in model space
+};
+
+// Builds lodMesh lm for mesh m: up to nMaxLevels levels (including m itself), until a level would get fewer than
+// LOD_MIN_TRIANGLES triangles. The levels are made one from the other, so the errors never decrease.
+void LodMesh_Build( lodMesh &lm, mesh &m, int nMaxLevels = LOD_MAX_LEVELS );
+int  LodMesh_LevelCount( const lodMesh &lm );
+// returns level nLevel of lm, 0 being the mesh itself
+mesh &LodMesh_Level( lodMesh &lm, int nLevel );
+
+// Picks the levels of detail of a set of objects for one camera, every frame.
+//
+// Per object, the error of every level is projected to pixels with the bounding sphere of the object: a distance of
+// fError in model space covers about fError * scale * matProj.m[1][1] * height / 2 / z pixels, where z is the depth in
+// view space of the nearest point of the sphere (but at least the near plane). The coarsest level with an error below
+// fMaxPixelError is the one to use.
+//
+// To prevent objects from popping back and forth between two levels when they hover around a switch distance, a
+// coarser level is only taken once its error is below fMaxPixelError * (1 - fHysteresis), and a finer one only once
+// the error of the current level exceeds fMaxPixelError * (1 + fHysteresis).
+//
+// If nTriangleBudget isn't 0, the selected levels of the visible objects are coarsened further until their triangles
+// fit in the budget, starting with the coarsening that adds the smallest error in pixels. The hysteresis keeps
+// working with the levels as they would be without budget, so an object that gets its level back when the budget
+// allows it doesn't wait for the hysteresis.
+class lodSelector {
+public:
+    float fMaxPixelError  = 1.0f;
+    float fHysteresis     = LOD_HYSTERESIS;
+    int   nTriangleBudget = 0;               // 0 is no budget
+
+    // Selects the levels of nObjects objects for camera cam: object i is ppMeshes[i], with world matrix
+    // pWorldMatrices[i]. Objects that are outside the frustum get level -1. The objects must be passed in the same
+    // order every frame, since the hysteresis remembers the levels by index. Returns the number of triangles in the
+    // selected levels.
+    int Select( camera &cam, lodMesh *const *ppMeshes, const mat4x4 *pWorldMatrices, int nObjects );
+
+    // returns the level of object i as selected by the last Select(), -1 if it isn't visible
+    int Level( int i );
+    // returns the mesh of object i to render, nullptr if it isn't visible
+    mesh *Mesh( int i );
+
+    // forgets the levels of the previous frames (do this when the set of objects changes)
+    void Reset();
+
+private:
+    // per object, kept to prevent reallocation every frame
+    std::vector<int>       vecWanted;        // the level as chosen with hysteresis, before the budget is applied
+    std::vector<int>       vecLevel;         // the level that is rendered
+    std::vector<float>     vecPixelScale;    // the factor that takes an error in model space to pixels
+    std::vector<lodMesh *> vecMeshes;
+
+    // a coarsening that the budget could do: object nObject to level nLevel, at an error of fPixelError pixels
+    struct coarsening {
+        float fPixelError;
+        int   nObject, nLevel;
+        bool operator>( const coarsening &c ) const { return fPixelError > c.fPixelError; }
+    };
+    std::vector<coarsening> vecHeap;
+
+    void FitBudget( int &nTriangles );
+};
+
+#endif // MESH_LOD_H
@@ -0,0 +1,75 @@
+#include "multi_view.h"
+
+#include <functional>
+
+#include "profiler.h"
+
+int multiViewRenderer::AddView( camera *pCamera ) {
+    vecViews.emplace_back();
+    vecViews.back().pCamera = pCamera;
+    return (int)vecViews.size() - 1;
+}
+
+int multiViewRenderer::ViewCount() {
+    return (int)vecViews.size();
+}
+
+rasterList &multiViewRenderer::GetRasterList( int nView ) {
+    return vecViews[nView].trisToRaster;
+}
+
+void multiViewRenderer::Render( sceneGraph &graph, bool bOutline, uint32_t nOutlineColour, bool bDepthTest,
+                                int nTextureFilter, threadPool *pPool ) {
+
+    // runs the tasks on the pool if there is one - the lambdas below capture no more than two values, which
+    // std::function can store without allocating on the heap
+    auto fnParallel = [pPool]( int nTasks, const std::function<void( int )> &fnTask ) {
+        if (pPool != nullptr)
+            pPool->ParallelFor( nTasks, fnTask );
+        else
+            for (int i = 0; i < nTasks; i++)
+                fnTask( i );
+    };
+
+    // 1. the camera independent work, once per mesh
+    vecMeshNodes.clear();
+    for (int i = 0; i < graph.NodeCount(); i++)
+        if (graph.GetMesh( i ) != nullptr)
+            vecMeshNodes.push_back( i );
+    if (vecWorldMeshes.size() < vecMeshNodes.size())
+        vecWorldMeshes.resize( vecMeshNodes.size());
+    fnParallel( (int)vecMeshNodes.size(), [this, &graph]( int i ) {
+        int nNode = vecMeshNodes[i];
+        WorldMesh_Update( vecWorldMeshes[i], *graph.GetMesh( nNode ), graph.GetWorldMatrix( nNode ));
+    } );
+
+    // 2. per view: culling, projection, clipping and sorting
+    int nMeshes = (int)vecMeshNodes.size();
+    fnParallel( (int)vecViews.size(), [this, nMeshes]( int nView ) {
+        view &v = vecViews[nView];
+        RasterList_Clear( v.trisToRaster );
+        for (int i = 0; i < nMeshes; i++)
+            v.pCamera->CullViewAndProjectWorldMesh( vecWorldMeshes[i], v.trisToRaster );
+        v.pCamera->RasterizeTriangles( v.trisToRaster );
+    } );
+
+    // 3. per view, in order: clear the viewport and draw
+    PROFILE_SCOPE( "render views" );
+    for (view &v : vecViews) {
+        camera &cam = *v.pCamera;
+        cam.ClearCameraViewPort();
+
+        rasterTarget target;
+        target.pPixels = cam.gfxTarget->GetPixels();
+        target.pDepth  = pDepthBuffer;
+        target.nWidth  = cam.gfxTarget->ScreenWidth();
+        target.nHeight = cam.gfxTarget->ScreenHeight();
+        target.nClipX1 = cam.nViewPortX1;
+        target.nClipY1 = cam.nViewPortY1;
+        target.nClipX2 = cam.nViewPortX2 + 1;
+        target.nClipY2 = cam.nViewPortY2 + 1;
+        v.rasterizer.SetTarget( target );
+        v.rasterizer.DrawTriangles( v.trisToRaster, bOutline, nOutlineColour, bDepthTest, pPool, nTextureFilter );
+        PROFILE_COUNT( PROF_TRIS_RASTERIZED, (long long)v.trisToRaster.vecTris.size());
+    }
+}
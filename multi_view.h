@@ -0,0 +1,51 @@
+#ifndef MULTI_VIEW_H
+#define MULTI_VIEW_H
+
+#include <cstdint>
+#include  <vector>
+
+#include "graphics_3D.h"
+#include  "rasterizer.h"
+#include "scene_graph.h"
+#include "thread_pool.h"
+
+// Renders one scene into several views (split screen, picture in picture, ...), each seen by its own camera. The views
+// share the render target of their cameras and the depth buffer (pDepthBuffer), and every view only draws within the
+// viewport of its camera.
+//
+// A frame is done in three steps, so that the work that doesn't depend on the camera is only done once:
+//   1. per mesh of the scene graph: the world transform and the lighting (see WorldMesh_Update()). The meshes are
+//      divided over the threads of the pool.
+//   2. per view: the view and projection transform, culling, clipping and sorting of all world meshes (see
+//      camera::CullViewAndProjectWorldMesh()), into the raster list of the view. The cameras only read the world
+//      meshes, so the views are done in parallel.
+//   3. per view, in the order in which they were added: the viewport is cleared and the triangles are rasterized, with
+//      the tiles divided over the pool. A view that overlaps an earlier one (picture in picture) is drawn on top of it.
+class multiViewRenderer {
+public:
+    // Adds a view for camera pCamera, which must stay alive as long as the renderer. Returns the index of the view.
+    int AddView( camera *pCamera );
+    int ViewCount();
+    // returns the triangles that were drawn into view nView in the last frame
+    rasterList &GetRasterList( int nView );
+
+    // Renders all meshes of graph, with the world matrices of their nodes, into all views. The viewports are cleared
+    // first (see camera::ClearCameraViewPort()). For the drawing parameters see tileRasterizer::DrawTriangles(). If
+    // pPool is nullptr, all work is done on the calling thread.
+    void Render( sceneGraph &graph, bool bOutline, uint32_t nOutlineColour, bool bDepthTest,
+                 int nTextureFilter = TEXTURE_FILTER_NONE, threadPool *pPool = nullptr );
+
+private:
+    struct view {
+        camera        *pCamera = nullptr;
+        rasterList     trisToRaster;
+        tileRasterizer rasterizer;
+    };
+    std::vector<view> vecViews;
+
+    // the scene graph nodes that have a mesh, and their meshes in world space - kept to prevent reallocation
+    std::vector<int>       vecMeshNodes;
+    std::vector<worldMesh> vecWorldMeshes;
+};
+
+#endif // MULTI_VIEW_H
@@ -0,0 +1,406 @@
+#include  "obj_loader.h"
+
+#include   <algorithm>
+#include     <cstdint>
+#include     <cstring>
+#include  <filesystem>
+
+#include "mapped_file.h"
+#include  "mesh_cache.h"
+
+// ==============================/   Parsing primitives    /==============================
+
+// All parse functions work on a line [p, pEnd) that is not null terminated, and return the position after the
+// parsed item, or nullptr if there is no valid item.
+
+static inline bool Obj_IsSpace( char c ) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool Obj_IsDigit( char c ) { return (unsigned char)(c - '0') < 10; }
+
+static inline const char *Obj_SkipSpaces( const char *p, const char *pEnd ) {
+    while (p < pEnd && Obj_IsSpace( *p ))
+        p++;
+    return p;
+}
+
+static inline const char *Obj_SkipToken( const char *p, const char *pEnd ) {
+    while (p < pEnd && !Obj_IsSpace( *p ))
+        p++;
+    return p;
+}
+
+// Parses a decimal floating point number. Unlike strtod() and the stream operators this doesn't depend on the locale,
+// and it's a lot faster. The significant digits are collected in an integer, and scaled by a power of 10 at the end.
+static const char *Obj_ParseFloat( const char *p, const char *pEnd, float &fValue ) {
+    static const double fPow10[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    p = Obj_SkipSpaces( p, pEnd );
+    bool bNegative = false;
+    if (p < pEnd && (*p == '-' || *p == '+')) {
+        bNegative = (*p == '-');
+        p++;
+    }
+
+    uint64_t nMantissa = 0;
+    int      nExponent = 0;
+    bool     bDigits   = false;
+    for (; p < pEnd && Obj_IsDigit( *p ); p++) {
+        if (nMantissa < 100000000000000000ull)
+            nMantissa = 10 * nMantissa + (uint64_t)(*p - '0');
+        else
+            nExponent++;
+        bDigits = true;
+    }
+    if (p < pEnd && *p == '.') {
+        for (p++; p < pEnd && Obj_IsDigit( *p ); p++) {
+            if (nMantissa < 100000000000000000ull) {
+                nMantissa = 10 * nMantissa + (uint64_t)(*p - '0');
+                nExponent--;
+            }
+            bDigits = true;
+        }
+    }
+    if (!bDigits)
+        return nullptr;
+
+    if (p < pEnd && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool bNegExp = false;
+        if (q < pEnd && (*q == '-' || *q == '+')) {
+            bNegExp = (*q == '-');
+            q++;
+        }
+        if (q < pEnd && Obj_IsDigit( *q )) {
+            int nExp = 0;
+            for (; q < pEnd && Obj_IsDigit( *q ); q++)
+                nExp = std::min( 10 * nExp + (*q - '0'), 1000 );
+            nExponent += bNegExp ? -nExp : nExp;
+            p = q;
+        }
+    }
+
+    double fResult = (double)nMantissa;
+    if (nMantissa != 0) {
+        // larger exponents than 22 are applied in steps - they are out of float range anyway, except for
+        // numbers with many digits
+        while (nExponent > 22) { fResult *= 1e22; nExponent -= 22; }
+        while (nExponent < -22) { fResult /= 1e22; nExponent += 22; }
+        fResult = (nExponent >= 0) ? fResult * fPow10[nExponent] : fResult / fPow10[-nExponent];
+    }
+    fValue = (float)(bNegative ? -fResult : fResult);
+    return p;
+}
+
+// Parses a (possibly negative) integer. Leading spaces are not skipped.
+static const char *Obj_ParseInt( const char *p, const char *pEnd, int &nValue ) {
+    bool bNegative = false;
+    if (p < pEnd && (*p == '-' || *p == '+')) {
+        bNegative = (*p == '-');
+        p++;
+    }
+    if (p >= pEnd || !Obj_IsDigit( *p ))
+        return nullptr;
+    int64_t nResult = 0;
+    for (; p < pEnd && Obj_IsDigit( *p ); p++)
+        nResult = std::min<int64_t>( 10 * nResult + (*p - '0'), INT32_MAX );
+    nValue = (int)(bNegative ? -nResult : nResult);
+    return p;
+}
+
+// the record types of the lines
+#define OBJ_OTHER     0
+#define OBJ_VERTEX    1
+#define OBJ_TEXCOORD  2
+#define OBJ_NORMAL    3
+#define OBJ_FACE      4
+
+// Determines the type of the record in line [p, pEnd), and returns the position after the keyword in pData
+static inline int Obj_RecordType( const char *p, const char *pEnd, const char *&pData ) {
+    p = Obj_SkipSpaces( p, pEnd );
+    int nType = OBJ_OTHER;
+    if (p + 1 < pEnd && Obj_IsSpace( p[1] )) {
+        if      (p[0] == 'v') nType = OBJ_VERTEX;
+        else if (p[0] == 'f') nType = OBJ_FACE;
+        pData = p + 1;
+    } else if (p + 2 < pEnd && p[0] == 'v' && Obj_IsSpace( p[2] )) {
+        if      (p[1] == 't') nType = OBJ_TEXCOORD;
+        else if (p[1] == 'n') nType = OBJ_NORMAL;
+        pData = p + 2;
+    }
+    return nType;
+}
+
+// ==============================/   Chunked parsing    /==============================
+
+// A range of complete lines of the file, that is parsed by one task
+struct objChunk {
+    const char *pBegin, *pEnd;
+
+    // the number of records in this chunk (pass 1), and the totals of all preceding chunks (prefix sums)
+    int64_t nVerts = 0, nTexs = 0, nNormals = 0, nTris = 0, nLines = 0;
+    int64_t nVertsBefore = 0, nTexsBefore = 0, nNormalsBefore = 0, nTrisBefore = 0, nLinesBefore = 0;
+
+    std::string sError;      // set by pass 2 if the chunk contains an invalid face
+};
+
+// Pass 1: counts the records of the chunk, and the triangles that the faces are split into
+static void Obj_CountChunk( objChunk &chunk ) {
+    const char *p = chunk.pBegin;
+    while (p < chunk.pEnd) {
+        const char *pLineEnd = (const char *)std::memchr( p, '\n', chunk.pEnd - p );
+        if (pLineEnd == nullptr)
+            pLineEnd = chunk.pEnd;
+
+        const char *pData = nullptr;
+        switch (Obj_RecordType( p, pLineEnd, pData )) {
+            case OBJ_VERTEX:   chunk.nVerts   += 1; break;
+            case OBJ_TEXCOORD: chunk.nTexs    += 1; break;
+            case OBJ_NORMAL:   chunk.nNormals += 1; break;
+            case OBJ_FACE: {
+                int nCorners = 0;
+                for (const char *q = Obj_SkipSpaces( pData, pLineEnd ); q < pLineEnd; q = Obj_SkipSpaces( Obj_SkipToken( q, pLineEnd ), pLineEnd ))
+                    nCorners++;
+                chunk.nTris += std::max( 0, nCorners - 2 );
+            } break;
+        }
+        chunk.nLines += 1;
+        p = pLineEnd + 1;
+    }
+}
+
+// Converts OBJ index nIndex (1 based, or negative for relative) into a 0 based index, given that nBefore items are
+// defined before the current line. Returns -1 if the index is invalid.
+static inline int64_t Obj_ResolveIndex( int nIndex, int64_t nBefore, int64_t nTotal ) {
+    int64_t nResult = (nIndex > 0) ? (int64_t)nIndex - 1 : nBefore + nIndex;
+    return (nIndex == 0 || nResult < 0 || nResult >= nTotal) ? -1 : nResult;
+}
+
+// the output of pass 2, sized with the totals of pass 1
+struct objOutput {
+    mesh                 *pMesh;
+    std::vector<vec2d>    vecTexCoords;      // the vt records
+    std::vector<int32_t>  vecTexIndices;     // per triangle corner the index into vecTexCoords, or -1
+    int64_t nTotalVerts = 0, nTotalTexs = 0, nTotalNormals = 0;
+};
+
+// Pass 2: parses the records of the chunk, and writes them at the offsets that follow from pass 1
+static void Obj_ParseChunk( objChunk &chunk, objOutput &out ) {
+    vertexStream &verts = out.pMesh->verts;
+    uint32_t     *pIndices    = out.pMesh->indices.data();
+    int32_t      *pTexIndices = out.vecTexIndices.data();
+    int64_t iVert = chunk.nVertsBefore, iTex = chunk.nTexsBefore, iNormal = chunk.nNormalsBefore, iTri = chunk.nTrisBefore;
+    int64_t nLine = chunk.nLinesBefore;
+
+    auto fnError = [&]( const char *sMessage ) {
+        chunk.sError = "line " + std::to_string( nLine + 1 ) + ": " + sMessage;
+    };
+
+    const char *p = chunk.pBegin;
+    while (p < chunk.pEnd) {
+        const char *pLineEnd = (const char *)std::memchr( p, '\n', chunk.pEnd - p );
+        if (pLineEnd == nullptr)
+            pLineEnd = chunk.pEnd;
+
+        const char *pData = nullptr;
+        switch (Obj_RecordType( p, pLineEnd, pData )) {
+            case OBJ_VERTEX: {
+                float x = 0.0f, y = 0.0f, z = 0.0f;
+                const char *q = Obj_ParseFloat( pData, pLineEnd, x );
+                if (q != nullptr) q = Obj_ParseFloat( q, pLineEnd, y );
+                if (q != nullptr) q = Obj_ParseFloat( q, pLineEnd, z );
+                if (q == nullptr) {
+                    fnError( "invalid vertex" );
+                    return;
+                }
+                verts.x[iVert] = x;
+                verts.y[iVert] = y;
+                verts.z[iVert] = z;
+                verts.w[iVert] = 1.0f;
+                iVert++;
+            } break;
+            case OBJ_TEXCOORD: {
+                vec2d t;
+                const char *q = Obj_ParseFloat( pData, pLineEnd, t.u );
+                if (q == nullptr) {
+                    fnError( "invalid texture coordinate" );
+                    return;
+                }
+                Obj_ParseFloat( q, pLineEnd, t.v );    // v is optional
+                out.vecTexCoords[iTex++] = t;
+            } break;
+            case OBJ_NORMAL:
+                iNormal++;
+                break;
+            case OBJ_FACE: {
+                // The polygon is split into a triangle fan around its first corner: (0, 1, 2), (0, 2, 3), ...
+                int64_t nFirstVert = -1, nFirstTex = -1, nPrevVert = -1, nPrevTex = -1;
+                int nCorners = 0;
+                const char *q = Obj_SkipSpaces( pData, pLineEnd );
+                while (q < pLineEnd) {
+                    int nV = 0, nT = 0, nN = 0;
+                    int64_t nVert = -1, nTex = -1;
+                    q = Obj_ParseInt( q, pLineEnd, nV );
+                    if (q != nullptr)
+                        nVert = Obj_ResolveIndex( nV, iVert, out.nTotalVerts );
+                    if (q != nullptr && q < pLineEnd && *q == '/') {
+                        q++;
+                        if (q < pLineEnd && *q != '/') {
+                            q = Obj_ParseInt( q, pLineEnd, nT );
+                            if (q != nullptr && (nTex = Obj_ResolveIndex( nT, iTex, out.nTotalTexs )) < 0)
+                                q = nullptr;
+                        }
+                        if (q != nullptr && q < pLineEnd && *q == '/') {
+                            q = Obj_ParseInt( q + 1, pLineEnd, nN );
+                            if (q != nullptr && Obj_ResolveIndex( nN, iNormal, out.nTotalNormals ) < 0)
+                                q = nullptr;
+                        }
+                    }
+                    if (q == nullptr || nVert < 0 || (q < pLineEnd && !Obj_IsSpace( *q ))) {
+                        fnError( "invalid face" );
+                        return;
+                    }
+
+                    if (nCorners == 0) {
+                        nFirstVert = nVert;
+                        nFirstTex  = nTex;
+                    } else if (nCorners >= 2) {
+                        uint32_t *pTri = &pIndices[3 * iTri];
+                        pTri[0] = (uint32_t)nFirstVert;
+                        pTri[1] = (uint32_t)nPrevVert;
+                        pTri[2] = (uint32_t)nVert;
+                        if (pTexIndices != nullptr) {
+                            int32_t *pTriTex = &pTexIndices[3 * iTri];
+                            pTriTex[0] = (int32_t)nFirstTex;
+                            pTriTex[1] = (int32_t)nPrevTex;
+                            pTriTex[2] = (int32_t)nTex;
+                        }
+                        iTri++;
+                    }
+                    nPrevVert = nVert;
+                    nPrevTex  = nTex;
+                    nCorners++;
+                    q = Obj_SkipSpaces( q, pLineEnd );
+                }
+            } break;
+        }
+        nLine++;
+        p = pLineEnd + 1;
+    }
+}
+
+// ==============================/   Loader    /==============================
+
+bool Mesh_ParseObj( const char *pData, size_t nSize, mesh &m, threadPool *pPool, std::string *sError ) {
+
+    // split the data into chunks of complete lines, of about 1 MB each
+    const size_t nChunkSize = 1 << 20;
+    std::vector<objChunk> vecChunks;
+    const char *pDataEnd = pData + nSize;
+    for (const char *p = pData; p < pDataEnd; ) {
+        const char *pEnd = p + std::min( nChunkSize, (size_t)(pDataEnd - p) );
+        if (pEnd < pDataEnd) {
+            const char *pNewline = (const char *)std::memchr( pEnd, '\n', pDataEnd - pEnd );
+            pEnd = (pNewline == nullptr) ? pDataEnd : pNewline + 1;
+        }
+        objChunk chunk;
+        chunk.pBegin = p;
+        chunk.pEnd   = pEnd;
+        vecChunks.push_back( chunk );
+        p = pEnd;
+    }
+    int nChunks = (int)vecChunks.size();
+
+    auto fnParallel = [&]( const std::function<void( int )> &fnTask ) {
+        if (pPool != nullptr)
+            pPool->ParallelFor( nChunks, fnTask );
+        else
+            for (int i = 0; i < nChunks; i++)
+                fnTask( i );
+    };
+
+    // pass 1: count the records per chunk, and compute the offsets of each chunk in the output
+    fnParallel( [&]( int i ) { Obj_CountChunk( vecChunks[i] ); } );
+
+    objOutput out;
+    out.pMesh = &m;
+    int64_t nTotalTris = 0, nTotalLines = 0;
+    for (auto &chunk : vecChunks) {
+        chunk.nVertsBefore   = out.nTotalVerts;    out.nTotalVerts   += chunk.nVerts;
+        chunk.nTexsBefore    = out.nTotalTexs;     out.nTotalTexs    += chunk.nTexs;
+        chunk.nNormalsBefore = out.nTotalNormals;  out.nTotalNormals += chunk.nNormals;
+        chunk.nTrisBefore    = nTotalTris;         nTotalTris        += chunk.nTris;
+        chunk.nLinesBefore   = nTotalLines;        nTotalLines       += chunk.nLines;
+    }
+
+    Mesh_ClearView( m );
+    m.indices.clear();
+    m.texs.clear();
+    VertexStream_Resize( m.verts, 0 );
+    if (out.nTotalVerts > INT32_MAX || 3 * nTotalTris > INT32_MAX) {
+        if (sError != nullptr)
+            *sError = "too many vertices or triangles";
+        return false;
+    }
+
+    // pass 2: parse all chunks directly into the output arrays
+    VertexStream_Resize( m.verts, (int)out.nTotalVerts );
+    m.indices.resize( 3 * nTotalTris );
+    out.vecTexCoords.resize( out.nTotalTexs );
+    if (out.nTotalTexs > 0)
+        out.vecTexIndices.resize( 3 * nTotalTris );
+    fnParallel( [&]( int i ) { Obj_ParseChunk( vecChunks[i], out ); } );
+
+    for (auto &chunk : vecChunks) {
+        if (!chunk.sError.empty()) {
+            if (sError != nullptr)
+                *sError = chunk.sError;
+            m.indices.clear();
+            VertexStream_Resize( m.verts, 0 );
+            return false;
+        }
+    }
+
+    // the texture coordinates are stored per triangle corner - this can only be done now, because the vt records
+    // may be defined in another chunk than the faces that use them
+    m.texs.resize( 3 * nTotalTris );
+    if (out.nTotalTexs > 0) {
+        int64_t nCorners = 3 * nTotalTris;
+        int64_t nPerTask = (nCorners + nChunks - 1) / nChunks;
+        fnParallel( [&]( int i ) {
+            int64_t nEnd = std::min( nCorners, (i + 1) * nPerTask );
+            for (int64_t j = i * nPerTask; j < nEnd; j++) {
+                int32_t nTex = out.vecTexIndices[j];
+                if (nTex >= 0)
+                    m.texs[j] = out.vecTexCoords[nTex];
+            }
+        } );
+    }
+
+    Mesh_ComputeBounds( m );
+    return true;
+}
+
+bool Mesh_LoadFromObj( const std::string &sFileName, mesh &m, threadPool *pPool, std::string *sError ) {
+    mappedFile file;
+    if (!file.Open( sFileName )) {
+        if (sError != nullptr)
+            *sError = "can't open " + sFileName;
+        return false;
+    }
+    return Mesh_ParseObj( file.Data(), file.Size(), m, pPool, sError );
+}
+
+bool Mesh_LoadFromObjCached( const std::string &sFileName, mesh &m, threadPool *pPool, std::string *sError ) {
+    std::string sCacheFile = MeshCache_FileName( sFileName );
+
+    std::error_code ecSource, ecCache;
+    auto tSource = std::filesystem::last_write_time( sFileName,  ecSource );
+    auto tCache  = std::filesystem::last_write_time( sCacheFile, ecCache  );
+    if (!ecSource && !ecCache && tCache > tSource && MeshCache_Load( sCacheFile, m ))
+        return true;
+
+    if (!Mesh_LoadFromObj( sFileName, m, pPool, sError ))
+        return false;
+    MeshCache_Save( sCacheFile, m );
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <string>
+
+#include "graphics_3D.h"
+#include "thread_pool.h"
+
+// Loads the Wavefront OBJ file sFileName into mesh m. The file is memory mapped and parsed in place, without creating
+// strings per line. Large files are split into chunks of lines that are parsed in parallel if a pool is passed.
+//
+// The following records are used:
+//     v  x y z [w]           vertex position (w and any vertex colours are ignored)
+//     vt u [v [w]]           texture coordinate
+//     vn x y z               vertex normal - only counted, the mesh has no vertex normals (the pipeline uses face normals)
+//     f  v[/vt][/vn] ...     face - polygons are split into a triangle fan, the vertex order is kept
+// Indices can be positive (1 based) or negative (relative to the end of the list so far). All other records (comments,
+// groups, materials, ...) are skipped. Faces without texture coordinates get the default vec2d values.
+//
+// The vertices are stored once in m.verts, and the bounding volumes are computed. The appearance info of m is not
+// changed. Returns false if the file can't be read or contains an invalid face; then sError (if not nullptr) receives
+// the reason, and m is left empty.
+bool Mesh_LoadFromObj( const std::string &sFileName, mesh &m, threadPool *pPool = nullptr, std::string *sError = nullptr );
+
+// Like Mesh_LoadFromObj(), but uses a binary cache file next to sFileName (see mesh_cache.h). If the cache file is newer
+// than sFileName, mesh m becomes a view on the mapped cache file, and the OBJ file isn't read at all. Otherwise the OBJ
+// file is loaded and the cache file is (re)written - if that fails (e.g. in a read only directory) m is still loaded.
+bool Mesh_LoadFromObjCached( const std::string &sFileName, mesh &m, threadPool *pPool = nullptr, std::string *sError = nullptr );
+
+// Parses the OBJ data in the memory range [pData, pData + nSize) - see Mesh_LoadFromObj()
+bool Mesh_ParseObj( const char *pData, size_t nSize, mesh &m, threadPool *pPool = nullptr, std::string *sError = nullptr );
+
+#endif // OBJ_LOADER_H
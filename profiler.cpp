@@ -0,0 +1,150 @@
+#include "profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+#include   <atomic>
+#include   <chrono>
+#include   <cstdio>
+#include <cstring>
+#include    <mutex>
+
+std::atomic<long long> glbProfileCounters[PROF_NR_OF_COUNTERS] = {};
+
+// the JSON names of the counters, in the order of profileCounter
+static const char *sCounterNames[PROF_NR_OF_COUNTERS] = { "in", "culled", "clipped", "clip_out", "rasterized" };
+
+// maximum number of trace events that are kept (about 32 MB)
+#define PROF_MAX_EVENTS  (1 << 20)
+
+struct traceEvent {
+    const char *sName;
+    long long   nStartNs, nDurNs;
+    int         nThread;
+};
+
+struct traceCounters {
+    long long nTimeNs;
+    long long nCounters[PROF_NR_OF_COUNTERS];
+};
+
+static std::mutex                 mtxProfiler;     // protects everything below
+static std::vector<traceEvent>    vecEvents;
+static std::vector<traceCounters> vecCounters;
+static profileFrame               curFrame, lastFrame;
+static bool                       bInFrame      = false;
+static long long                  nFrameStartNs = 0;
+
+static thread_local int tlsDepth = 0;
+
+// nanoseconds since the first use of the profiler
+static long long Profiler_Now() {
+    static const auto tOrigin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - tOrigin ).count();
+}
+
+// a small number per thread, that is used as the thread id in the trace
+static int Profiler_ThreadId() {
+    static std::atomic<int> nNextId{ 0 };
+    static thread_local int nId = nNextId++;
+    return nId;
+}
+
+// adds a trace event - mtxProfiler must be locked
+static void Profiler_AddEvent( const char *sName, long long nStartNs, long long nDurNs ) {
+    if (vecEvents.size() < PROF_MAX_EVENTS)
+        vecEvents.push_back( { sName, nStartNs, nDurNs, Profiler_ThreadId() } );
+}
+
+profileScope::profileScope( const char *sName ) {
+    sScopeName = sName;
+    nDepth     = tlsDepth++;
+    nStartNs   = Profiler_Now();
+}
+
+profileScope::~profileScope() {
+    long long nDurNs = Profiler_Now() - nStartNs;
+    tlsDepth--;
+
+    std::lock_guard<std::mutex> lock( mtxProfiler );
+    Profiler_AddEvent( sScopeName, nStartNs, nDurNs );
+    if (!bInFrame)
+        return;
+
+    // accumulate into the stage with the same name and nesting level (there are only a few per frame)
+    profileStage *pStage = nullptr;
+    for (auto &stage : curFrame.vecStages) {
+        if (stage.nDepth == nDepth && (stage.sName == sScopeName || std::strcmp( stage.sName, sScopeName ) == 0)) {
+            pStage = &stage;
+            break;
+        }
+    }
+    if (pStage == nullptr) {
+        curFrame.vecStages.emplace_back();
+        pStage = &curFrame.vecStages.back();
+        pStage->sName  = sScopeName;
+        pStage->nDepth = nDepth;
+    }
+    pStage->nCalls += 1;
+    pStage->fMs    += (double)nDurNs / 1e6;
+}
+
+void Profiler_BeginFrame() {
+    std::lock_guard<std::mutex> lock( mtxProfiler );
+    curFrame.nFrame += 1;
+    curFrame.vecStages.clear();
+    for (int i = 0; i < PROF_NR_OF_COUNTERS; i++)
+        glbProfileCounters[i] = 0;
+    bInFrame      = true;
+    nFrameStartNs = Profiler_Now();
+}
+
+void Profiler_EndFrame() {
+    long long nNowNs = Profiler_Now();
+
+    std::lock_guard<std::mutex> lock( mtxProfiler );
+    if (!bInFrame)
+        return;
+    bInFrame = false;
+
+    curFrame.fFrameMs = (double)(nNowNs - nFrameStartNs) / 1e6;
+    traceCounters counters;
+    counters.nTimeNs = nFrameStartNs;
+    for (int i = 0; i < PROF_NR_OF_COUNTERS; i++) {
+        curFrame.nCounters[i] = glbProfileCounters[i];
+        counters.nCounters[i] = glbProfileCounters[i];
+    }
+    Profiler_AddEvent( "frame", nFrameStartNs, nNowNs - nFrameStartNs );
+    if (vecCounters.size() < PROF_MAX_EVENTS)
+        vecCounters.push_back( counters );
+
+    lastFrame = curFrame;
+}
+
+const profileFrame &Profiler_LastFrame() {
+    return lastFrame;
+}
+
+bool Profiler_SaveTrace( const std::string &sFileName ) {
+    FILE *pFile = std::fopen( sFileName.c_str(), "w" );
+    if (pFile == nullptr)
+        return false;
+
+    std::lock_guard<std::mutex> lock( mtxProfiler );
+    // timestamps and durations are in microseconds
+    std::fprintf( pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+    std::fprintf( pFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"MatrixTransformDemo\"}}" );
+    for (auto &e : vecEvents) {
+        std::fprintf( pFile, ",\n{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                      e.sName, (double)e.nStartNs / 1e3, (double)e.nDurNs / 1e3, e.nThread );
+    }
+    for (auto &c : vecCounters) {
+        std::fprintf( pFile, ",\n{\"name\":\"triangles\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{", (double)c.nTimeNs / 1e3 );
+        for (int i = 0; i < PROF_NR_OF_COUNTERS; i++)
+            std::fprintf( pFile, "%s\"%s\":%lld", (i == 0) ? "" : ",", sCounterNames[i], c.nCounters[i] );
+        std::fprintf( pFile, "}}" );
+    }
+    std::fprintf( pFile, "\n]}\n" );
+    return std::fclose( pFile ) == 0;
+}
+
+#endif // PROFILER_ENABLED
@@ -0,0 +1,93 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// A frame profiler for the rendering pipeline. The stages of the pipeline are timed with PROFILE_SCOPE(), and the
+// work per stage is counted with PROFILE_COUNT(). Per frame the timings and counters are collected, so they can be
+// shown on screen (see demoScene), and all scopes are recorded as trace events that can be saved in the Chrome
+// trace event format (open the file in chrome://tracing or https://ui.perfetto.dev).
+//
+// The profiler is only compiled in if PROFILER_ENABLED is defined (CMake option PROFILER_ENABLED). Otherwise all the
+// macros below expand to nothing, so there is no overhead at all.
+//
+// Both the scopes and the counters may be used from worker threads as well. The counters are atomic, so count in bulk
+// where that is easy (per mesh rather than per triangle).
+
+// the counters per frame
+enum profileCounter {
+    PROF_TRIS_IN = 0,         // triangles that enter the pipeline
+    PROF_TRIS_CULLED,         // triangles that are rejected (outside the frustum or back facing)
+    PROF_TRIS_CLIPPED,        // triangles that need clipping ...
+    PROF_TRIS_CLIP_OUT,       // ... and the number of triangles they are clipped into
+    PROF_TRIS_RASTERIZED,     // triangles that are drawn
+
+    PROF_NR_OF_COUNTERS
+};
+
+// the accumulated time of one scope (name) in a frame
+struct profileStage {
+    const char *sName  = nullptr;
+    int         nDepth = 0;        // nesting level of the scope, 0 is outermost
+    int         nCalls = 0;
+    double      fMs    = 0.0;
+};
+
+// the results of one frame
+struct profileFrame {
+    int       nFrame = 0;
+    double    fFrameMs = 0.0;
+    std::vector<profileStage> vecStages;   // in order of first use in the frame
+    long long nCounters[PROF_NR_OF_COUNTERS] = { 0 };
+};
+
+#ifdef PROFILER_ENABLED
+
+extern std::atomic<long long> glbProfileCounters[PROF_NR_OF_COUNTERS];
+
+// Times the block it is created in. sName must be a string literal (or live as long as the profiler).
+class profileScope {
+public:
+    explicit profileScope( const char *sName );
+    ~profileScope();
+
+    profileScope( const profileScope & ) = delete;
+    profileScope &operator = ( const profileScope & ) = delete;
+
+private:
+    const char *sScopeName;
+    long long   nStartNs;
+    int         nDepth;
+};
+
+// Starts resp. finishes a frame. Profiler_EndFrame() makes the results available via Profiler_LastFrame().
+void Profiler_BeginFrame();
+void Profiler_EndFrame();
+
+// returns the results of the last finished frame
+const profileFrame &Profiler_LastFrame();
+
+// Saves all recorded scopes and counters as a Chrome trace event JSON file. Returns false if the file can't be written.
+// The number of recorded events is limited, once the limit is reached new events are dropped.
+bool Profiler_SaveTrace( const std::string &sFileName );
+
+#define PROFILE_CONCAT_( a, b ) a##b
+#define PROFILE_CONCAT(  a, b ) PROFILE_CONCAT_( a, b )
+
+#define PROFILE_SCOPE( name )          profileScope PROFILE_CONCAT( profScope, __LINE__ )( name )
+#define PROFILE_COUNT( counter, n )    (glbProfileCounters[counter] += (n))
+#define PROFILE_BEGIN_FRAME()          Profiler_BeginFrame()
+#define PROFILE_END_FRAME()            Profiler_EndFrame()
+
+#else
+
+#define PROFILE_SCOPE( name )
+#define PROFILE_COUNT( counter, n )    ((void)0)
+#define PROFILE_BEGIN_FRAME()          ((void)0)
+#define PROFILE_END_FRAME()            ((void)0)
+
+#endif // PROFILER_ENABLED
+
+#endif // PROFILER_H
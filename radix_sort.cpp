@@ -0,0 +1,78 @@
+#include "radix_sort.h"
+
+#include <algorithm>
+
+void RadixSort( std::vector<uint64_t> &vecKeys, std::vector<uint64_t> &vecTemp, int nFirstByte, threadPool *pPool ) {
+    size_t nCount = vecKeys.size();
+    if (nCount < 2)
+        return;
+    vecTemp.resize( nCount );
+
+    int nChunks = 1;
+    if (pPool != nullptr && pPool->ThreadCount() > 1)
+        nChunks = (int)std::min( (size_t)RADIX_SORT_MAX_CHUNKS, std::max( nCount / RADIX_SORT_CHUNK_SIZE, (size_t)1 ));
+
+    // nCounts[c][b] is the number of keys in chunk c with byte value b, and after the prefix sum the position in the
+    // output of the first of them. The keys of chunk c go after those of chunks 0 .. c - 1 with the same byte value,
+    // so the chunks together are stable as well.
+    uint32_t nCounts[RADIX_SORT_MAX_CHUNKS][256];
+
+    // the lambdas only capture one pointer, which std::function can store without allocating on the heap
+    struct {
+        uint64_t *pSrc, *pDst;
+        size_t nCount, nChunkSize;
+        int nShift;
+        uint32_t (*pCounts)[256];
+    } job = { vecKeys.data(), vecTemp.data(), nCount, (nCount + nChunks - 1) / nChunks, 0, nCounts };
+
+    auto fnCount = [&job]( int c ) {
+        uint32_t *pCount = job.pCounts[c];
+        std::fill( pCount, pCount + 256, 0 );
+        size_t nEnd = std::min( (size_t)(c + 1) * job.nChunkSize, job.nCount );
+        for (size_t i = (size_t)c * job.nChunkSize; i < nEnd; i++)
+            pCount[(job.pSrc[i] >> job.nShift) & 0xFF]++;
+    };
+    auto fnScatter = [&job]( int c ) {
+        uint32_t *pPos = job.pCounts[c];
+        size_t nEnd = std::min( (size_t)(c + 1) * job.nChunkSize, job.nCount );
+        for (size_t i = (size_t)c * job.nChunkSize; i < nEnd; i++) {
+            uint64_t nKey = job.pSrc[i];
+            job.pDst[pPos[(nKey >> job.nShift) & 0xFF]++] = nKey;
+        }
+    };
+
+    for (int nByte = nFirstByte; nByte < 8; nByte++) {
+        job.nShift = 8 * nByte;
+        if (nChunks > 1)
+            pPool->ParallelFor( nChunks, fnCount );
+        else
+            fnCount( 0 );
+
+        // skip the pass if all keys have the same byte value here
+        int nFirstValue = (int)((job.pSrc[0] >> job.nShift) & 0xFF);
+        uint32_t nSame = 0;
+        for (int c = 0; c < nChunks; c++)
+            nSame += nCounts[c][nFirstValue];
+        if (nSame == nCount)
+            continue;
+
+        uint32_t nPos = 0;
+        for (int b = 0; b < 256; b++) {
+            for (int c = 0; c < nChunks; c++) {
+                uint32_t n = nCounts[c][b];
+                nCounts[c][b] = nPos;
+                nPos += n;
+            }
+        }
+
+        if (nChunks > 1)
+            pPool->ParallelFor( nChunks, fnScatter );
+        else
+            fnScatter( 0 );
+        std::swap( job.pSrc, job.pDst );
+    }
+
+    // after an odd number of passes the result is in the scratch buffer
+    if (job.pSrc != vecKeys.data())
+        vecKeys.swap( vecTemp );
+}
@@ -0,0 +1,35 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstdint>
+#include <cstring>
+#include  <vector>
+
+#include "thread_pool.h"
+
+// Least significant digit radix sort of 64 bit keys, one byte per pass. Every pass counts how often each byte value
+// occurs, and then moves the keys to the position that follows from these counts. This is stable, so after the pass
+// over the most significant byte the keys are sorted. That is a fixed amount of work per key, instead of the
+// n log n comparisons of std::sort(), and the moves are sequential writes into 256 streams.
+//
+// Passes in which all keys have the same byte (which is common for the high bytes of small numbers) are skipped.
+
+#define RADIX_SORT_MAX_CHUNKS      64       // the most chunks the keys are split into for a parallel sort
+#define RADIX_SORT_CHUNK_SIZE   65536       // the least number of keys per chunk
+
+// Sorts the keys in vecKeys ascending. Only bytes nFirstByte up to 7 (0 is the least significant) are considered, so
+// the keys must either be equal in the lower bytes, or already be in the wanted order for equal higher bytes.
+// vecTemp is used as scratch buffer, and is resized as needed (keep it around to prevent reallocation).
+// If pPool isn't nullptr and there are enough keys, each pass is done in chunks by the threads of the pool.
+void RadixSort( std::vector<uint64_t> &vecKeys, std::vector<uint64_t> &vecTemp, int nFirstByte = 0,
+                threadPool *pPool = nullptr );
+
+// Maps float f to an unsigned integer with the same order: if a < b then RadixSort_FloatKey( a ) < RadixSort_FloatKey( b ).
+// For positive floats the sign bit is set, for negative ones all bits are flipped (so larger magnitudes come first).
+inline uint32_t RadixSort_FloatKey( float f ) {
+    uint32_t n;
+    std::memcpy( &n, &f, sizeof( n ));
+    return (n & 0x80000000u) ? ~n : (n | 0x80000000u);
+}
+
+#endif // RADIX_SORT_H
@@ -0,0 +1,253 @@
+#include "rasterizer.h"
+
+#include <cmath>
+
+// Multiplies the channels of colours a and b (as if they were in [0, 1])
+static inline uint32_t ModulateColour( uint32_t a, uint32_t b ) {
+    return Colour_Pack( Colour_R( a ) * Colour_R( b ) / 255, Colour_G( a ) * Colour_G( b ) / 255, Colour_B( a ) * Colour_B( b ) / 255 );
+}
+
+// Sets the buffers to render into. The clip rectangle is clamped to the buffer dimensions.
+void tileRasterizer::SetTarget( rasterTarget &newTarget ) {
+    target = newTarget;
+    target.nClipX1 = std::max( target.nClipX1, 0 );
+    target.nClipY1 = std::max( target.nClipY1, 0 );
+    target.nClipX2 = std::min( target.nClipX2, target.nWidth  );
+    target.nClipY2 = std::min( target.nClipY2, target.nHeight );
+
+    // the tile grid covers the whole buffer, so that the tiles are the same regardless of the clip rectangle
+    nTilesX = (target.nWidth  + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    nTilesY = (target.nHeight + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    vecBinCount.assign( nTilesX * nTilesY, 0 );
+    vecBinStart.resize( nTilesX * nTilesY );
+    vecBinFill.resize( nTilesX * nTilesY );
+    // every tile can be active at most once, so this is the most vecActiveTiles can ever hold
+    vecActiveTiles.clear();
+    vecActiveTiles.reserve( nTilesX * nTilesY );
+    // a start for the bins: room for every tile to be overlapped by RASTER_BIN_RESERVE triangles (see DrawTriangles())
+    vecBinItems.reserve( (size_t)nTilesX * nTilesY * RASTER_BIN_RESERVE );
+}
+
+// Bins all triangles to the tiles they overlap, and then rasterizes the tiles (in parallel if a pool is passed)
+void tileRasterizer::DrawTriangles( rasterList &l, bool bOutline, uint32_t nOutlineColour, bool bDepthTest, threadPool *pPool,
+                                    int nTextureFilter ) {
+
+    // the bins of the previous call are emptied here, instead of after drawing
+    for (int nTile : vecActiveTiles)
+        vecBinCount[nTile] = 0;
+    vecActiveTiles.clear();
+    vecSetup.clear();
+    // room for as many triangles as the raster list has room for, so this only grows when the list itself has grown
+    vecSetup.reserve( l.vecTris.capacity() );
+
+    if (target.nClipX1 >= target.nClipX2 || target.nClipY1 >= target.nClipY2)
+        return;
+
+    // ====================/  Triangle setup and binning  /====================
+
+    for (auto &tri : l.vecTris) {
+        triSetup s;
+        for (int i = 0; i < 3; i++) {
+            const rasterVertex &v = l.vecVerts[tri.v[i]];
+            s.x[i]  = v.x;
+            s.y[i]  = v.y;
+            s.iw[i] = v.iw;
+            s.uw[i] = v.u;
+            s.vw[i] = v.v;
+        }
+        // twice the signed area - degenerate triangles don't cover any pixels
+        float fArea = (s.x[1] - s.x[0]) * (s.y[2] - s.y[0]) - (s.y[1] - s.y[0]) * (s.x[2] - s.x[0]);
+        if (fArea == 0.0f || std::isnan( fArea ))
+            continue;
+        // make the winding consistent, so that the inside of the triangle has positive edge function values
+        if (fArea < 0.0f) {
+            std::swap( s.x[1], s.x[2] );
+            std::swap( s.y[1], s.y[2] );
+            std::swap( s.iw[1], s.iw[2] );
+            std::swap( s.uw[1], s.uw[2] );
+            std::swap( s.vw[1], s.vw[2] );
+            fArea = -fArea;
+        }
+        s.fInvArea = 1.0f / fArea;
+        for (int i = 0; i < 3; i++) {
+            int a = (i + 1) % 3, b = (i + 2) % 3;
+            float dx = s.x[b] - s.x[a], dy = s.y[b] - s.y[a];
+            s.fInvLen[i] = 1.0f / std::sqrt( dx * dx + dy * dy );
+        }
+        // the appearance comes from the material table
+        s.nColour  = RasterTriangle_Colour( tri );
+        s.pTexture = (nTextureFilter != TEXTURE_FILTER_NONE) ? Material_Get( tri.nMaterial ).pTexture : nullptr;
+        if (s.pTexture != nullptr) {
+            // u/w, v/w and 1/w are linear in screen space, so their gradients are constant over the triangle. They
+            // follow from the coefficients of the edge functions (see RasterizeTile()).
+            s.fDUdx = s.fDUdy = s.fDVdx = s.fDVdy = s.fDWdx = s.fDWdy = 0.0f;
+            for (int i = 0; i < 3; i++) {
+                int a = (i + 1) % 3, b = (i + 2) % 3;
+                float fA = (s.y[a] - s.y[b]) * s.fInvArea, fB = (s.x[b] - s.x[a]) * s.fInvArea;
+                s.fDUdx += fA * s.uw[i];  s.fDUdy += fB * s.uw[i];
+                s.fDVdx += fA * s.vw[i];  s.fDVdy += fB * s.vw[i];
+                s.fDWdx += fA * s.iw[i];  s.fDWdy += fB * s.iw[i];
+            }
+        }
+
+        // bounding box of the triangle, clipped against the clip rectangle
+        int nMinX = std::max( target.nClipX1,     (int)std::floor( std::min( { s.x[0], s.x[1], s.x[2] } )));
+        int nMinY = std::max( target.nClipY1,     (int)std::floor( std::min( { s.y[0], s.y[1], s.y[2] } )));
+        int nMaxX = std::min( target.nClipX2 - 1, (int)std::ceil(  std::max( { s.x[0], s.x[1], s.x[2] } )));
+        int nMaxY = std::min( target.nClipY2 - 1, (int)std::ceil(  std::max( { s.y[0], s.y[1], s.y[2] } )));
+        if (nMinX > nMaxX || nMinY > nMaxY)
+            continue;
+
+        // count the triangle in the bins of all tiles it overlaps
+        s.nTileX1 = nMinX / RASTER_TILE_SIZE;
+        s.nTileY1 = nMinY / RASTER_TILE_SIZE;
+        s.nTileX2 = nMaxX / RASTER_TILE_SIZE;
+        s.nTileY2 = nMaxY / RASTER_TILE_SIZE;
+        vecSetup.push_back( s );
+        for (int ty = s.nTileY1; ty <= s.nTileY2; ty++) {
+            for (int tx = s.nTileX1; tx <= s.nTileX2; tx++) {
+                int nTile = ty * nTilesX + tx;
+                if (vecBinCount[nTile]++ == 0)
+                    vecActiveTiles.push_back( nTile );
+            }
+        }
+    }
+
+    // reserve room for each bin, and fill the bins in triangle order
+    int nItems = 0;
+    for (int nTile : vecActiveTiles) {
+        vecBinStart[nTile] = vecBinFill[nTile] = nItems;
+        nItems += vecBinCount[nTile];
+    }
+    // The number of bin items has no upper bound, so their buffer grows to the high-water mark instead - at least
+    // doubling each time, so that a scene which slowly covers more tiles causes only a few reallocations.
+    if ((size_t)nItems > vecBinItems.capacity())
+        vecBinItems.reserve( std::max( (size_t)nItems, 2 * vecBinItems.capacity() ));
+    vecBinItems.resize( nItems );
+    for (int nIndex = 0; nIndex < (int)vecSetup.size(); nIndex++) {
+        triSetup &s = vecSetup[nIndex];
+        for (int ty = s.nTileY1; ty <= s.nTileY2; ty++)
+            for (int tx = s.nTileX1; tx <= s.nTileX2; tx++)
+                vecBinItems[ vecBinFill[ty * nTilesX + tx]++ ] = nIndex;
+    }
+
+    // ====================/  Rasterize the tiles  /====================
+
+    // without a depth buffer there's nothing to test against
+    bDepthTest &= (target.pDepth != nullptr);
+
+    // the lambda only captures two pointers, which std::function can store without allocating on the heap
+    struct { bool bOutline; uint32_t nOutlineColour; bool bDepthTest; int nTextureFilter; } params = { bOutline, nOutlineColour, bDepthTest, nTextureFilter };
+    auto fnTile = [this, &params]( int i ) {
+        RasterizeTile( vecActiveTiles[i], params.bOutline, params.nOutlineColour, params.bDepthTest, params.nTextureFilter );
+    };
+    if (pPool != nullptr)
+        pPool->ParallelFor( (int)vecActiveTiles.size(), fnTile );
+    else
+        for (int i = 0; i < (int)vecActiveTiles.size(); i++)
+            fnTile( i );
+}
+
+// Rasterizes all triangles in the bin of tile nTile, in the order they were binned.
+// The pixels are sampled at their centres. The edge functions are evaluated incrementally along each row.
+// Textured triangles are sampled perspective correct: u/w, v/w and 1/w are interpolated linearly in screen space, and
+// dividing by the interpolated 1/w gives u and v. The mip level is selected once per span (the pixels of a triangle on
+// one row of the tile), from the derivatives of u and v at its first pixel.
+void tileRasterizer::RasterizeTile( int nTile, bool bOutline, uint32_t nOutlineColour, bool bDepthTest, int nTextureFilter ) {
+    int nTileX1 = (nTile % nTilesX) * RASTER_TILE_SIZE;
+    int nTileY1 = (nTile / nTilesX) * RASTER_TILE_SIZE;
+    int nTileX2 = std::min( nTileX1 + RASTER_TILE_SIZE, target.nClipX2 );
+    int nTileY2 = std::min( nTileY1 + RASTER_TILE_SIZE, target.nClipY2 );
+    nTileX1 = std::max( nTileX1, target.nClipX1 );
+    nTileY1 = std::max( nTileY1, target.nClipY1 );
+
+    for (int i = vecBinStart[nTile]; i < vecBinStart[nTile] + vecBinCount[nTile]; i++) {
+        triSetup &s = vecSetup[ vecBinItems[i] ];
+
+        // the part of the tile that is covered by the bounding box of the triangle
+        int nMinX = std::max( nTileX1,     (int)std::floor( std::min( { s.x[0], s.x[1], s.x[2] } )));
+        int nMinY = std::max( nTileY1,     (int)std::floor( std::min( { s.y[0], s.y[1], s.y[2] } )));
+        int nMaxX = std::min( nTileX2 - 1, (int)std::ceil(  std::max( { s.x[0], s.x[1], s.x[2] } )));
+        int nMaxY = std::min( nTileY2 - 1, (int)std::ceil(  std::max( { s.y[0], s.y[1], s.y[2] } )));
+
+        // Edge function i belongs to the edge opposite of vertex i: E(p) = A * p.x + B * p.y + C
+        // Its value divided by twice the area is the barycentric weight of vertex i. Pixels exactly on an edge are
+        // only drawn for top and left edges, so that pixels on shared edges are drawn exactly once.
+        float A[3], B[3], C[3];
+        bool  bTopLeft[3];
+        for (int i = 0; i < 3; i++) {
+            int a = (i + 1) % 3, b = (i + 2) % 3;
+            float dx = s.x[b] - s.x[a], dy = s.y[b] - s.y[a];
+            A[i] = -dy;
+            B[i] =  dx;
+            C[i] = -(A[i] * s.x[a] + B[i] * s.y[a]);
+            bTopLeft[i] = (dy < 0.0f || (dy == 0.0f && dx > 0.0f));
+        }
+
+        for (int y = nMinY; y <= nMaxY; y++) {
+            float py = (float)y + 0.5f;
+            float px = (float)nMinX + 0.5f;
+            float w[3];
+            for (int i = 0; i < 3; i++)
+                w[i] = A[i] * px + B[i] * py + C[i];
+
+            uint32_t *pPixel = target.pPixels + y * target.nWidth + nMinX;
+            float    *pDepth = target.pDepth == nullptr ? nullptr : target.pDepth + y * target.nWidth + nMinX;
+
+            int          nLevel = -1;    // the mip level of this span, selected at its first pixel
+            textureLevel level;
+
+            for (int x = nMinX; x <= nMaxX; x++) {
+                bool bInside = (w[0] > 0.0f || (w[0] == 0.0f && bTopLeft[0])) &&
+                               (w[1] > 0.0f || (w[1] == 0.0f && bTopLeft[1])) &&
+                               (w[2] > 0.0f || (w[2] == 0.0f && bTopLeft[2]));
+                // 1/w of this pixel - larger values are closer to the camera
+                float fInvW = 0.0f;
+                if (bInside) {
+                    fInvW   = (w[0] * s.iw[0] + w[1] * s.iw[1] + w[2] * s.iw[2]) * s.fInvArea;
+                    bInside = !bDepthTest || fInvW > *pDepth;
+                }
+                if (bInside) {
+                    uint32_t nColour = s.nColour;
+                    if (s.pTexture != nullptr) {
+                        // w of this pixel, from the 1/w of the depth test - the interpolated u/w and v/w still need
+                        // the 1/area factor of the edge functions
+                        float fW = 1.0f / fInvW;
+                        float fU = (w[0] * s.uw[0] + w[1] * s.uw[1] + w[2] * s.uw[2]) * s.fInvArea * fW;
+                        float fV = (w[0] * s.vw[0] + w[1] * s.vw[1] + w[2] * s.vw[2]) * s.fInvArea * fW;
+                        if (nLevel < 0) {
+                            // d(u/w / 1/w)/dx = (d(u/w)/dx - u * d(1/w)/dx) / (1/w), and likewise for v and y - in texels
+                            float fDudx = (s.fDUdx - fU * s.fDWdx) * fW * (float)s.pTexture->nWidth;
+                            float fDvdx = (s.fDVdx - fV * s.fDWdx) * fW * (float)s.pTexture->nHeight;
+                            float fDudy = (s.fDUdy - fU * s.fDWdy) * fW * (float)s.pTexture->nWidth;
+                            float fDvdy = (s.fDVdy - fV * s.fDWdy) * fW * (float)s.pTexture->nHeight;
+                            // the level where one pixel step is about one texel step: log2 of the longest step
+                            float fRho2 = std::max( fDudx * fDudx + fDvdx * fDvdx, fDudy * fDudy + fDvdy * fDvdy );
+                            nLevel = (fRho2 > 1.0f) ? (int)(0.5f * std::log2( fRho2 )) : 0;
+                            nLevel = std::min( nLevel, s.pTexture->nLevels - 1 );
+                            level  = Texture_GetLevel( *s.pTexture, nLevel );
+                        }
+                        uint32_t nTexel = (nTextureFilter == TEXTURE_FILTER_BILINEAR) ? Texture_SampleBilinear( level, fU, fV )
+                                                                                      : Texture_SampleNearest(  level, fU, fV );
+                        nColour = ModulateColour( nTexel, s.nColour );
+                    }
+                    if (bOutline) {
+                        // distance (in pixels) from the pixel centre to the nearest edge
+                        float fDist = std::min( { w[0] * s.fInvLen[0], w[1] * s.fInvLen[1], w[2] * s.fInvLen[2] } );
+                        if (fDist < 1.0f)
+                            nColour = nOutlineColour;
+                    }
+                    *pPixel = nColour;
+                    if (pDepth != nullptr)
+                        *pDepth = fInvW;
+                }
+                pPixel++;
+                if (pDepth != nullptr)
+                    pDepth++;
+                w[0] += A[0];
+                w[1] += A[1];
+                w[2] += A[2];
+            }
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "graphics_3D.h"
+#include     "texture.h"
+#include "thread_pool.h"
+
+// Tile based software rasterizer.
+//
+// The screen space triangles (a raster list, as prepared by camera::RasterizeTriangles()) are binned into square screen tiles,
+// after which the tiles are rasterized in parallel on a thread pool. Each tile is owned by exactly one thread,
+// so no locking is needed on the pixels. Within a tile the triangles are drawn in the order they were passed,
+// so the painter's algorithm ordering of the input is respected.
+
+#define RASTER_TILE_SIZE     64
+#define RASTER_BIN_RESERVE   16    // triangles per tile that the bins have room for after SetTarget()
+
+// The buffers to render into (the pixels in the layout of Colour_Pack()). pDepth may be nullptr, in which case no
+// depth values are written.
+// The clip rectangle (x1, y1 inclusive, x2, y2 exclusive) limits the area that is drawn into.
+struct rasterTarget {
+    uint32_t *pPixels = nullptr;
+    float    *pDepth  = nullptr;
+    int nWidth = 0, nHeight = 0;
+    int nClipX1 = 0, nClipY1 = 0, nClipX2 = 0, nClipY2 = 0;
+};
+
+class tileRasterizer {
+public:
+    // Sets the buffers to render into. The clip rectangle is clamped to the buffer dimensions.
+    void SetTarget( rasterTarget &target );
+
+    // Rasterizes all triangles in l with their (flat) colour: the colour of their material with their shade applied
+    // (see RasterTriangle_Colour()). If bOutline is set, the pixels within one pixel distance of a triangle edge get
+    // nOutlineColour instead, which gives the same effect as drawing the wire frame on top of the triangle, but keeps
+    // the drawing order correct.
+    // For the depth buffer the interpolated 1/w value is used (taken from the iw members of the vertices). Since
+    // 1/w is linear in screen space, it can be interpolated with the barycentric weights directly. If bDepthTest is set,
+    // a pixel is only drawn if its 1/w is larger (i.e. closer to the camera) than the value in the depth buffer, so the
+    // order of the triangles doesn't matter. Otherwise the depth buffer is written without testing.
+    // Triangles with a textured material are textured if nTextureFilter is TEXTURE_FILTER_NEAREST or _BILINEAR, see
+    // RasterizeTile(). The texel colour is multiplied by the (shaded) colour of the material.
+    // If pPool is nullptr, the tiles are rasterized on the calling thread.
+    void DrawTriangles( rasterList &l, bool bOutline, uint32_t nOutlineColour, bool bDepthTest, threadPool *pPool = nullptr,
+                        int nTextureFilter = TEXTURE_FILTER_NONE );
+
+private:
+    // per triangle data that is calculated once during binning, and used by all tiles the triangle overlaps
+    struct triSetup {
+        float x[3], y[3];          // screen coordinates, in clockwise order (for y pointing down)
+        float iw[3];               // 1/w per vertex, for the depth buffer
+        float fInvArea;            // 1 / (2 * area)
+        float fInvLen[3];          // 1 / length of the edge opposite of vertex i, for outline drawing
+        uint32_t nColour;
+        int nTileX1, nTileY1, nTileX2, nTileY2;    // the range of tiles that the triangle overlaps (inclusive)
+
+        // only for textured triangles (pTexture != nullptr)
+        const texture *pTexture;
+        float uw[3], vw[3];        // u/w and v/w per vertex
+        float fDUdx, fDUdy, fDVdx, fDVdy, fDWdx, fDWdy;    // screen space gradients of u/w, v/w and 1/w
+    };
+
+    rasterTarget target;
+    int nTilesX = 0, nTilesY = 0;
+
+    // The bins hold the indices of the triangles that overlap each tile. They are stored one after another in
+    // vecBinItems (bin nTile starts at vecBinStart[nTile] and holds vecBinCount[nTile] items), so that no per tile
+    // vectors have to grow when triangles cover new tiles. All buffers keep their capacity between frames.
+    std::vector<triSetup> vecSetup;
+    std::vector<int>      vecBinCount, vecBinStart, vecBinFill;    // per tile
+    std::vector<int>      vecBinItems;
+    std::vector<int>      vecActiveTiles;    // the tiles that have at least one triangle
+
+    void RasterizeTile( int nTile, bool bOutline, uint32_t nOutlineColour, bool bDepthTest, int nTextureFilter );
+};
+
+#endif // RASTERIZER_H
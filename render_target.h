@@ -0,0 +1,67 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <cstdint>
+
+// The drawing surface for the camera and the demo. The graphics code only draws through this interface, so it doesn't
+// depend on the olcPixelGameEngine. There are two implementations:
+//   * pgeRenderTarget (render_target_pge.h) - draws into the window of a PixelGameEngine
+//   * frameBuffer     (framebuffer.h)       - draws into memory, for headless rendering, testing and benchmarking
+
+// Packs a colour into a 32 bit pixel value. The layout is the same as olc::Pixel (red in the lowest byte), so the
+// pixels of a render target can be used as PGE pixels directly.
+constexpr uint32_t Colour_Pack( int r, int g, int b, int a = 255 ) {
+    return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
+}
+inline int Colour_R( uint32_t nColour ) { return  nColour        & 0xFF; }
+inline int Colour_G( uint32_t nColour ) { return (nColour >>  8) & 0xFF; }
+inline int Colour_B( uint32_t nColour ) { return (nColour >> 16) & 0xFF; }
+
+// some colours, with the same values as their olc::Pixel counterparts
+constexpr uint32_t COL_BLACK    = Colour_Pack(   0,   0,   0 );
+constexpr uint32_t COL_WHITE    = Colour_Pack( 255, 255, 255 );
+constexpr uint32_t COL_GREY     = Colour_Pack( 192, 192, 192 );
+constexpr uint32_t COL_YELLOW   = Colour_Pack( 255, 255,   0 );
+constexpr uint32_t COL_GREEN    = Colour_Pack(   0, 255,   0 );
+constexpr uint32_t COL_DARK_RED = Colour_Pack( 128,   0,   0 );
+
+class renderTarget {
+public:
+    virtual ~renderTarget() {}
+
+    // dimensions of the target in pixels
+    virtual int ScreenWidth()  = 0;
+    virtual int ScreenHeight() = 0;
+    // Returns the pixel buffer: ScreenWidth() * ScreenHeight() pixels, row by row, in the layout of Colour_Pack()
+    virtual uint32_t *GetPixels() = 0;
+
+    // The drawing primitives. Everything is clipped against the target boundaries.
+    // (x, y) is the top left corner of the rectangle, w and h are its width and height
+    virtual void FillRect( int x, int y, int w, int h, uint32_t nColour ) = 0;
+    virtual void DrawLine( int x1, int y1, int x2, int y2, uint32_t nColour ) = 0;
+    virtual void FillTriangle( int x1, int y1, int x2, int y2, int x3, int y3, uint32_t nColour ) = 0;
+
+    // These have a default implementation that uses DrawLine()
+    virtual void DrawRect( int x, int y, int w, int h, uint32_t nColour );
+    virtual void DrawTriangle( int x1, int y1, int x2, int y2, int x3, int y3, uint32_t nColour );
+    // Text output is optional - targets without a font ignore it. The text is passed as a plain C string, so that it
+    // can be formatted without creating std::string objects (see frameArena::Format()).
+    virtual void DrawString( int x, int y, const char *sText, uint32_t nColour = COL_WHITE );
+};
+
+inline void renderTarget::DrawRect( int x, int y, int w, int h, uint32_t nColour ) {
+    DrawLine( x,     y,     x + w, y,     nColour );
+    DrawLine( x + w, y,     x + w, y + h, nColour );
+    DrawLine( x + w, y + h, x,     y + h, nColour );
+    DrawLine( x,     y + h, x,     y,     nColour );
+}
+
+inline void renderTarget::DrawTriangle( int x1, int y1, int x2, int y2, int x3, int y3, uint32_t nColour ) {
+    DrawLine( x1, y1, x2, y2, nColour );
+    DrawLine( x2, y2, x3, y3, nColour );
+    DrawLine( x3, y3, x1, y1, nColour );
+}
+
+inline void renderTarget::DrawString( int, int, const char *, uint32_t ) {}
+
+#endif // RENDER_TARGET_H
@@ -0,0 +1,51 @@
+#ifndef RENDER_TARGET_PGE_H
+#define RENDER_TARGET_PGE_H
+
+#include "olcPixelGameEngine.h"
+
+#include "render_target.h"
+#include       "texture.h"
+
+// Adapter that lets the graphics code draw into the window of a PixelGameEngine. All calls are forwarded to the
+// engine, and the pixel buffer is the one of its current draw target.
+// This is the only part of the rendering code that depends on olcPixelGameEngine.h, and it's header only, so
+// the rest of the code can be built without the engine.
+class pgeRenderTarget : public renderTarget {
+public:
+    explicit pgeRenderTarget( olc::PixelGameEngine *engine ) : pEngine( engine ) {}
+
+    int ScreenWidth()  override { return pEngine->ScreenWidth();  }
+    int ScreenHeight() override { return pEngine->ScreenHeight(); }
+    uint32_t *GetPixels() override { return (uint32_t *)pEngine->GetDrawTarget()->GetData(); }
+
+    void FillRect( int x, int y, int w, int h, uint32_t nColour ) override {
+        pEngine->FillRect( x, y, w, h, olc::Pixel( nColour ));
+    }
+    void DrawLine( int x1, int y1, int x2, int y2, uint32_t nColour ) override {
+        pEngine->DrawLine( x1, y1, x2, y2, olc::Pixel( nColour ));
+    }
+    void FillTriangle( int x1, int y1, int x2, int y2, int x3, int y3, uint32_t nColour ) override {
+        pEngine->FillTriangle( x1, y1, x2, y2, x3, y3, olc::Pixel( nColour ));
+    }
+    void DrawRect( int x, int y, int w, int h, uint32_t nColour ) override {
+        pEngine->DrawRect( x, y, w, h, olc::Pixel( nColour ));
+    }
+    void DrawTriangle( int x1, int y1, int x2, int y2, int x3, int y3, uint32_t nColour ) override {
+        pEngine->DrawTriangle( x1, y1, x2, y2, x3, y3, olc::Pixel( nColour ));
+    }
+    void DrawString( int x, int y, const char *sText, uint32_t nColour ) override {
+        pEngine->DrawString( x, y, sText, olc::Pixel( nColour ));
+    }
+
+private:
+    olc::PixelGameEngine *pEngine;
+};
+
+// Creates texture t (with its mip chain) from the pixels of sprite. olc::Pixel has the layout of Colour_Pack(), so the
+// pixels are copied as they are. Returns false if the sprite dimensions aren't powers of two.
+inline bool Texture_FromSprite( texture &t, olc::Sprite *pSprite ) {
+    static_assert( sizeof( olc::Pixel ) == sizeof( uint32_t ), "olc::Pixel must be a packed 32 bit colour" );
+    return Texture_Create( t, pSprite->width, pSprite->height, reinterpret_cast<const uint32_t *>( pSprite->GetData()));
+}
+
+#endif // RENDER_TARGET_PGE_H
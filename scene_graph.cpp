@@ -0,0 +1,180 @@
+#include "scene_graph.h"
+
+#include <algorithm>
+#include   <cstring>
+
+// the flags per node
+#define NODE_LOCAL_DIRTY   0x01    // the local transform changed, so the local matrix must be recomputed
+#define NODE_WORLD_DIRTY   0x02    // the world matrix must be recomputed (the parent changed)
+
+int sceneGraph::AddNode( const transformSRT &srt, int nParent, mesh *pMesh ) {
+    // a new node is appended, after its parent, so the topological order is kept
+    int nNode = (int)vecSlotOfNode.size();
+    int nSlot = (int)vecLocal.size();
+    vecLocal.push_back( srt );
+    vecLocalMatrix.emplace_back();
+    vecWorldMatrix.emplace_back();
+    vecParentSlot.push_back( (nParent >= 0) ? vecSlotOfNode[nParent] : -1 );
+    vecMesh.push_back( pMesh );
+    vecFlags.push_back( 0 );
+    vecUpdateGen.push_back( 0 );
+    vecNodeOfSlot.push_back( nNode );
+    vecSlotOfNode.push_back( nSlot );
+    MarkDirty( nSlot, NODE_LOCAL_DIRTY );
+    return nNode;
+}
+
+bool sceneGraph::SetParent( int nNode, int nParent ) {
+    int nSlot       = vecSlotOfNode[nNode];
+    int nParentSlot = (nParent >= 0) ? vecSlotOfNode[nParent] : -1;
+
+    // nNode may not become a descendant of itself
+    for (int s = nParentSlot; s >= 0; s = vecParentSlot[s])
+        if (s == nSlot)
+            return false;
+
+    vecParentSlot[nSlot] = nParentSlot;
+    MarkDirty( nSlot, NODE_WORLD_DIRTY );
+    if (nParentSlot > nSlot)
+        RebuildOrder();
+    return true;
+}
+
+int sceneGraph::GetParent( int nNode ) {
+    int nParentSlot = vecParentSlot[ vecSlotOfNode[nNode] ];
+    return (nParentSlot >= 0) ? vecNodeOfSlot[nParentSlot] : -1;
+}
+
+void sceneGraph::SetLocal( int nNode, const transformSRT &srt ) {
+    int nSlot = vecSlotOfNode[nNode];
+    if (std::memcmp( &vecLocal[nSlot], &srt, sizeof( transformSRT )) != 0) {
+        vecLocal[nSlot] = srt;
+        MarkDirty( nSlot, NODE_LOCAL_DIRTY );
+    }
+}
+
+const transformSRT &sceneGraph::GetLocal( int nNode ) {
+    return vecLocal[ vecSlotOfNode[nNode] ];
+}
+
+void sceneGraph::SetMesh( int nNode, mesh *pMesh ) {
+    vecMesh[ vecSlotOfNode[nNode] ] = pMesh;
+    nVersion++;
+}
+
+mesh *sceneGraph::GetMesh( int nNode ) {
+    return vecMesh[ vecSlotOfNode[nNode] ];
+}
+
+const mat4x4 &sceneGraph::GetWorldMatrix( int nNode ) {
+    return vecWorldMatrix[ vecSlotOfNode[nNode] ];
+}
+
+int sceneGraph::NodeCount() {
+    return (int)vecSlotOfNode.size();
+}
+
+uint32_t sceneGraph::Version() {
+    return nVersion;
+}
+
+void sceneGraph::MarkDirty( int nSlot, uint8_t nFlags ) {
+    vecFlags[nSlot] |= nFlags;
+    nFirstDirtySlot = std::min( nFirstDirtySlot, nSlot );
+}
+
+int sceneGraph::UpdateWorldMatrices() {
+    int nSlots = (int)vecLocal.size();
+    if (nFirstDirtySlot >= nSlots) {
+        nFirstDirtySlot = INT32_MAX;
+        return 0;
+    }
+
+    // A node needs a new world matrix if it is dirty itself, or if the world matrix of its parent changed in this
+    // update. Parents come before their children, so one pass in slot order suffices.
+    nGeneration += 1;
+    int nUpdated = 0;
+    for (int nSlot = nFirstDirtySlot; nSlot < nSlots; nSlot++) {
+        uint8_t nFlags      = vecFlags[nSlot];
+        int     nParentSlot = vecParentSlot[nSlot];
+        if (nFlags == 0 && (nParentSlot < 0 || vecUpdateGen[nParentSlot] != nGeneration))
+            continue;
+
+        if (nFlags & NODE_LOCAL_DIRTY)
+            vecLocalMatrix[nSlot] = Matrix_MakeTransformComplete( vecLocal[nSlot] );
+        if (nParentSlot >= 0)
+            vecWorldMatrix[nSlot] = Matrix_MultiplyMatrix( vecLocalMatrix[nSlot], vecWorldMatrix[nParentSlot] );
+        else
+            vecWorldMatrix[nSlot] = vecLocalMatrix[nSlot];
+        vecFlags[nSlot]     = 0;
+        vecUpdateGen[nSlot] = nGeneration;
+        nUpdated++;
+    }
+    nFirstDirtySlot = INT32_MAX;
+    if (nUpdated > 0)
+        nVersion++;
+    return nUpdated;
+}
+
+// Puts the nodes in depth first order again. The relative order of siblings (and of the root nodes) is kept.
+void sceneGraph::RebuildOrder() {
+    int nSlots = (int)vecLocal.size();
+
+    // the children of each slot as linked lists, in slot order
+    std::vector<int> vecFirstChild( nSlots, -1 ), vecNextSibling( nSlots, -1 ), vecLastChild( nSlots, -1 );
+    std::vector<int> vecRoots;
+    for (int s = 0; s < nSlots; s++) {
+        int p = vecParentSlot[s];
+        if (p < 0)
+            vecRoots.push_back( s );
+        else {
+            if (vecLastChild[p] < 0) vecFirstChild[p] = s;
+            else                     vecNextSibling[ vecLastChild[p] ] = s;
+            vecLastChild[p] = s;
+        }
+    }
+
+    // depth first traversal, giving the new order of the old slots
+    std::vector<int> vecOrder, vecStack;
+    vecOrder.reserve( nSlots );
+    for (int nRoot : vecRoots) {
+        vecStack.push_back( nRoot );
+        while (!vecStack.empty()) {
+            int s = vecStack.back();
+            vecStack.pop_back();
+            vecOrder.push_back( s );
+            // push the children in reverse, so they are visited in slot order
+            size_t nMark = vecStack.size();
+            for (int c = vecFirstChild[s]; c >= 0; c = vecNextSibling[c])
+                vecStack.push_back( c );
+            std::reverse( vecStack.begin() + nMark, vecStack.end() );
+        }
+    }
+
+    // move all per node data to the new slots
+    std::vector<int> vecNewSlot( nSlots );
+    for (int s = 0; s < nSlots; s++)
+        vecNewSlot[ vecOrder[s] ] = s;
+
+    auto fnPermute = [&]( auto &vec ) {
+        auto vecOld = vec;
+        for (int s = 0; s < nSlots; s++)
+            vec[s] = vecOld[ vecOrder[s] ];
+    };
+    fnPermute( vecLocal );
+    fnPermute( vecLocalMatrix );
+    fnPermute( vecWorldMatrix );
+    fnPermute( vecParentSlot );
+    fnPermute( vecMesh );
+    fnPermute( vecFlags );
+    fnPermute( vecUpdateGen );
+    fnPermute( vecNodeOfSlot );
+    nFirstDirtySlot = INT32_MAX;
+    for (int s = 0; s < nSlots; s++) {
+        if (vecParentSlot[s] >= 0)
+            vecParentSlot[s] = vecNewSlot[ vecParentSlot[s] ];
+        vecSlotOfNode[ vecNodeOfSlot[s] ] = s;
+        if (vecFlags[s] != 0)
+            nFirstDirtySlot = std::min( nFirstDirtySlot, s );
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <cstdint>
+#include  <vector>
+
+#include "graphics_3D.h"
+
+// A hierarchy of objects. Each node has a local transform (scale, rotation and translation, see transformSRT) that is
+// relative to its parent, and optionally a mesh. The world matrix of a node is its local matrix multiplied by the world
+// matrix of its parent (row vectors, so: world = local * parentWorld).
+//
+// The world matrices are cached, and only recomputed for nodes that are marked dirty (because their local transform
+// changed) and their descendants. All per node data is kept in arrays in topological order (parents before children),
+// so an update is a single forward pass that starts at the first dirty node. If nothing changed, an update costs
+// nothing at all.
+//
+// Nodes are identified by the id that AddNode() returns. The ids stay valid when the hierarchy is changed.
+class sceneGraph {
+public:
+    // Adds a node with local transform srt and mesh pMesh (may be nullptr) as a child of node nParent, or as a root
+    // node if nParent is -1. Returns the id of the new node. The mesh is not owned by the graph.
+    int AddNode( const transformSRT &srt, int nParent = -1, mesh *pMesh = nullptr );
+
+    // Makes node nNode a child of nParent (or a root node if nParent is -1). Returns false if that would create a cycle.
+    bool SetParent( int nNode, int nParent );
+    int  GetParent( int nNode );
+
+    // Sets the local transform of node nNode. The node is only marked dirty if the transform really changes.
+    void SetLocal( int nNode, const transformSRT &srt );
+    const transformSRT &GetLocal( int nNode );
+
+    void  SetMesh( int nNode, mesh *pMesh );
+    mesh *GetMesh( int nNode );
+
+    // Recomputes the world matrices of all dirty nodes and their descendants. Returns the number of nodes that were
+    // recomputed.
+    int UpdateWorldMatrices();
+
+    // Returns the world matrix of node nNode, as computed by the last UpdateWorldMatrices()
+    const mat4x4 &GetWorldMatrix( int nNode );
+
+    int NodeCount();
+
+    // Returns a number that changes whenever the graph changes in a way that affects rendering: a world matrix is
+    // recomputed (by UpdateWorldMatrices()), or a mesh is assigned to a node. Changes of the data of the meshes
+    // themselves are not tracked here (see mesh::nVersion).
+    uint32_t Version();
+
+private:
+    // The per node data, indexed by slot. The slots are in topological order: the slot of a parent is always lower than
+    // the slots of its children.
+    std::vector<transformSRT> vecLocal;
+    std::vector<mat4x4>       vecLocalMatrix;    // cached Matrix_MakeTransformComplete( vecLocal[slot] )
+    std::vector<mat4x4>       vecWorldMatrix;
+    std::vector<int>          vecParentSlot;     // -1 for root nodes
+    std::vector<mesh *>       vecMesh;
+    std::vector<uint8_t>      vecFlags;          // see NODE_... in scene_graph.cpp
+    std::vector<uint32_t>     vecUpdateGen;      // nGeneration of the last update that changed the world matrix
+    std::vector<int>          vecNodeOfSlot;     // node id per slot
+    std::vector<int>          vecSlotOfNode;     // slot per node id
+
+    int      nFirstDirtySlot = INT32_MAX;        // all slots before this one are up to date
+    uint32_t nGeneration     = 0;                // incremented by every UpdateWorldMatrices() that does work
+    uint32_t nVersion        = 0;                // see Version()
+
+    void MarkDirty( int nSlot, uint8_t nFlags );
+    // restores the topological order after SetParent() moved a node before its new parent
+    void RebuildOrder();
+};
+
+#endif // SCENE_GRAPH_H
@@ -0,0 +1,85 @@
+#include "texture.h"
+
+// returns true if n is a power of two (and positive)
+static bool IsPowerOfTwo( int n ) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// Builds the mip chain: every level is computed from the previous one by averaging 2x2 blocks of texels (per channel,
+// rounded). If one of the dimensions is already 1, the block is 2x1 or 1x2.
+bool Texture_Create( texture &t, int nWidth, int nHeight, const uint32_t *pPixels ) {
+    t.vecTexels.clear();
+    t.nWidth = t.nHeight = t.nLevels = 0;
+    if (!IsPowerOfTwo( nWidth ) || !IsPowerOfTwo( nHeight ))
+        return false;
+
+    // determine the number and the positions of the levels, so that the texels are allocated in one go
+    size_t nTotal = 0;
+    int nLevels = 0;
+    for (int w = nWidth, h = nHeight; nLevels < TEXTURE_MAX_LEVELS; w = std::max( w / 2, 1 ), h = std::max( h / 2, 1 )) {
+        t.nLevelStart[nLevels++] = nTotal;
+        nTotal += (size_t)w * h;
+        if (w == 1 && h == 1)
+            break;
+    }
+    t.vecTexels.resize( nTotal );
+    t.nWidth  = nWidth;
+    t.nHeight = nHeight;
+    t.nLevels = nLevels;
+    std::copy( pPixels, pPixels + (size_t)nWidth * nHeight, t.vecTexels.begin());
+
+    for (int n = 1; n < nLevels; n++) {
+        textureLevel src = Texture_GetLevel( t, n - 1 );
+        textureLevel dst = Texture_GetLevel( t, n );
+        uint32_t *pDst = t.vecTexels.data() + t.nLevelStart[n];
+        for (int y = 0; y < dst.nHeight; y++) {
+            int y0 = std::min( 2 * y, src.nHeight - 1 ), y1 = std::min( 2 * y + 1, src.nHeight - 1 );
+            for (int x = 0; x < dst.nWidth; x++) {
+                int x0 = std::min( 2 * x, src.nWidth - 1 ), x1 = std::min( 2 * x + 1, src.nWidth - 1 );
+                uint32_t c[4] = { src.pTexels[y0 * src.nWidth + x0], src.pTexels[y0 * src.nWidth + x1],
+                                  src.pTexels[y1 * src.nWidth + x0], src.pTexels[y1 * src.nWidth + x1] };
+                uint32_t nResult = 0;
+                for (int nShift = 0; nShift < 32; nShift += 8) {
+                    uint32_t nSum = ((c[0] >> nShift) & 0xFF) + ((c[1] >> nShift) & 0xFF) +
+                                    ((c[2] >> nShift) & 0xFF) + ((c[3] >> nShift) & 0xFF);
+                    nResult |= ((nSum + 2) / 4) << nShift;
+                }
+                pDst[y * dst.nWidth + x] = nResult;
+            }
+        }
+    }
+    return true;
+}
+
+bool Texture_MakeChecker( texture &t, int nSize, int nSquare, uint32_t nColour1, uint32_t nColour2 ) {
+    std::vector<uint32_t> vecPixels( (size_t)nSize * nSize );
+    nSquare = std::max( nSquare, 1 );
+    for (int y = 0; y < nSize; y++)
+        for (int x = 0; x < nSize; x++)
+            vecPixels[(size_t)y * nSize + x] = (((x / nSquare) + (y / nSquare)) & 1) ? nColour2 : nColour1;
+    return Texture_Create( t, nSize, nSize, vecPixels.data());
+}
+
+// Interpolates between colours a and b with weight f (0 - 256) for b. The red and blue channels resp. the green and
+// alpha channels are done together, in the two halves of a 32 bit integer.
+static inline uint32_t LerpColour( uint32_t a, uint32_t b, uint32_t f ) {
+    uint32_t rb = ((( a       & 0x00FF00FF) * (256 - f) + ( b       & 0x00FF00FF) * f) >> 8) & 0x00FF00FF;
+    uint32_t ga =  (((a >> 8) & 0x00FF00FF) * (256 - f) + ((b >> 8) & 0x00FF00FF) * f)       & 0xFF00FF00;
+    return rb | ga;
+}
+
+uint32_t Texture_SampleBilinear( const textureLevel &l, float u, float v ) {
+    // the texel centres are at half integer positions
+    float fx = u * (float)l.nWidth  - 0.5f;
+    float fy = v * (float)l.nHeight - 0.5f;
+    float fx0 = std::floor( fx ), fy0 = std::floor( fy );
+    uint32_t nFracX = (uint32_t)((fx - fx0) * 256.0f);
+    uint32_t nFracY = (uint32_t)((fy - fy0) * 256.0f);
+
+    int x0 = (int)fx0 & (l.nWidth  - 1), x1 = (x0 + 1) & (l.nWidth  - 1);
+    int y0 = (int)fy0 & (l.nHeight - 1), y1 = (y0 + 1) & (l.nHeight - 1);
+    const uint32_t *pRow0 = l.pTexels + y0 * l.nWidth;
+    const uint32_t *pRow1 = l.pTexels + y1 * l.nWidth;
+    return LerpColour( LerpColour( pRow0[x0], pRow0[x1], nFracX ),
+                       LerpColour( pRow1[x0], pRow1[x1], nFracX ), nFracY );
+}
@@ -0,0 +1,65 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <algorithm>
+#include     <cmath>
+#include   <cstdint>
+#include    <vector>
+
+// A texture with a precomputed mip chain: level 0 is the image itself, and every next level is half the size of the
+// previous one (each texel is the average of a 2x2 block), down to 1x1. The rasterizer samples a smaller level when a
+// triangle is seen from far away or at a grazing angle, so that neighbouring pixels read neighbouring texels. That is
+// both better looking (less aliasing) and faster (fewer cache misses) than sampling the full size image.
+//
+// The width and height must be powers of two, so that wrapping the texture coordinates is a mask operation. The texels
+// are in the layout of Colour_Pack(). Texture coordinates (u, v) in [0, 1] span the image once, with (0, 0) the top
+// left corner, outside of that range the texture repeats.
+
+#define TEXTURE_MAX_LEVELS   16
+
+// texture filtering modes of the rasterizer
+#define TEXTURE_FILTER_NONE       0    // textures aren't sampled, textured triangles get the flat colour of their material
+#define TEXTURE_FILTER_NEAREST    1    // the texel that the pixel centre falls in
+#define TEXTURE_FILTER_BILINEAR   2    // weighted average of the four texels around the pixel centre
+
+struct texture {
+    std::vector<uint32_t> vecTexels;    // all levels one after another, starting with level 0
+    int    nWidth = 0, nHeight = 0;     // of level 0
+    int    nLevels = 0;
+    size_t nLevelStart[TEXTURE_MAX_LEVELS];
+};
+
+// One level of a texture, as it is used for sampling. It points into the texels of the texture, so it is only valid
+// as long as the texture is not changed.
+struct textureLevel {
+    int nWidth = 0, nHeight = 0;
+    const uint32_t *pTexels = nullptr;
+};
+
+// Creates texture t from the nWidth x nHeight pixels in pPixels (row by row), and builds its mip chain. Returns false
+// (and leaves t empty) if the width or height is not a power of two.
+bool Texture_Create( texture &t, int nWidth, int nHeight, const uint32_t *pPixels );
+// Creates a nSize x nSize checker board texture with squares of nSquare texels, alternating nColour1 and nColour2
+bool Texture_MakeChecker( texture &t, int nSize, int nSquare, uint32_t nColour1, uint32_t nColour2 );
+
+// Returns level nLevel (0 <= nLevel < t.nLevels) of texture t
+inline textureLevel Texture_GetLevel( const texture &t, int nLevel ) {
+    textureLevel l;
+    l.nWidth  = std::max( t.nWidth  >> nLevel, 1 );
+    l.nHeight = std::max( t.nHeight >> nLevel, 1 );
+    l.pTexels = t.vecTexels.data() + t.nLevelStart[nLevel];
+    return l;
+}
+
+// Returns the texel of level l at texture coordinates (u, v), without filtering
+inline uint32_t Texture_SampleNearest( const textureLevel &l, float u, float v ) {
+    // the mask also wraps negative coordinates correctly (two's complement)
+    int x = (int)std::floor( u * (float)l.nWidth  ) & (l.nWidth  - 1);
+    int y = (int)std::floor( v * (float)l.nHeight ) & (l.nHeight - 1);
+    return l.pTexels[y * l.nWidth + x];
+}
+
+// Returns the bilinear interpolation of the four texels of level l around texture coordinates (u, v)
+uint32_t Texture_SampleBilinear( const textureLevel &l, float u, float v );
+
+#endif // TEXTURE_H
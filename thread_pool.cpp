@@ -0,0 +1,148 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+// set for the worker threads, and for any thread that is executing tasks, to detect nested ParallelFor() calls
+static thread_local bool tlsInsideTask = false;
+
+static inline uint64_t PackRange( uint32_t nBegin, uint32_t nEnd ) {
+    return ((uint64_t)nEnd << 32) | nBegin;
+}
+
+threadPool::threadPool( int nThreads ) {
+    if (nThreads <= 0)
+        nThreads = std::max( 1, (int)std::thread::hardware_concurrency());
+    pRanges.reset( new taskRange[nThreads] );
+    // the calling thread participates as well, so one thread less is needed
+    for (int i = 1; i < nThreads; i++)
+        vecWorkers.emplace_back( &threadPool::WorkerLoop, this, i );
+}
+
+threadPool::~threadPool() {
+    {
+        std::lock_guard<std::mutex> lock( mtxJob );
+        bStop = true;
+    }
+    cvJob.notify_all();
+    for (auto &t : vecWorkers)
+        t.join();
+}
+
+int threadPool::ThreadCount() {
+    return (int)vecWorkers.size() + 1;
+}
+
+void threadPool::ParallelFor( int nTasks, const std::function<void( int )> &fnTask ) {
+    if (nTasks <= 0)
+        return;
+    // nested calls and trivial jobs are done on the calling thread
+    if (tlsInsideTask || nTasks == 1 || vecWorkers.empty()) {
+        for (int i = 0; i < nTasks; i++)
+            fnTask( i );
+        return;
+    }
+
+    std::lock_guard<std::mutex> callerLock( mtxCaller );
+    {
+        std::lock_guard<std::mutex> lock( mtxJob );
+        pJobTask  = &fnTask;
+        nJobTasks = nTasks;
+        nTasksDone = 0;
+        nGeneration++;
+        // every thread gets an equal share of the tasks to start with
+        int nThreads = ThreadCount();
+        for (int i = 0; i < nThreads; i++)
+            pRanges[i].nRange.store( PackRange( (uint32_t)((int64_t)nTasks * i / nThreads), (uint32_t)((int64_t)nTasks * (i + 1) / nThreads) ),
+                                     std::memory_order_relaxed );
+    }
+    cvJob.notify_all();
+
+    // the calling thread helps out
+    RunTasks( 0, &fnTask, nTasks );
+
+    // wait until all tasks are done, and no worker is referring to the job anymore
+    std::unique_lock<std::mutex> lock( mtxJob );
+    cvDone.wait( lock, [&] { return nTasksDone == nJobTasks && nBusy == 0; } );
+    pJobTask  = nullptr;
+    nJobTasks = 0;
+}
+
+void threadPool::WorkerLoop( int nThread ) {
+    uint64_t nSeenGeneration = 0;
+    while (true) {
+        const std::function<void( int )> *pTask;
+        int nTasks;
+        {
+            std::unique_lock<std::mutex> lock( mtxJob );
+            cvJob.wait( lock, [&] { return bStop || (nGeneration != nSeenGeneration && pJobTask != nullptr); } );
+            if (bStop)
+                return;
+            // take a snapshot of the job while holding the lock
+            nSeenGeneration = nGeneration;
+            pTask  = pJobTask;
+            nTasks = nJobTasks;
+            nBusy++;
+        }
+        RunTasks( nThread, pTask, nTasks );
+        {
+            std::lock_guard<std::mutex> lock( mtxJob );
+            nBusy--;
+        }
+        cvDone.notify_all();
+    }
+}
+
+void threadPool::RunTasks( int nThread, const std::function<void( int )> *pTask, int nTasks ) {
+    tlsInsideTask = true;
+    int i;
+    while (PopTask( nThread, i ) || (StealTasks( nThread ) && PopTask( nThread, i ))) {
+        (*pTask)( i );
+        if (nTasksDone.fetch_add( 1 ) + 1 == nTasks) {
+            // last task done - wake up the caller (locking makes sure the wake up can't get lost)
+            std::lock_guard<std::mutex> lock( mtxJob );
+            cvDone.notify_all();
+        }
+    }
+    tlsInsideTask = false;
+}
+
+bool threadPool::PopTask( int nThread, int &nTask ) {
+    std::atomic<uint64_t> &range = pRanges[nThread].nRange;
+    uint64_t nRange = range.load( std::memory_order_acquire );
+    while (true) {
+        uint32_t nBegin = (uint32_t)nRange, nEnd = (uint32_t)(nRange >> 32);
+        if (nBegin >= nEnd)
+            return false;
+        // a thief may have changed the end in the mean time - then the exchange fails and nRange is reloaded
+        if (range.compare_exchange_weak( nRange, PackRange( nBegin + 1, nEnd ), std::memory_order_acq_rel )) {
+            nTask = (int)nBegin;
+            return true;
+        }
+    }
+}
+
+bool threadPool::StealTasks( int nThread ) {
+    int nThreads = ThreadCount();
+    for (int k = 1; k < nThreads; k++) {
+        std::atomic<uint64_t> &victim = pRanges[(nThread + k) % nThreads].nRange;
+        uint64_t nRange = victim.load( std::memory_order_acquire );
+        while (true) {
+            uint32_t nBegin = (uint32_t)nRange, nEnd = (uint32_t)(nRange >> 32);
+            if (nBegin >= nEnd)
+                break;
+            // take the back half (rounded up, so a single task can be stolen as well)
+            uint32_t nSplit = nEnd - (nEnd - nBegin + 1) / 2;
+            if (victim.compare_exchange_weak( nRange, PackRange( nBegin, nSplit ), std::memory_order_acq_rel )) {
+                // only this thread writes to its own range while it is empty, the others only read it
+                pRanges[nThread].nRange.store( PackRange( nSplit, nEnd ), std::memory_order_release );
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+threadPool &ThreadPool_Global() {
+    static threadPool pool;
+    return pool;
+}
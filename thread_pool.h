@@ -0,0 +1,74 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include            <atomic>
+#include <condition_variable>
+#include        <functional>
+#include            <memory>
+#include             <mutex>
+#include            <thread>
+#include            <vector>
+
+// A small pool of worker threads for data parallel work. The work is split into a number of tasks
+// (for instance: one task per screen tile), and ParallelFor() distributes these tasks over the worker
+// threads and the calling thread. It returns when all tasks are done.
+//
+// The tasks are distributed with work stealing: every thread starts with its own contiguous range of task indices,
+// and takes tasks from the front of it. A thread that runs out of tasks steals the back half of the range of another
+// thread. The ranges are single 64 bit atomics, so neither taking nor stealing needs a lock, and as long as the tasks
+// take about equally long every thread works on its own range, and the threads don't touch each others cache lines.
+//
+// Only one ParallelFor() runs at a time. Calling ParallelFor() from within a task is allowed, but the
+// nested tasks are then simply executed on the calling thread.
+class threadPool {
+public:
+    // Creates the pool with nThreads threads in total (the calling thread included).
+    // If nThreads <= 0 the number of hardware threads is used.
+    explicit threadPool( int nThreads = 0 );
+    ~threadPool();
+
+    threadPool( const threadPool & ) = delete;
+    threadPool &operator = ( const threadPool & ) = delete;
+
+    // returns the total number of threads that work on tasks, including the calling thread
+    int ThreadCount();
+
+    // Calls fnTask( i ) for every i in [0, nTasks), distributed over the threads in the pool.
+    void ParallelFor( int nTasks, const std::function<void( int )> &fnTask );
+
+private:
+    void WorkerLoop( int nThread );
+    // picks tasks of the current job (starting with the range of thread nThread) until there are none left
+    void RunTasks( int nThread, const std::function<void( int )> *pTask, int nTasks );
+
+    // The range [begin, end) of task indices of one thread, with begin in the low and end in the high 32 bits. Aligned
+    // to a cache line, so that the threads updating their own ranges don't interfere.
+    struct alignas( 64 ) taskRange {
+        std::atomic<uint64_t> nRange{ 0 };
+    };
+    std::unique_ptr<taskRange[]> pRanges;    // one per thread, the calling thread is 0
+
+    // takes the first task from the range of thread nThread, returns false if it is empty
+    bool PopTask( int nThread, int &nTask );
+    // moves the back half of the range of another thread into the (empty) range of thread nThread
+    bool StealTasks( int nThread );
+
+    std::vector<std::thread> vecWorkers;
+
+    std::mutex              mtxCaller;     // serializes calls to ParallelFor()
+    std::mutex              mtxJob;        // protects the job description below
+    std::condition_variable cvJob, cvDone;
+
+    const std::function<void( int )> *pJobTask = nullptr;
+    int      nJobTasks   = 0;
+    uint64_t nGeneration = 0;              // incremented for every new job
+    int      nBusy       = 0;              // number of workers currently working on a job
+    bool     bStop       = false;
+
+    std::atomic<int> nTasksDone{ 0 };
+};
+
+// Returns the pool that is shared by the rendering code. It is created on first use.
+threadPool &ThreadPool_Global();
+
+#endif // THREAD_POOL_H
@@ -2,7 +2,6 @@
 
 #include <iostream>
 #include <cmath>
-#include <conio.h>
 
 // IMPLEMENTATION
 
@@ -154,6 +153,25 @@ vec3d Vector_Get( float x, float y, float z, float w ) {
     return v;
 }
 
+// resizes the vertex stream so that it can hold nCount vertices
+void VertexStream_Resize( vertexStream &s, int nCount ) {
+    s.x.resize( nCount );
+    s.y.resize( nCount );
+    s.z.resize( nCount );
+    s.w.resize( nCount );
+    s.nCount = nCount;
+}
+
+// stores vector v at position i of the vertex stream
+void VertexStream_Set( vertexStream &s, int i, vec3d &v ) {
+    s.x[i] = v.x; s.y[i] = v.y; s.z[i] = v.z; s.w[i] = v.w;
+}
+
+// returns the vertex at position i of the vertex stream as a vector
+vec3d VertexStream_Get( vertexStream &s, int i ) {
+    return { s.x[i], s.y[i], s.z[i], s.w[i] };
+}
+
 // use for vec2d vectors - prints the contents of a vec2d to a string and returns it
 std::string Vector_PrintToString2( std::string header, vec2d &v ) {
 
@@ -2,6 +2,7 @@
 #define VEC3D_H
 
 #include <fstream>
+#include <vector>
 
 // DATATYPES
 
@@ -11,13 +12,21 @@ struct vec2d {          // used for textures, that are a 2d thing
     float w = 1.0f;     // Need a 3d term to perform sensible sprite operations
 };
 
-struct vec3d {          // (vector to) a point in 3d space
+struct alignas(16) vec3d {  // (vector to) a point in 3d space - 16 byte aligned so that it fits in one SSE register
     float x = 0.0f;
     float y = 0.0f;
     float z = 0.0f;
     float w = 1.0f;     // Need a 4th term to perform sensible matrix vector multiplication
 };
 
+// Structure of arrays (SoA) layout for a stream of vertices. Each coordinate has its own contiguous
+// array, so that a loop over the whole stream can be vectorized by the compiler. Use this layout for
+// batch operations on large numbers of vertices (see Matrix_MultiplyVertexStream()).
+struct vertexStream {
+    std::vector<float> x, y, z, w;
+    int nCount = 0;
+};
+
 // PROTOTYPES GENERIC VECTOR FUNCTIONS
 
 vec3d Vector_Add( vec3d &v1, vec3d &v2 );           // adds vector v1 and v2, and returns resulting vector
@@ -55,6 +64,11 @@ vec3d Vector_IntersectPlane( vec3d &plane_p, vec3d &plane_n, vec3d &lineStart, v
  void  Vector_Print( vec3d &v, bool end_line );          // outputs to cout the 4 elements of the vector. Outputs endl if boolean is true
  vec3d Vector_Get( float x, float y, float z, float w ); // creates and returns a vector with the four values given as parameters
 
+// vertex stream functions - resize the stream to nCount vertices, and put / get vertex i
+void  VertexStream_Resize( vertexStream &s, int nCount );
+void  VertexStream_Set(    vertexStream &s, int i, vec3d &v );
+vec3d VertexStream_Get(    vertexStream &s, int i );
+
 // use for vec2d vectors - prints the contents of a vec2d to a string and returns it
 std::string Vector_PrintToString2( std::string header, vec2d &v );
 